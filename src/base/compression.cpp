@@ -0,0 +1,249 @@
+#include "compression.h"
+
+#include <cstring>
+#include <memory>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+namespace {
+
+constexpr size_t min_match = 4;
+// last bytes of the block are always literals and matches don't start too close to the end
+constexpr size_t last_literals = 5;
+constexpr size_t match_guard = 12;
+constexpr size_t max_offset = 65535;
+constexpr int hash_bits = 14;
+
+uint32_t read32(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint64_t read64(const uint8_t* p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t hash32(uint32_t v) {
+  return (v * 2654435761U) >> (32 - hash_bits);
+}
+
+size_t trailing_zero_bytes(uint64_t v) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, v);
+  return index / 8;
+#else
+  return (size_t) __builtin_ctzll(v) / 8;
+#endif
+}
+
+size_t match_length(const uint8_t* p, const uint8_t* ref, const uint8_t* limit) {
+  const uint8_t* start = p;
+  while (p + 8 <= limit) {
+    if (uint64_t diff = read64(p) ^ read64(ref))
+      return p - start + trailing_zero_bytes(diff);
+    p += 8;
+    ref += 8;
+  }
+
+  while (p < limit && *p == *ref) {
+    p++;
+    ref++;
+  }
+  return p - start;
+}
+
+uint8_t* write_length(uint8_t* op, size_t length) {
+  for (; length >= 255; length -= 255) {
+    *op++ = 255;
+  }
+  *op++ = (uint8_t) length;
+  return op;
+}
+
+// Returns null if the sequence doesn't fit.
+uint8_t* write_sequence(uint8_t* op, const uint8_t* op_end, const uint8_t* literals, size_t literals_size,
+                        size_t offset, size_t match_size) {
+  size_t needed = 1 + literals_size / 255 + 1 + literals_size + (match_size ? 2 + match_size / 255 + 1 : 0);
+  if (needed > (size_t) (op_end - op))
+    return nullptr;
+
+  uint8_t* token = op++;
+  if (literals_size >= 15) {
+    *token = 15 << 4;
+    op = write_length(op, literals_size - 15);
+  } else {
+    *token = (uint8_t) (literals_size << 4);
+  }
+
+  if (literals_size) {
+    std::memcpy(op, literals, literals_size);
+    op += literals_size;
+  }
+
+  if (!match_size)
+    return op;
+
+  *op++ = (uint8_t) offset;
+  *op++ = (uint8_t) (offset >> 8);
+
+  size_t length = match_size - min_match;
+  if (length >= 15) {
+    *token |= 15;
+    op = write_length(op, length - 15);
+  } else {
+    *token |= (uint8_t) length;
+  }
+  return op;
+}
+
+bool read_length(const uint8_t*& ip, const uint8_t* end, size_t& length) {
+  uint8_t b;
+  do {
+    if (ip == end)
+      return false;
+    b = *ip++;
+    length += b;
+  } while (b == 255);
+  return true;
+}
+
+}
+
+namespace utils {
+
+size_t lz_compress_bound(size_t size) {
+  return size + size / 255 + 16;
+}
+
+size_t lz_compress(const void* src_data, size_t size, void* dst_data, size_t capacity) {
+  const auto* src = static_cast<const uint8_t*>(src_data);
+  const uint8_t* end = src + size;
+  auto* dst = static_cast<uint8_t*>(dst_data);
+  uint8_t* op = dst;
+  uint8_t* op_end = dst + capacity;
+
+  const uint8_t* anchor = src;
+  if (size > match_guard) {
+    // positions are offsets from src, stale or empty entries are rejected by comparing bytes
+    auto table = std::make_unique<uint32_t[]>(size_t(1) << hash_bits);
+    const uint8_t* match_limit = end - match_guard;
+    const uint8_t* ip = src + 1;
+    size_t misses = 0;
+
+    while (ip < match_limit) {
+      uint32_t& entry = table[hash32(read32(ip))];
+      const uint8_t* ref = src + entry;
+      entry = (uint32_t) (ip - src);
+
+      if (ref >= ip || (size_t) (ip - ref) > max_offset || read32(ref) != read32(ip)) {
+        // skip faster through data which doesn't compress
+        ip += 1 + (misses++ >> 6);
+        continue;
+      }
+
+      while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+        ip--;
+        ref--;
+      }
+
+      size_t length = min_match + match_length(ip + min_match, ref + min_match, end - last_literals);
+      op = write_sequence(op, op_end, anchor, ip - anchor, ip - ref, length);
+      if (!op)
+        return 0;
+
+      ip += length;
+      anchor = ip;
+      misses = 0;
+
+      if (ip < match_limit) {
+        table[hash32(read32(ip - 2))] = (uint32_t) (ip - 2 - src);
+      }
+    }
+  }
+
+  op = write_sequence(op, op_end, anchor, end - anchor, 0, 0);
+  return op ? op - dst : 0;
+}
+
+bool lz_decompress(const void* src_data, size_t size, void* dst_data, size_t dst_size) {
+  const auto* ip = static_cast<const uint8_t*>(src_data);
+  const uint8_t* end = ip + size;
+  auto* dst = static_cast<uint8_t*>(dst_data);
+  uint8_t* op = dst;
+  uint8_t* op_end = dst + dst_size;
+
+  while (ip < end) {
+    uint8_t token = *ip++;
+
+    size_t literals_size = token >> 4;
+    if (literals_size == 15 && !read_length(ip, end, literals_size))
+      return false;
+
+    if (literals_size > (size_t) (end - ip) || literals_size > (size_t) (op_end - op))
+      return false;
+
+    // short runs are copied with fixed size while there is room for the overshoot
+    if (literals_size <= 16 && end - ip >= 16 && op_end - op >= 16) {
+      std::memcpy(op, ip, 16);
+    } else if (literals_size) {
+      std::memcpy(op, ip, literals_size);
+    }
+    ip += literals_size;
+    op += literals_size;
+
+    if (ip == end)
+      break;
+
+    if (end - ip < 2)
+      return false;
+
+    size_t offset = ip[0] | (size_t(ip[1]) << 8);
+    ip += 2;
+    if (!offset || offset > (size_t) (op - dst))
+      return false;
+
+    size_t length = token & 15;
+    if (length == 15 && !read_length(ip, end, length))
+      return false;
+
+    length += min_match;
+    if (length > (size_t) (op_end - op))
+      return false;
+
+    const uint8_t* ref = op - offset;
+    if (offset >= 8 && length <= 16 && op_end - op >= 16) {
+      // every 8 bytes are read before they are overwritten
+      std::memcpy(op, ref, 8);
+      std::memcpy(op + 8, ref + 8, 8);
+      op += length;
+      continue;
+    }
+
+    if (offset >= length) {
+      std::memcpy(op, ref, length);
+      op += length;
+      continue;
+    }
+
+    // overlapping match repeats the last offset bytes
+    if (offset >= 8) {
+      for (; length >= 8; length -= 8, op += 8, ref += 8) {
+        std::memcpy(op, ref, 8);
+      }
+    }
+
+    for (; length; length--) {
+      *op++ = *ref++;
+    }
+  }
+
+  return op == op_end;
+}
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+
+// LZ4-class block compression: byte aligned literal runs and matches within 64 KiB window, no entropy coding.
+// Every block is independent, a sequence is a token (4 bits literal length, 4 bits match length - 4), extra
+// length bytes, literals, 16-bit match offset and extra match length bytes. Last sequence has literals only.
+
+size_t lz_compress_bound(size_t size);
+
+// Returns compressed size or 0 if it doesn't fit into capacity.
+size_t lz_compress(const void* src, size_t size, void* dst, size_t capacity);
+
+// Returns false if src is malformed or doesn't decompress to exactly dst_size bytes.
+bool lz_decompress(const void* src, size_t size, void* dst, size_t dst_size);
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "base/hash.h"
+
 #include <string>
 
 namespace utils {
@@ -69,14 +71,4 @@ uint32_t crc32(Iterator first, Iterator last, uint32_t crc = 0) {
   return ~crc;
 }
 
-inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
-  crc = ~crc;
-  for (uint32_t i = 0; i < size; i++) {
-    crc = crc_table[*data ^ (crc & 0xFF)] ^ (crc >> 8);
-    data++;
-  }
-
-  return ~crc;
-}
-
 }
\ No newline at end of file
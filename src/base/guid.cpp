@@ -29,16 +29,17 @@ const std::array<uint8_t, 16> &guid::bytes() const {
     return bytes_;
 }
 
+void guid::write_hex(char* out) const {
+    static constexpr char digits[] = "0123456789abcdef";
+    for (uint8_t byte : bytes_) {
+        *out++ = digits[byte >> 4u];
+        *out++ = digits[byte & 0xFu];
+    }
+}
+
 std::string guid::str() const {
-    char one[34];
-    snprintf(one, 34, "%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x",
-             bytes_[0], bytes_[1], bytes_[2], bytes_[3],
-             bytes_[4], bytes_[5], bytes_[6], bytes_[7],
-             bytes_[8], bytes_[9], bytes_[10], bytes_[11],
-             bytes_[12], bytes_[13], bytes_[14], bytes_[15]
-    );
-
-    std::string out(one);
+    std::string out(32, '\0');
+    write_hex(out.data());
     return out;
 }
 
@@ -109,30 +110,55 @@ std::istream &operator>>(std::istream &in, guid &guid) {
     return in;
 }
 
-guid guid::from_string(const std::string& str) {
+namespace {
+
+constexpr std::array<int8_t, 256> make_hex_table() {
+    std::array<int8_t, 256> table {};
+    for (auto& v : table) v = -1;
+    for (int i = 0; i < 10; i++) table['0' + i] = (int8_t) i;
+    for (int i = 0; i < 6; i++) {
+        table['a' + i] = (int8_t) (10 + i);
+        table['A' + i] = (int8_t) (10 + i);
+    }
+    return table;
+}
+
+constexpr std::array<int8_t, 256> hex_table = make_hex_table();
+
+}
+
+guid guid::from_string(std::string_view str) {
   guid result;
-  size_t size = str.size();
-  size_t index = 0;
-  bool firstDigit = true;
 
-  uint8_t b0, b1;
-  for (size_t i = 0; i < size; i++) {
-    if (str[i] == '-') continue;
+  // plain 32 digit form is what assets store
+  if (str.size() == 32) {
+    for (size_t i = 0; i < 16; i++) {
+      int hi = hex_table[(uint8_t) str[2 * i]];
+      int lo = hex_table[(uint8_t) str[2 * i + 1]];
+      if ((hi | lo) < 0)
+        return guid::invalid();
+      result.bytes_[i] = (uint8_t) ((hi << 4) | lo);
+    }
+    return result;
+  }
+
+  size_t index = 0;
+  int hi = -1;
+  for (char c : str) {
+    if (c == '-') continue;
     if (index >= 16)
       return guid::invalid();
 
-    bool valid = true;
-    if (firstDigit) {
-      valid &= char2hex(str[i], b0);
-    } else {
-      valid &= char2hex(str[i], b1);
-      result.bytes_[index++] = (b0 << 4u) + b1;
-    }
-
-    if (!valid)
+    int digit = hex_table[(uint8_t) c];
+    if (digit < 0)
       return guid::invalid();
 
-    firstDigit = !firstDigit;
+    if (hi < 0) {
+      hi = digit;
+    } else {
+      result.bytes_[index++] = (uint8_t) ((hi << 4) | digit);
+      hi = -1;
+    }
   }
 
   return index < 16 ? guid::invalid() : result;
@@ -142,6 +168,12 @@ bool operator<(const guid &lhs, const guid &rhs) {
     return lhs.bytes_ < rhs.bytes_;
 }
 
+guid guid::from_bytes(const std::array<uint8_t, 16>& bytes) {
+    guid result;
+    result.bytes_ = bytes;
+    return result;
+}
+
 guid guid::invalid() noexcept {
     static guid invalid_guid;
     return invalid_guid;
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 
 class guid {
 public:
@@ -24,16 +27,12 @@ public:
 
     void swap(guid &);
 
-    static guid from_string(const std::string&);
+    // Writes 32 lowercase hex digits, no terminator.
+    void write_hex(char* out) const;
 
-  template<class StringCompatibleType,
-      std::enable_if_t<
-          !std::is_same_v<std::string, StringCompatibleType> &&
-          std::is_constructible_v<std::string, StringCompatibleType>,
-        int> = 0>
-    static guid from_string(const StringCompatibleType& value) {
-      return from_string(std::string(value));
-    }
+    static guid from_string(std::string_view);
+
+    static guid from_bytes(const std::array<uint8_t, 16>&);
 
     static guid generate();
     static guid invalid() noexcept;
@@ -52,11 +51,12 @@ namespace std {
 template <>
 struct hash<guid> {
 
+  // generated guids are random already, halves are just folded together
   std::size_t operator()(const guid& guid) const {
-    const uint64_t* p = reinterpret_cast<const uint64_t*>(guid.bytes().data());
-    std::size_t seed = std::hash<uint64_t>{}(p[1]);
-    seed ^= std::hash<uint64_t>{}(p[0]) + 0x9e3779b9 + (seed << 6u) + (seed >> 2u);
-    return seed;
+    uint64_t lo, hi;
+    std::memcpy(&lo, guid.bytes().data(), sizeof(lo));
+    std::memcpy(&hi, guid.bytes().data() + sizeof(lo), sizeof(hi));
+    return (std::size_t) (lo ^ (hi * 0x9E3779B97F4A7C15ULL));
   }
 
 };
@@ -0,0 +1,226 @@
+#include "hash.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#   define UBIK_HASH_SSE42 1
+#   include <nmmintrin.h>
+#   if defined(_MSC_VER)
+#     include <intrin.h>
+#   endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#   define UBIK_HASH_ARM_CRC 1
+#   include <arm_acle.h>
+#endif
+
+#ifndef UBIK_HASH_SSE42
+#define UBIK_HASH_SSE42 0
+#endif
+
+#ifndef UBIK_HASH_ARM_CRC
+#define UBIK_HASH_ARM_CRC 0
+#endif
+
+namespace {
+
+// tables[0] is the classic byte table, tables[k] advances it by k more zero bytes
+template<uint32_t Poly>
+struct crc_tables {
+  uint32_t tables[8][256] {};
+
+  constexpr crc_tables() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc >> 1) ^ (Poly & (0U - (crc & 1U)));
+      }
+      tables[0][i] = crc;
+    }
+
+    for (uint32_t i = 0; i < 256; i++) {
+      for (int k = 1; k < 8; k++) {
+        uint32_t prev = tables[k - 1][i];
+        tables[k][i] = (prev >> 8) ^ tables[0][prev & 0xFF];
+      }
+    }
+  }
+};
+
+constexpr crc_tables<0xEDB88320U> crc32_tables;
+constexpr crc_tables<0x82F63B78U> crc32c_tables;
+
+uint32_t read32(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint64_t read64(const uint8_t* p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+template<uint32_t Poly>
+uint32_t crc_slicing_by_8(const crc_tables<Poly>& crc_tables, const uint8_t* p, size_t size, uint32_t crc) {
+  const auto& t = crc_tables.tables;
+
+  for (; size >= 8; size -= 8, p += 8) {
+    uint32_t lo = read32(p) ^ crc;
+    uint32_t hi = read32(p + 4);
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+        ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+  }
+
+  for (; size; size--, p++) {
+    crc = t[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+  }
+
+  return crc;
+}
+
+#if UBIK_HASH_SSE42
+
+#if defined(_MSC_VER)
+#define UBIK_TARGET_SSE42
+#else
+#define UBIK_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+
+bool has_sse42() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+#else
+  return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+UBIK_TARGET_SSE42 uint32_t crc32c_hw(const uint8_t* p, size_t size, uint32_t crc) {
+  uint64_t crc64 = crc;
+  for (; size >= 8; size -= 8, p += 8) {
+    crc64 = _mm_crc32_u64(crc64, read64(p));
+  }
+
+  crc = (uint32_t) crc64;
+  for (; size; size--, p++) {
+    crc = _mm_crc32_u8(crc, *p);
+  }
+  return crc;
+}
+
+#elif UBIK_HASH_ARM_CRC
+
+uint32_t crc32c_hw(const uint8_t* p, size_t size, uint32_t crc) {
+  for (; size >= 8; size -= 8, p += 8) {
+    crc = __crc32cd(crc, read64(p));
+  }
+
+  for (; size; size--, p++) {
+    crc = __crc32cb(crc, *p);
+  }
+  return crc;
+}
+
+#endif
+
+constexpr uint64_t prime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t prime64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t prime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t prime64_5 = 0x27D4EB2F165667C5ULL;
+
+uint64_t rotl64(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+uint64_t round64(uint64_t acc, uint64_t input) {
+  acc += input * prime64_2;
+  acc = rotl64(acc, 31);
+  return acc * prime64_1;
+}
+
+uint64_t merge_round64(uint64_t acc, uint64_t val) {
+  acc ^= round64(0, val);
+  return acc * prime64_1 + prime64_4;
+}
+
+}
+
+namespace utils {
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc) {
+  return ~crc_slicing_by_8(crc32_tables, static_cast<const uint8_t*>(data), size, ~crc);
+}
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+  const auto* p = static_cast<const uint8_t*>(data);
+
+#if UBIK_HASH_SSE42
+  static const bool hw = has_sse42();
+  if (hw)
+    return ~crc32c_hw(p, size, ~crc);
+#elif UBIK_HASH_ARM_CRC
+  return ~crc32c_hw(p, size, ~crc);
+#endif
+
+  return ~crc_slicing_by_8(crc32c_tables, p, size, ~crc);
+}
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+  const auto* p = static_cast<const uint8_t*>(data);
+  const uint8_t* end = p + size;
+  uint64_t h;
+
+  if (size >= 32) {
+    uint64_t v1 = seed + prime64_1 + prime64_2;
+    uint64_t v2 = seed + prime64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - prime64_1;
+
+    const uint8_t* limit = end - 32;
+    do {
+      v1 = round64(v1, read64(p));
+      v2 = round64(v2, read64(p + 8));
+      v3 = round64(v3, read64(p + 16));
+      v4 = round64(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = merge_round64(h, v1);
+    h = merge_round64(h, v2);
+    h = merge_round64(h, v3);
+    h = merge_round64(h, v4);
+  } else {
+    h = seed + prime64_5;
+  }
+
+  h += (uint64_t) size;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= round64(0, read64(p));
+    h = rotl64(h, 27) * prime64_1 + prime64_4;
+  }
+
+  if (p + 4 <= end) {
+    h ^= (uint64_t) read32(p) * prime64_1;
+    h = rotl64(h, 23) * prime64_2 + prime64_3;
+    p += 4;
+  }
+
+  for (; p < end; p++) {
+    h ^= (*p) * prime64_5;
+    h = rotl64(h, 11) * prime64_1;
+  }
+
+  h ^= h >> 33;
+  h *= prime64_2;
+  h ^= h >> 29;
+  h *= prime64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+
+// CRC-32 (IEEE 802.3), slicing-by-8. Gives the same values as byte-at-a-time crc32 from crc32.h.
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+// CRC-32C (Castagnoli). Uses crc32 instructions of SSE4.2 or ARMv8 when the cpu has them.
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+// 64-bit non-cryptographic hash with xxHash64 output, used to address buffer contents.
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+}
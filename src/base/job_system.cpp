@@ -0,0 +1,50 @@
+#include "job_system.h"
+
+job_system::job_system(uint32_t workers_count) {
+  workers_.reserve(workers_count);
+  for (uint32_t i = 0; i < workers_count; i++) {
+    workers_.emplace_back(&job_system::worker_loop, this);
+  }
+}
+
+job_system::~job_system() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+uint32_t job_system::default_workers_count() {
+  uint32_t hardware_threads = std::thread::hardware_concurrency();
+  return hardware_threads > 1 ? hardware_threads - 1 : 1;
+}
+
+void job_system::push(std::function<void()> job) {
+  {
+    std::lock_guard lock(mutex_);
+    jobs_.push_back(std::move(job));
+  }
+  cv_.notify_one();
+}
+
+void job_system::worker_loop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+      if (stop_ && jobs_.empty())
+        return;
+
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+
+    job();
+  }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class job_system {
+ public:
+  explicit job_system(uint32_t workers_count = default_workers_count());
+  ~job_system();
+
+  job_system(const job_system&) = delete;
+  job_system& operator=(const job_system&) = delete;
+
+  template<class F>
+  auto submit(F&& func) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+    using result_t = std::invoke_result_t<std::decay_t<F>>;
+    auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(func));
+    std::future<result_t> future = task->get_future();
+    push([task]() { (*task)(); });
+    return future;
+  }
+
+  // Splits [0, count) into batches of batch_size and invokes func(first, last) for each of them.
+  // The calling thread takes part in the work and returns when all the batches are done.
+  template<class F>
+  void parallel_for(size_t count, size_t batch_size, F&& func) {
+    if (!count)
+      return;
+
+    batch_size = std::max<size_t>(batch_size, 1);
+    const size_t batches = (count + batch_size - 1) / batch_size;
+    if (batches == 1 || workers_.empty()) {
+      func(size_t(0), count);
+      return;
+    }
+
+    struct state {
+      std::atomic<size_t> next { 0 };
+      std::atomic<size_t> done { 0 };
+      std::mutex mutex;
+      std::condition_variable cv;
+    };
+
+    auto shared = std::make_shared<state>();
+    auto run = [shared, count, batch_size, batches, &func]() {
+      size_t batch;
+      while ((batch = shared->next.fetch_add(1)) < batches) {
+        size_t first = batch * batch_size;
+        func(first, std::min(first + batch_size, count));
+        if (shared->done.fetch_add(1) + 1 == batches) {
+          std::lock_guard lock(shared->mutex);
+          shared->cv.notify_all();
+        }
+      }
+    };
+
+    const size_t helpers = std::min(batches - 1, workers_.size());
+    for (size_t i = 0; i < helpers; i++) {
+      push(run);
+    }
+
+    run();
+
+    std::unique_lock lock(shared->mutex);
+    shared->cv.wait(lock, [&]() { return shared->done.load() == batches; });
+  }
+
+  [[nodiscard]] size_t workers_count() const { return workers_.size(); }
+
+  static uint32_t default_workers_count();
+
+ private:
+  void push(std::function<void()> job);
+  void worker_loop();
+
+ private:
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> jobs_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+};
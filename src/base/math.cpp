@@ -123,6 +123,19 @@ mat4 mat4::inverse(const mat4& mat) {
       { w | x,          w | y,          w | z,          1.0f }
   }};
 }
+mat4 operator*(const mat4& lhs, const mat4& rhs) {
+  mat4 result;
+  for (uint32_t i = 0; i < 4; i++) {
+    for (uint32_t j = 0; j < 4; j++) {
+      result.data[i][j] = lhs.data[i][0] * rhs.data[0][j]
+                        + lhs.data[i][1] * rhs.data[1][j]
+                        + lhs.data[i][2] * rhs.data[2][j]
+                        + lhs.data[i][3] * rhs.data[3][j];
+    }
+  }
+  return result;
+}
+
 mat4 mat4::translation(const vec3 &trans) {
   return {{
               {1.0f, 0.0f, 0.0f, 0.0f},
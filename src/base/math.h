@@ -67,6 +67,11 @@ struct vec4 {
 bool operator==(vec2 lhs, vec2 rhs);
 bool operator!=(vec2 lhs, vec2 rhs);
 
+struct aabb {
+  vec3 min;
+  vec3 max;
+};
+
 struct mat4 {
   float data[4][4] = {
       { 1.0f, 0.0f, 0.0f, 0.0f },
@@ -121,6 +126,8 @@ struct quat {
   static quat basis(const vec3 &right, const vec3 &up, const vec3 &forward);
 };
 
+mat4 operator*(const mat4& lhs, const mat4& rhs);
+
 quat operator*(const quat& lhs, const quat& rhs);
 vec3 operator*(const vec3& lhs, const vec3& rhs);
 vec3 operator*(float lhs, const vec3& rhs);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Reader-writer mutex which can be locked again by the thread holding it, shared or exclusively.
+// Shared lock can't be upgraded to exclusive one, trying to throws std::logic_error instead of deadlocking.
+class reentrant_shared_mutex {
+ public:
+  void lock() {
+    auto self = std::this_thread::get_id();
+    if (owner_.load(std::memory_order_relaxed) != self) {
+      if (find_shared() != held_shared().end())
+        throw std::logic_error("reentrant_shared_mutex locked exclusively by thread holding it shared");
+
+      mutex_.lock();
+      owner_.store(self, std::memory_order_relaxed);
+    }
+    ++depth_;
+  }
+
+  void unlock() {
+    assert(owner_.load(std::memory_order_relaxed) == std::this_thread::get_id());
+    if (--depth_)
+      return;
+
+    owner_.store(std::thread::id(), std::memory_order_relaxed);
+    mutex_.unlock();
+  }
+
+  void lock_shared() {
+    if (owner_.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+      ++depth_;
+      return;
+    }
+
+    if (auto it = find_shared(); it != held_shared().end()) {
+      ++it->depth;
+      return;
+    }
+
+    mutex_.lock_shared();
+    held_shared().push_back({ this, 1 });
+  }
+
+  void unlock_shared() {
+    if (owner_.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+      --depth_;
+      return;
+    }
+
+    auto it = find_shared();
+    assert(it != held_shared().end());
+    if (--it->depth)
+      return;
+
+    held_shared().erase(it);
+    mutex_.unlock_shared();
+  }
+
+  // True if the calling thread holds the mutex shared, then it can't lock it exclusively.
+  [[nodiscard]] bool held_shared_by_this_thread() const {
+    return owner_.load(std::memory_order_relaxed) != std::this_thread::get_id() && find_shared() != held_shared().end();
+  }
+
+ private:
+  struct shared_hold {
+    const reentrant_shared_mutex* mutex;
+    uint32_t depth;
+  };
+
+  // a thread rarely holds more than one or two of these
+  static std::vector<shared_hold>& held_shared() {
+    thread_local std::vector<shared_hold> held;
+    return held;
+  }
+
+  std::vector<shared_hold>::iterator find_shared() const {
+    auto& held = held_shared();
+    return std::find_if(held.begin(), held.end(), [this](const shared_hold& h) { return h.mutex == this; });
+  }
+
+ private:
+  std::shared_mutex mutex_;
+  std::atomic<std::thread::id> owner_;
+  uint32_t depth_ = 0;
+};
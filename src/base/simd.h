@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define UBIK_SIMD_SSE 1
+#   include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   define UBIK_SIMD_NEON 1
+#   include <arm_neon.h>
+#endif
+
+#ifndef UBIK_SIMD_SSE
+#define UBIK_SIMD_SSE 0
+#endif
+
+#ifndef UBIK_SIMD_NEON
+#define UBIK_SIMD_NEON 0
+#endif
+
+namespace simd {
+
+#if UBIK_SIMD_SSE
+
+using float4 = __m128;
+
+inline float4 load(const float* ptr) { return _mm_loadu_ps(ptr); }
+inline void store(float* ptr, float4 v) { _mm_storeu_ps(ptr, v); }
+inline float4 set1(float v) { return _mm_set1_ps(v); }
+inline float4 set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+
+inline float4 add(float4 a, float4 b) { return _mm_add_ps(a, b); }
+inline float4 sub(float4 a, float4 b) { return _mm_sub_ps(a, b); }
+inline float4 mul(float4 a, float4 b) { return _mm_mul_ps(a, b); }
+inline float4 min(float4 a, float4 b) { return _mm_min_ps(a, b); }
+inline float4 max(float4 a, float4 b) { return _mm_max_ps(a, b); }
+inline float4 abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline float4 madd(float4 a, float4 b, float4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+// Returns 4-bit mask where bit i is set if a[i] < b[i].
+inline uint32_t less_mask(float4 a, float4 b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+inline uint32_t greater_mask(float4 a, float4 b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+
+#elif UBIK_SIMD_NEON
+
+using float4 = float32x4_t;
+
+inline float4 load(const float* ptr) { return vld1q_f32(ptr); }
+inline void store(float* ptr, float4 v) { vst1q_f32(ptr, v); }
+inline float4 set1(float v) { return vdupq_n_f32(v); }
+inline float4 set(float x, float y, float z, float w) { const float v[4] = { x, y, z, w }; return vld1q_f32(v); }
+
+inline float4 add(float4 a, float4 b) { return vaddq_f32(a, b); }
+inline float4 sub(float4 a, float4 b) { return vsubq_f32(a, b); }
+inline float4 mul(float4 a, float4 b) { return vmulq_f32(a, b); }
+inline float4 min(float4 a, float4 b) { return vminq_f32(a, b); }
+inline float4 max(float4 a, float4 b) { return vmaxq_f32(a, b); }
+inline float4 abs(float4 a) { return vabsq_f32(a); }
+inline float4 madd(float4 a, float4 b, float4 c) { return vmlaq_f32(c, a, b); }
+
+inline uint32_t to_mask(uint32x4_t v) {
+  static const uint32_t bits[4] = { 1, 2, 4, 8 };
+  return vaddvq_u32(vandq_u32(v, vld1q_u32(bits)));
+}
+
+inline uint32_t less_mask(float4 a, float4 b) { return to_mask(vcltq_f32(a, b)); }
+inline uint32_t greater_mask(float4 a, float4 b) { return to_mask(vcgtq_f32(a, b)); }
+
+#else
+
+struct float4 {
+  float v[4];
+};
+
+template<class F>
+inline float4 apply(float4 a, float4 b, F func) {
+  return {{ func(a.v[0], b.v[0]), func(a.v[1], b.v[1]), func(a.v[2], b.v[2]), func(a.v[3], b.v[3]) }};
+}
+
+inline float4 load(const float* ptr) { return {{ ptr[0], ptr[1], ptr[2], ptr[3] }}; }
+inline void store(float* ptr, float4 v) { for (uint32_t i = 0; i < 4; i++) ptr[i] = v.v[i]; }
+inline float4 set1(float v) { return {{ v, v, v, v }}; }
+inline float4 set(float x, float y, float z, float w) { return {{ x, y, z, w }}; }
+
+inline float4 add(float4 a, float4 b) { return apply(a, b, [](float x, float y) { return x + y; }); }
+inline float4 sub(float4 a, float4 b) { return apply(a, b, [](float x, float y) { return x - y; }); }
+inline float4 mul(float4 a, float4 b) { return apply(a, b, [](float x, float y) { return x * y; }); }
+inline float4 min(float4 a, float4 b) { return apply(a, b, [](float x, float y) { return x < y ? x : y; }); }
+inline float4 max(float4 a, float4 b) { return apply(a, b, [](float x, float y) { return x > y ? x : y; }); }
+inline float4 abs(float4 a) { return apply(a, a, [](float x, float) { return x < 0.0f ? -x : x; }); }
+inline float4 madd(float4 a, float4 b, float4 c) { return add(mul(a, b), c); }
+
+inline uint32_t less_mask(float4 a, float4 b) {
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < 4; i++) mask |= (a.v[i] < b.v[i] ? 1u : 0u) << i;
+  return mask;
+}
+
+inline uint32_t greater_mask(float4 a, float4 b) { return less_mask(b, a); }
+
+#endif
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Fixed size object pool. Memory is taken from slabs of SlabSize objects and freed objects are reused,
+// slabs are returned to the system by trim once every object in them was freed, or with the pool.
+template<class T, size_t SlabSize = 256>
+class slab_pool {
+ public:
+  slab_pool() = default;
+
+  slab_pool(const slab_pool&) = delete;
+  slab_pool& operator=(const slab_pool&) = delete;
+
+  template<class ...Args>
+  T* create(Args&&... args) {
+    return new (allocate()) T(std::forward<Args>(args)...);
+  }
+
+  void destroy(T* ptr) {
+    ptr->~T();
+    deallocate(ptr);
+  }
+
+  // Destroys objects and puts them on the free list in one splice.
+  void destroy(T* const* ptrs, size_t count) {
+    if (!count)
+      return;
+
+    for (size_t i = 0; i < count; i++) {
+      ptrs[i]->~T();
+      reinterpret_cast<node*>(ptrs[i])->next = i + 1 < count ? reinterpret_cast<node*>(ptrs[i + 1]) : free_;
+    }
+    free_ = reinterpret_cast<node*>(ptrs[0]);
+  }
+
+  // Releases slabs with no live objects, the one being filled is kept. Returns count of released slabs.
+  size_t trim() {
+    if (slabs_.size() < 2)
+      return 0;
+
+    std::vector<slot*> sorted(slabs_.size() - 1);
+    for (size_t i = 0; i + 1 < slabs_.size(); i++) {
+      sorted[i] = slabs_[i].get();
+    }
+    std::sort(sorted.begin(), sorted.end(), std::less<>());
+
+    auto slab_of = [&](node* n) -> ptrdiff_t {
+      auto* s = reinterpret_cast<slot*>(n);
+      auto it = std::upper_bound(sorted.begin(), sorted.end(), s, std::less<>());
+      if (it == sorted.begin() || !std::less<>()(s, *(it - 1) + SlabSize))
+        return -1;
+      return it - sorted.begin() - 1;
+    };
+
+    std::vector<size_t> free_counts(sorted.size());
+    for (node* n = free_; n; n = n->next) {
+      if (ptrdiff_t slab = slab_of(n); slab >= 0) {
+        free_counts[slab]++;
+      }
+    }
+
+    if (std::find(free_counts.begin(), free_counts.end(), SlabSize) == free_counts.end())
+      return 0;
+
+    node** link = &free_;
+    while (*link) {
+      ptrdiff_t slab = slab_of(*link);
+      if (slab >= 0 && free_counts[slab] == SlabSize) {
+        *link = (*link)->next;
+      } else {
+        link = &(*link)->next;
+      }
+    }
+
+    auto released = std::remove_if(slabs_.begin(), slabs_.end() - 1, [&](const std::unique_ptr<slot[]>& s) {
+      return free_counts[std::lower_bound(sorted.begin(), sorted.end(), s.get(), std::less<>()) - sorted.begin()] == SlabSize;
+    });
+    size_t count = (slabs_.end() - 1) - released;
+    std::move(slabs_.end() - 1, slabs_.end(), released);
+    slabs_.resize(slabs_.size() - count);
+    return count;
+  }
+
+  void* allocate() {
+    if (free_) {
+      node* n = free_;
+      free_ = n->next;
+      return n;
+    }
+
+    if (slabs_.empty() || used_ == SlabSize) {
+      slabs_.emplace_back(new slot[SlabSize]);
+      used_ = 0;
+    }
+
+    return &slabs_.back()[used_++];
+  }
+
+  void deallocate(void* ptr) {
+    auto* n = static_cast<node*>(ptr);
+    n->next = free_;
+    free_ = n;
+  }
+
+  [[nodiscard]] size_t capacity() const { return slabs_.size() * SlabSize; }
+
+ private:
+  struct node {
+    node* next;
+  };
+
+  union slot {
+    node free;
+    alignas(T) unsigned char data[sizeof(T)];
+  };
+
+ private:
+  std::vector<std::unique_ptr<slot[]>> slabs_;
+  size_t used_ = SlabSize;
+  node* free_ = nullptr;
+};
@@ -0,0 +1,76 @@
+#include "symbol.h"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace {
+
+class symbol_table {
+ public:
+  symbol_table() {
+    intern_unlocked("");
+#define UBIK_SYMBOL_INTERN(id, str) intern_unlocked(str);
+    UBIK_PREDEFINED_SYMBOLS(UBIK_SYMBOL_INTERN)
+#undef UBIK_SYMBOL_INTERN
+  }
+
+  uint32_t intern(std::string_view str) {
+    {
+      std::shared_lock lock(mutex_);
+      if (auto it = index_.find(str); it != index_.end())
+        return it->second;
+    }
+
+    std::unique_lock lock(mutex_);
+    return intern_unlocked(str);
+  }
+
+  uint32_t find(std::string_view str) const {
+    std::shared_lock lock(mutex_);
+    auto it = index_.find(str);
+    return it != index_.end() ? it->second : 0;
+  }
+
+  const std::string& str(uint32_t id) const {
+    std::shared_lock lock(mutex_);
+    return strings_[id];
+  }
+
+ private:
+  uint32_t intern_unlocked(std::string_view str) {
+    if (auto it = index_.find(str); it != index_.end())
+      return it->second;
+
+    auto id = (uint32_t) strings_.size();
+    // deque keeps references valid, index keys point into stored strings
+    const std::string& stored = strings_.emplace_back(str);
+    index_.emplace(stored, id);
+    return id;
+  }
+
+ private:
+  mutable std::shared_mutex mutex_;
+  std::deque<std::string> strings_;
+  std::unordered_map<std::string_view, uint32_t> index_;
+};
+
+symbol_table& table() {
+  static symbol_table table;
+  return table;
+}
+
+}
+
+symbol::symbol(std::string_view str)
+  : id_(table().intern(str))
+{}
+
+symbol symbol::find(std::string_view str) {
+  return from_id(table().find(str));
+}
+
+const std::string& symbol::str() const {
+  return table().str(id_);
+}
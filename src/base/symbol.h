@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Strings interned at startup, they get fixed ids and are available as compile-time constants in symbols namespace.
+#define UBIK_PREDEFINED_SYMBOLS(X)      \
+  X(guid_, "__guid")                    \
+  X(type_, "__type")                    \
+  X(buffer_hash_, "__buffer_hash")      \
+  X(ref_, "__ref")                      \
+  X(vec2_, "__vec2")                    \
+  X(vec3_, "__vec3")                    \
+  X(vec4_, "__vec4")                    \
+  X(quat_, "__quat")                    \
+  X(mat4_, "__mat4")                    \
+  X(float_array_, "__float_array")      \
+  X(int_array_, "__int_array")          \
+  X(name, "name")                       \
+  X(children, "children")               \
+  X(components, "components")           \
+  X(position, "position")               \
+  X(rotation, "rotation")               \
+  X(scale, "scale")                     \
+  X(x, "x")                             \
+  X(y, "y")                             \
+  X(z, "z")                             \
+  X(w, "w")                             \
+  X(mesh, "mesh")                       \
+  X(meshes, "meshes")                   \
+  X(texture, "texture")                 \
+  X(attributes, "attributes")           \
+  X(indices, "indices")                 \
+  X(semantic, "semantic")               \
+  X(accessor, "accessor")               \
+  X(buffer, "buffer")                   \
+  X(data, "data")                       \
+  X(size, "size")                       \
+  X(count, "count")                     \
+  X(offset, "offset")                   \
+  X(unsigned_, "unsigned")              \
+  X(float_, "float")                    \
+  X(occluder, "occluder")               \
+  X(fov, "fov")                         \
+  X(near_, "near")                      \
+  X(far_, "far")                        \
+  X(orthogonal_size, "orthogonal_size") \
+  X(normalized_rect, "normalized_rect")
+
+// Interned string. Comparison and hashing work on the id, text is stored once in the global symbol table.
+class symbol {
+ public:
+  constexpr symbol() noexcept = default;
+  symbol(std::string_view str);
+  symbol(const char* str) : symbol(std::string_view(str)) {}
+  symbol(const std::string& str) : symbol(std::string_view(str)) {}
+
+  static constexpr symbol from_id(uint32_t id) noexcept {
+    symbol result;
+    result.id_ = id;
+    return result;
+  }
+
+  // Returns empty symbol if the string hasn't been interned.
+  static symbol find(std::string_view str);
+
+  [[nodiscard]] constexpr uint32_t id() const noexcept { return id_; }
+  [[nodiscard]] constexpr bool empty() const noexcept { return id_ == 0; }
+
+  [[nodiscard]] const std::string& str() const;
+  [[nodiscard]] const char* c_str() const { return str().c_str(); }
+
+  operator const std::string&() const { return str(); }
+
+  constexpr bool operator==(symbol other) const noexcept { return id_ == other.id_; }
+  constexpr bool operator!=(symbol other) const noexcept { return id_ != other.id_; }
+  constexpr bool operator<(symbol other) const noexcept { return id_ < other.id_; }
+
+ private:
+  uint32_t id_ = 0;
+};
+
+template<>
+struct std::hash<symbol> {
+  size_t operator()(symbol s) const noexcept {
+    return std::hash<uint32_t>()(s.id());
+  }
+};
+
+namespace symbols {
+
+namespace ids {
+enum : uint32_t {
+  empty,
+#define UBIK_SYMBOL_ID(id, str) id,
+  UBIK_PREDEFINED_SYMBOLS(UBIK_SYMBOL_ID)
+#undef UBIK_SYMBOL_ID
+};
+}
+
+#define UBIK_SYMBOL_CONSTANT(id, str) inline constexpr symbol id = symbol::from_id(ids::id);
+UBIK_PREDEFINED_SYMBOLS(UBIK_SYMBOL_CONSTANT)
+#undef UBIK_SYMBOL_CONSTANT
+
+}
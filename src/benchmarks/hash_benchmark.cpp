@@ -0,0 +1,42 @@
+#include "base/crc32.h"
+#include "base/hash.h"
+#include "base/timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+template<class F>
+static void run(const char* name, const std::vector<uint8_t>& data, size_t size, F&& func) {
+  const size_t iterations = std::max<size_t>(1, (size_t(256) << 20) / size);
+
+  uint64_t sink = 0;
+  timer timer;
+  for (size_t i = 0; i < iterations; i++) {
+    sink += func(data.data(), size);
+  }
+  float seconds = std::max(timer.time().as_seconds(), 1e-6f);
+
+  double gbps = (double) size * (double) iterations / seconds / 1e9;
+  std::printf("%-16s %10zu B %8.2f GB/s  (%016llx)\n", name, size, gbps, (unsigned long long) sink);
+}
+
+// Usage: hash_benchmark [max size in bytes]
+int main(int argc, char** argv) {
+  const size_t max_size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : size_t(16) << 20;
+
+  std::vector<uint8_t> data(max_size);
+  std::mt19937 rng(42);
+  for (auto& v : data) {
+    v = (uint8_t) rng();
+  }
+
+  for (size_t size = 64; size <= max_size; size *= 16) {
+    run("crc32 bytewise", data, size, [](const uint8_t* p, size_t n) { return utils::crc32(p, p + n); });
+    run("crc32 slice8", data, size, [](const uint8_t* p, size_t n) { return utils::crc32(p, n); });
+    run("crc32c", data, size, [](const uint8_t* p, size_t n) { return utils::crc32c(p, n); });
+    run("hash64", data, size, [](const uint8_t* p, size_t n) { return utils::hash64(p, n); });
+  }
+}
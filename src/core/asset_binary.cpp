@@ -0,0 +1,479 @@
+#include "asset_binary.h"
+#include "asset_repository.h"
+#include "base/log.h"
+#include "buffer_store.h"
+
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+constexpr uint8_t magic[4] = { 'U', 'B', 'K', 'A' };
+// version 2 added references, version 3 vectors, matrices and typed arrays, older files are still read
+constexpr uint8_t format_version = 3;
+constexpr size_t header_size = sizeof(magic) + 1 + 16;
+constexpr uint32_t max_depth = 256;
+
+enum class value_tag : uint8_t {
+  NONE,
+  BOOLEAN_FALSE,
+  BOOLEAN_TRUE,
+  INTEGER,
+  UNSIGNED,
+  FLOAT,
+  STRING,
+  ARRAY,
+  OBJECT,
+  BUFFER,
+  REFERENCE,
+  VEC2,
+  VEC3,
+  VEC4,
+  QUAT,
+  MAT4,
+  FLOAT_ARRAY,
+  INT_ARRAY
+};
+
+class binary_writer {
+ public:
+  binary_writer(asset_repository& rep, std::vector<buffer_id>& buffers)
+    : rep_(rep), buffers_(buffers)
+  {}
+
+  void write_value(const asset_value& val) {
+    switch ((asset_value::type) val) {
+      case asset_value::type::BOOLEAN: {
+        write_tag(val.get<bool>() ? value_tag::BOOLEAN_TRUE : value_tag::BOOLEAN_FALSE);
+        break;
+      }
+      case asset_value::type::INTEGER: {
+        auto v = val.get<int64_t>();
+        write_tag(value_tag::INTEGER);
+        write_varint(((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+        break;
+      }
+      case asset_value::type::UNSIGNED: {
+        write_tag(value_tag::UNSIGNED);
+        write_varint(val.get<uint64_t>());
+        break;
+      }
+      case asset_value::type::FLOAT: {
+        auto v = val.get<float>();
+        write_tag(value_tag::FLOAT);
+        write_raw(&v, sizeof(v));
+        break;
+      }
+      case asset_value::type::STRING: {
+        write_tag(value_tag::STRING);
+        write_varint(string_index(val.get<std::string_view>()));
+        break;
+      }
+      case asset_value::type::ARRAY: {
+        auto& array = val.get<asset_array&>();
+        write_tag(value_tag::ARRAY);
+        write_varint(array.size());
+        for (auto& sub : array) {
+          write_value(sub);
+        }
+        break;
+      }
+      case asset_value::type::OBJECT: {
+        write_object(val);
+        break;
+      }
+      case asset_value::type::BUFFER: {
+        buffer_id id = val;
+        buffers_.push_back(id);
+        uint64_t hash = rep_.buffer_hash(id);
+        write_tag(value_tag::BUFFER);
+        write_raw(&hash, sizeof(hash));
+        break;
+      }
+      case asset_value::type::REFERENCE: {
+        write_tag(value_tag::REFERENCE);
+        write_raw(val.get<guid>().bytes().data(), 16);
+        break;
+      }
+      case asset_value::type::VEC2:
+      case asset_value::type::VEC3:
+      case asset_value::type::VEC4:
+      case asset_value::type::QUAT:
+      case asset_value::type::MAT4: {
+        // tags follow the same order as value types
+        write_tag((value_tag) ((uint8_t) value_tag::VEC2 + ((uint8_t) (asset_value::type) val - (uint8_t) asset_value::type::VEC2)));
+        write_raw(val.floats(), sizeof(float) * val.floats_count());
+        break;
+      }
+      case asset_value::type::FLOAT_ARRAY: {
+        auto& floats = val.get<const asset_value::float_array&>();
+        write_tag(value_tag::FLOAT_ARRAY);
+        write_varint(floats.size());
+        write_raw(floats.data(), sizeof(float) * floats.size());
+        break;
+      }
+      case asset_value::type::INT_ARRAY: {
+        auto& ints = val.get<const asset_value::int_array&>();
+        write_tag(value_tag::INT_ARRAY);
+        write_varint(ints.size());
+        for (int32_t v : ints) {
+          write_varint(((uint32_t) v << 1) ^ (uint32_t) (v >> 31));
+        }
+        break;
+      }
+      case asset_value::type::NONE: {
+        write_tag(value_tag::NONE);
+        break;
+      }
+    }
+  }
+
+  void write_object(const asset& obj) {
+    write_tag(value_tag::OBJECT);
+    write_raw(rep_.get_guid(obj).bytes().data(), 16);
+
+    // guid is stored raw, the property is restored on load
+    size_t count = obj.size() - (obj.contains(symbols::guid_) ? 1 : 0);
+    write_varint(count);
+    for (auto& [name, sub] : obj) {
+      if (name == symbols::guid_)
+        continue;
+
+      write_varint(string_index(name.str()));
+      write_value(sub);
+    }
+  }
+
+  std::vector<uint8_t> finish(const guid& root) {
+    std::vector<uint8_t> body = std::move(body_);
+    body_.clear();
+
+    write_raw(magic, sizeof(magic));
+    write_raw(&format_version, 1);
+    write_raw(root.bytes().data(), 16);
+    write_varint(strings_.size());
+    for (std::string_view str : strings_) {
+      write_varint(str.size());
+      write_raw(str.data(), str.size());
+    }
+
+    body_.insert(body_.end(), body.begin(), body.end());
+    return std::move(body_);
+  }
+
+ private:
+  uint32_t string_index(std::string_view str) {
+    auto [it, inserted] = string_indices_.emplace(str, (uint32_t) strings_.size());
+    if (inserted) {
+      strings_.push_back(str);
+    }
+    return it->second;
+  }
+
+  void write_tag(value_tag tag) {
+    body_.push_back((uint8_t) tag);
+  }
+
+  void write_varint(uint64_t v) {
+    while (v >= 0x80) {
+      body_.push_back((uint8_t) (v | 0x80));
+      v >>= 7;
+    }
+    body_.push_back((uint8_t) v);
+  }
+
+  void write_raw(const void* data, size_t size) {
+    auto* p = static_cast<const uint8_t*>(data);
+    body_.insert(body_.end(), p, p + size);
+  }
+
+ private:
+  asset_repository& rep_;
+  std::vector<buffer_id>& buffers_;
+  std::vector<uint8_t> body_;
+  // views point into symbol table and asset strings, both outlive the writer
+  std::vector<std::string_view> strings_;
+  std::unordered_map<std::string_view, uint32_t> string_indices_;
+};
+
+class binary_reader {
+ public:
+  binary_reader(const uint8_t* data, size_t size, asset_repository& rep, const buffer_locator& locate)
+    : p_(data), end_(data + size), rep_(rep), locate_(locate)
+  {}
+
+  bool read_strings() {
+    uint64_t count;
+    if (!read_varint(count) || count > (uint64_t) (end_ - p_))
+      return false;
+
+    strings_.resize(count);
+    keys_.resize(count);
+    for (auto& str : strings_) {
+      uint64_t size;
+      if (!read_varint(size) || size > (uint64_t) (end_ - p_))
+        return false;
+
+      str = { reinterpret_cast<const char*>(p_), (size_t) size };
+      p_ += size;
+    }
+    return true;
+  }
+
+  asset_value read_value(uint32_t depth = 0) {
+    if (p_ == end_ || depth > max_depth)
+      return fail();
+
+    switch ((value_tag) *p_++) {
+      case value_tag::NONE: {
+        return nullptr;
+      }
+      case value_tag::BOOLEAN_FALSE: {
+        return false;
+      }
+      case value_tag::BOOLEAN_TRUE: {
+        return true;
+      }
+      case value_tag::INTEGER: {
+        uint64_t v;
+        if (!read_varint(v))
+          return fail();
+        return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+      }
+      case value_tag::UNSIGNED: {
+        uint64_t v;
+        if (!read_varint(v))
+          return fail();
+        return v;
+      }
+      case value_tag::FLOAT: {
+        float v;
+        if (!read_raw(&v, sizeof(v)))
+          return fail();
+        return v;
+      }
+      case value_tag::STRING: {
+        std::string_view str;
+        if (!read_string(str))
+          return fail();
+        return str;
+      }
+      case value_tag::ARRAY: {
+        uint64_t count;
+        if (!read_varint(count) || count > (uint64_t) (end_ - p_))
+          return fail();
+
+        asset_array& array = rep_.create_array();
+        for (uint64_t i = 0; i < count && !failed_; i++) {
+          rep_.push_back(array, read_value(depth + 1));
+        }
+        return array;
+      }
+      case value_tag::OBJECT: {
+        std::array<uint8_t, 16> bytes {};
+        uint64_t count;
+        if (!read_raw(bytes.data(), bytes.size()) || !read_varint(count) || count > (uint64_t) (end_ - p_))
+          return fail();
+
+        guid guid = guid::from_bytes(bytes);
+        asset& obj = rep_.create_asset(guid);
+        rep_.set_value(obj, symbols::guid_, guid.str());
+
+        for (uint64_t i = 0; i < count && !failed_; i++) {
+          symbol key;
+          if (!read_key(key)) {
+            fail();
+            break;
+          }
+          rep_.set_value(obj, key, read_value(depth + 1));
+        }
+        return obj;
+      }
+      case value_tag::BUFFER: {
+        uint64_t hash;
+        if (!read_raw(&hash, sizeof(hash)))
+          return fail();
+
+        buffer_location location = locate_(hash);
+        if (location.path.empty()) {
+          logger::core::Warning("Couldn't load buffer {}", hash);
+          return rep_.create_buffer(0);
+        }
+
+        if (location.memory)
+          return rep_.create_buffer_from_mapping(location.path, location.offset, location.size, hash, std::move(location.memory));
+        return rep_.create_buffer_from_file(location.path, location.offset, location.size, hash);
+      }
+      case value_tag::REFERENCE: {
+        std::array<uint8_t, 16> bytes {};
+        if (!read_raw(bytes.data(), bytes.size()))
+          return fail();
+        return guid::from_bytes(bytes);
+      }
+      case value_tag::VEC2: {
+        vec2 v;
+        return read_raw(&v.x, sizeof(float) * 2) ? asset_value(v) : fail();
+      }
+      case value_tag::VEC3: {
+        vec3 v;
+        return read_raw(&v.x, sizeof(float) * 3) ? asset_value(v) : fail();
+      }
+      case value_tag::VEC4: {
+        vec4 v;
+        return read_raw(&v.x, sizeof(float) * 4) ? asset_value(v) : fail();
+      }
+      case value_tag::QUAT: {
+        quat v;
+        return read_raw(&v.x, sizeof(float) * 4) ? asset_value(v) : fail();
+      }
+      case value_tag::MAT4: {
+        mat4 m;
+        return read_raw(&m.data[0][0], sizeof(float) * 16) ? asset_value(m) : fail();
+      }
+      case value_tag::FLOAT_ARRAY: {
+        uint64_t count;
+        if (!read_varint(count) || count > (uint64_t) (end_ - p_) / sizeof(float))
+          return fail();
+
+        asset_value::float_array floats(count);
+        read_raw(floats.data(), sizeof(float) * count);
+        return floats;
+      }
+      case value_tag::INT_ARRAY: {
+        uint64_t count;
+        if (!read_varint(count) || count > (uint64_t) (end_ - p_))
+          return fail();
+
+        asset_value::int_array ints(count);
+        for (auto& v : ints) {
+          uint64_t zigzag;
+          if (!read_varint(zigzag))
+            return fail();
+          v = (int32_t) ((uint32_t) (zigzag >> 1) ^ -(uint32_t) (zigzag & 1));
+        }
+        return ints;
+      }
+    }
+
+    return fail();
+  }
+
+  [[nodiscard]] bool peek_object() const { return p_ != end_ && (value_tag) *p_ == value_tag::OBJECT; }
+
+  [[nodiscard]] bool failed() const { return failed_; }
+
+ private:
+  asset_value fail() {
+    failed_ = true;
+    return nullptr;
+  }
+
+  bool read_varint(uint64_t& v) {
+    v = 0;
+    for (uint32_t shift = 0; shift < 64 && p_ != end_; shift += 7) {
+      uint8_t byte = *p_++;
+      v |= (uint64_t) (byte & 0x7F) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool read_raw(void* dst, size_t size) {
+    if ((size_t) (end_ - p_) < size)
+      return false;
+
+    std::memcpy(dst, p_, size);
+    p_ += size;
+    return true;
+  }
+
+  bool read_string(std::string_view& str) {
+    uint64_t index;
+    if (!read_varint(index) || index >= strings_.size())
+      return false;
+
+    str = strings_[index];
+    return true;
+  }
+
+  bool read_key(symbol& key) {
+    uint64_t index;
+    if (!read_varint(index) || index >= strings_.size())
+      return false;
+
+    // every key is interned once per file
+    if (keys_[index].empty()) {
+      keys_[index] = symbol(strings_[index]);
+    }
+    key = keys_[index];
+    return !key.empty();
+  }
+
+ private:
+  const uint8_t* p_;
+  const uint8_t* end_;
+  asset_repository& rep_;
+  const buffer_locator& locate_;
+  std::vector<std::string_view> strings_;
+  std::vector<symbol> keys_;
+  bool failed_ = false;
+};
+
+}
+
+bool is_binary_asset(const uint8_t* data, size_t size) {
+  return size >= header_size && std::memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+guid binary_asset_guid(const uint8_t* data, size_t size) {
+  if (!is_binary_asset(data, size))
+    return guid::invalid();
+
+  std::array<uint8_t, 16> bytes {};
+  std::memcpy(bytes.data(), data + sizeof(magic) + 1, bytes.size());
+  return guid::from_bytes(bytes);
+}
+
+std::vector<uint8_t> asset_to_binary(const asset& asset, asset_repository& rep, std::vector<buffer_id>& buffers) {
+  binary_writer writer(rep, buffers);
+  writer.write_object(asset);
+  return writer.finish(rep.get_guid(asset));
+}
+
+asset* parse_binary(const uint8_t* data, size_t size, asset_repository& rep, const fs::path& buffers_path) {
+  return parse_binary(data, size, rep, [&buffers_path](uint64_t hash) {
+    return buffer_location { find_stored_buffer(hash, buffers_path), 0, 0, nullptr };
+  });
+}
+
+asset* parse_binary(const uint8_t* data, size_t size, asset_repository& rep, const buffer_locator& locate) {
+  if (!is_binary_asset(data, size))
+    return nullptr;
+
+  if (data[sizeof(magic)] == 0 || data[sizeof(magic)] > format_version) {
+    logger::core::Error("Unsupported binary asset version {}", data[sizeof(magic)]);
+    return nullptr;
+  }
+
+  binary_reader reader(data + header_size, size - header_size, rep, locate);
+  if (!reader.read_strings())
+    return nullptr;
+
+  // only the root object owns created values, so a failed read is undone by destroying it
+  if (!reader.peek_object())
+    return nullptr;
+
+  asset_value root = reader.read_value();
+  if (!root.is_object())
+    return nullptr;
+
+  asset& root_asset = root;
+  if (reader.failed()) {
+    rep.destroy_asset(root_asset.id());
+    return nullptr;
+  }
+
+  return &root_asset;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "base/guid.h"
+#include "core/buffer_store.h"
+#include "platform/file_system.h"
+
+#include <cstdint>
+#include <vector>
+
+class asset;
+class asset_repository;
+struct buffer_id;
+
+// Binary asset encoding:
+//   header   "UBKA", version byte, root guid (16 bytes)
+//   strings  varint count, then varint length + bytes for every string, keys and string values share the table
+//   root     object value
+// Values start with a tag byte, integers are varints (zigzag for signed), floats are 4 raw bytes, strings are
+// indices into the table, guids and references are 16 raw bytes, vectors and matrices are raw floats, typed arrays
+// are varint count followed by raw floats or zigzag varints, and buffers are 64-bit content hashes naming files
+// in the project buffer store.
+
+bool is_binary_asset(const uint8_t* data, size_t size);
+
+// Returns invalid guid if data isn't a binary asset.
+guid binary_asset_guid(const uint8_t* data, size_t size);
+
+std::vector<uint8_t> asset_to_binary(const asset& asset, asset_repository& rep, std::vector<buffer_id>& buffers);
+
+// Returns null and leaves repository untouched if data is malformed.
+asset* parse_binary(const uint8_t* data, size_t size, asset_repository& rep, const fs::path& buffers_path);
+
+// Buffers are found by locate instead of the project buffer store.
+asset* parse_binary(const uint8_t* data, size_t size, asset_repository& rep, const buffer_locator& locate);
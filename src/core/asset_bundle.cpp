@@ -0,0 +1,298 @@
+#include "asset_bundle.h"
+#include "asset_binary.h"
+#include "asset_repository.h"
+#include "base/log.h"
+#include "platform/os.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+constexpr uint8_t magic[4] = { 'U', 'B', 'K', 'B' };
+constexpr uint32_t format_version = 1;
+constexpr size_t header_size = 32;
+constexpr size_t toc_entry_size = 56;
+
+template<class T>
+void write_pod(std::vector<uint8_t>& out, const T& value) {
+  const auto* p = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+template<class T>
+bool read_pod(const uint8_t*& p, const uint8_t* end, T& value) {
+  if ((size_t) (end - p) < sizeof(T))
+    return false;
+
+  std::memcpy(&value, p, sizeof(T));
+  p += sizeof(T);
+  return true;
+}
+
+class bundle_writer {
+ public:
+  explicit bundle_writer(std::ofstream& file) : file_(file) {
+    std::vector<char> header(header_size);
+    file_.write(header.data(), header.size());
+    offset_ = header_size;
+  }
+
+  void add(bundle_entry entry, const uint8_t* data, size_t size) {
+    static const char padding[bundle_alignment] = {};
+    size_t aligned = (offset_ + bundle_alignment - 1) & ~(bundle_alignment - 1);
+    file_.write(padding, (std::streamsize) (aligned - offset_));
+    file_.write(reinterpret_cast<const char*>(data), (std::streamsize) size);
+
+    entry.offset = aligned;
+    entry.size = size;
+    offset_ = aligned + size;
+    entries_.push_back(std::move(entry));
+  }
+
+  bool finish() {
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> string_indices;
+    auto string_index = [&](const std::string& str) {
+      auto [it, inserted] = string_indices.emplace(str, (uint32_t) strings.size());
+      if (inserted) {
+        strings.push_back(str);
+      }
+      return it->second;
+    };
+
+    std::vector<uint8_t> toc;
+    toc.reserve(entries_.size() * toc_entry_size);
+    for (const bundle_entry& entry : entries_) {
+      toc.insert(toc.end(), entry.id.bytes().begin(), entry.id.bytes().end());
+      write_pod(toc, entry.hash);
+      write_pod(toc, entry.offset);
+      write_pod(toc, entry.size);
+      write_pod(toc, (uint32_t) entry.kind);
+      write_pod(toc, string_index(entry.path));
+      write_pod(toc, string_index(entry.type));
+      write_pod(toc, uint32_t(0));
+    }
+
+    write_pod(toc, (uint32_t) strings.size());
+    for (const std::string& str : strings) {
+      write_pod(toc, (uint32_t) str.size());
+      toc.insert(toc.end(), str.begin(), str.end());
+    }
+    file_.write(reinterpret_cast<const char*>(toc.data()), (std::streamsize) toc.size());
+
+    std::vector<uint8_t> header;
+    header.insert(header.end(), std::begin(magic), std::end(magic));
+    write_pod(header, format_version);
+    write_pod(header, (uint32_t) entries_.size());
+    write_pod(header, uint32_t(0));
+    write_pod(header, (uint64_t) offset_);
+    write_pod(header, (uint64_t) toc.size());
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(header.data()), (std::streamsize) header.size());
+    file_.close();
+    return (bool) file_;
+  }
+
+ private:
+  std::ofstream& file_;
+  size_t offset_ = 0;
+  std::vector<bundle_entry> entries_;
+};
+
+}
+
+bool build_asset_bundle(asset_repository& repository, const std::vector<fs::path>& paths, const fs::path& fullpath) {
+  fs::path tmp = fs::concat(fullpath, ".tmp");
+  std::ofstream file(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file) {
+    logger::core::Error("Couldn't create asset bundle {}", fullpath.c_str());
+    return false;
+  }
+
+  bundle_writer writer(file);
+  std::unordered_map<uint64_t, buffer_id> buffers;
+  std::vector<uint64_t> buffer_order;
+  for (const fs::path& path : paths) {
+    asset* asset = repository.get_asset_by_path(path);
+    if (!asset) {
+      logger::core::Error("Couldn't bundle asset {}: it doesn't exist", path.c_str());
+      continue;
+    }
+
+    bundle_entry entry;
+    std::vector<buffer_id> asset_buffers;
+    std::vector<uint8_t> data = repository.read([&]() {
+      entry.id = repository.get_guid(*asset);
+      return asset_to_binary(*asset, repository, asset_buffers);
+    });
+
+    entry.path = path.generic_string();
+    entry.type = path.extension().string();
+    writer.add(std::move(entry), data.data(), data.size());
+
+    for (buffer_id id : asset_buffers) {
+      uint64_t hash = repository.buffer_hash(id);
+      if (buffers.emplace(hash, id).second) {
+        buffer_order.push_back(hash);
+      }
+    }
+  }
+
+  // buffers go after the assets in the order they are first used, loading a scene reads the file forward
+  for (uint64_t hash : buffer_order) {
+    asset_buffer data = repository.load_buffer(buffers.at(hash));
+
+    bundle_entry entry;
+    entry.kind = bundle_entry_kind::BUFFER;
+    entry.hash = hash;
+    writer.add(std::move(entry), data.data(), data.size());
+  }
+
+  std::error_code error;
+  if (!writer.finish()) {
+    logger::core::Error("Couldn't write asset bundle {}", fullpath.c_str());
+    fs::remove(tmp, error);
+    return false;
+  }
+
+  if (!fs::replace_file(tmp, fullpath)) {
+    logger::core::Error("Couldn't replace asset bundle {}", fullpath.c_str());
+    return false;
+  }
+
+  logger::core::Info("Bundled {} assets and {} buffers at path {}", paths.size(), buffer_order.size(), fullpath.c_str());
+  return true;
+}
+
+bool asset_bundle::open(const fs::path& fullpath) {
+  std::error_code error;
+  size_t size = fs::file_size(fullpath, error);
+  std::shared_ptr<uint8_t> data = error ? nullptr : os::map_file(fullpath, 0, size);
+  if (!data || size < header_size || std::memcmp(data.get(), magic, sizeof(magic)) != 0) {
+    logger::core::Error("Couldn't open asset bundle {}", fullpath.c_str());
+    return false;
+  }
+
+  const uint8_t* p = data.get() + sizeof(magic);
+  const uint8_t* end = data.get() + size;
+  uint32_t version, count, reserved;
+  uint64_t toc_offset, toc_size;
+  read_pod(p, end, version);
+  read_pod(p, end, count);
+  read_pod(p, end, reserved);
+  read_pod(p, end, toc_offset);
+  read_pod(p, end, toc_size);
+  if (version != format_version || toc_offset > size || toc_size > size - toc_offset ||
+      (toc_size - std::min<uint64_t>(toc_size, 4)) / toc_entry_size < count) {
+    logger::core::Error("Unsupported or corrupt asset bundle {}", fullpath.c_str());
+    return false;
+  }
+
+  struct raw_entry {
+    uint32_t path;
+    uint32_t type;
+  };
+
+  std::vector<bundle_entry> entries(count);
+  std::vector<raw_entry> raw(count);
+  p = data.get() + toc_offset;
+  end = p + toc_size;
+  for (uint32_t i = 0; i < count; i++) {
+    std::array<uint8_t, 16> bytes {};
+    std::memcpy(bytes.data(), p, bytes.size());
+    p += bytes.size();
+
+    bundle_entry& entry = entries[i];
+    uint32_t kind, padding;
+    entry.id = guid::from_bytes(bytes);
+    read_pod(p, end, entry.hash);
+    read_pod(p, end, entry.offset);
+    read_pod(p, end, entry.size);
+    read_pod(p, end, kind);
+    read_pod(p, end, raw[i].path);
+    read_pod(p, end, raw[i].type);
+    read_pod(p, end, padding);
+    entry.kind = (bundle_entry_kind) kind;
+
+    if (entry.offset > toc_offset || entry.size > toc_offset - entry.offset) {
+      logger::core::Error("Corrupt asset bundle {}: entry {} is out of the file", fullpath.c_str(), i);
+      return false;
+    }
+  }
+
+  uint32_t strings_count = 0;
+  read_pod(p, end, strings_count);
+  std::vector<std::string> strings;
+  for (uint32_t i = 0; i < strings_count; i++) {
+    uint32_t length;
+    if (!read_pod(p, end, length) || (size_t) (end - p) < length)
+      break;
+
+    strings.emplace_back(reinterpret_cast<const char*>(p), length);
+    p += length;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (raw[i].path >= strings.size() || raw[i].type >= strings.size()) {
+      logger::core::Error("Corrupt asset bundle {}: string table is truncated", fullpath.c_str());
+      return false;
+    }
+    entries[i].path = strings[raw[i].path];
+    entries[i].type = strings[raw[i].type];
+  }
+
+  path_ = fullpath;
+  data_ = std::move(data);
+  size_ = size;
+  entries_ = std::move(entries);
+  guids_.clear();
+  paths_.clear();
+  buffers_.clear();
+  for (size_t i = 0; i < entries_.size(); i++) {
+    const bundle_entry& entry = entries_[i];
+    if (entry.kind == bundle_entry_kind::BUFFER) {
+      buffers_.emplace(entry.hash, i);
+    } else {
+      guids_.emplace(entry.id, i);
+      paths_.emplace(entry.path, i);
+    }
+  }
+
+  logger::core::Info("Opened asset bundle {} with {} assets and {} buffers", path_.c_str(), paths_.size(), buffers_.size());
+  return true;
+}
+
+const bundle_entry* asset_bundle::find(const guid& id) const {
+  auto it = guids_.find(id);
+  return it != guids_.end() ? &entries_[it->second] : nullptr;
+}
+
+const bundle_entry* asset_bundle::find(const fs::path& path) const {
+  auto it = paths_.find(path.generic_string());
+  return it != paths_.end() ? &entries_[it->second] : nullptr;
+}
+
+buffer_location asset_bundle::find_buffer(uint64_t hash) const {
+  auto it = buffers_.find(hash);
+  if (it == buffers_.end())
+    return {};
+
+  // aliases the mapping, the bundle stays mapped while a buffer uses it
+  const bundle_entry& entry = entries_[it->second];
+  return { path_, entry.offset, entry.size, std::shared_ptr<uint8_t>(data_, data_.get() + entry.offset) };
+}
+
+asset* asset_bundle::load(asset_repository& repository, const fs::path& path) const {
+  const bundle_entry* entry = find(path);
+  if (!entry)
+    return nullptr;
+
+  asset* asset = parse_binary(data_.get() + entry->offset, entry->size, repository, [this](uint64_t hash) {
+    return find_buffer(hash);
+  });
+  if (!asset) {
+    logger::core::Error("Couldn't parse asset {} from bundle {}", path.c_str(), path_.c_str());
+  }
+  return asset;
+}
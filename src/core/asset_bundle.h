@@ -0,0 +1,65 @@
+#pragma once
+
+#include "base/guid.h"
+#include "core/buffer_store.h"
+#include "platform/file_system.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class asset;
+class asset_repository;
+
+// Packed bundle layout:
+//   header   "UBKB", version, entry count, offset and size of the table of contents
+//   blobs    binary assets and raw buffers, each aligned to bundle_alignment so it can be mapped in place
+//   toc      entries of { guid, hash, offset, size, kind, path and type string indices }, then the string table
+// Assets are keyed by guid and path, buffers by content hash. Every asset and buffer is stored once.
+constexpr size_t bundle_alignment = 4096;
+
+enum class bundle_entry_kind : uint32_t {
+  ASSET,
+  BUFFER
+};
+
+struct bundle_entry {
+  bundle_entry_kind kind = bundle_entry_kind::ASSET;
+  guid id;
+  uint64_t hash = 0;
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  std::string path;
+  // extension of the asset file
+  std::string type;
+};
+
+// Packs assets with the paths and the buffers they use into one file, writing it atomically.
+bool build_asset_bundle(asset_repository&, const std::vector<fs::path>& paths, const fs::path& fullpath);
+
+// Read-only view of a bundle, the file is mapped once and assets and buffers are served from the mapping.
+class asset_bundle {
+ public:
+  bool open(const fs::path& fullpath);
+
+  [[nodiscard]] const bundle_entry* find(const guid& id) const;
+  [[nodiscard]] const bundle_entry* find(const fs::path& path) const;
+  [[nodiscard]] buffer_location find_buffer(uint64_t hash) const;
+
+  // Parses the bundled asset into the repository, its buffers share the mapping. Returns null if there's none.
+  asset* load(asset_repository&, const fs::path& path) const;
+
+  [[nodiscard]] const fs::path& path() const { return path_; }
+  [[nodiscard]] const std::vector<bundle_entry>& entries() const { return entries_; }
+
+ private:
+  fs::path path_;
+  std::shared_ptr<uint8_t> data_;
+  size_t size_ = 0;
+  std::vector<bundle_entry> entries_;
+  std::unordered_map<guid, size_t> guids_;
+  std::unordered_map<std::string, size_t> paths_;
+  std::unordered_map<uint64_t, size_t> buffers_;
+};
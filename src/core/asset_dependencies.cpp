@@ -0,0 +1,262 @@
+#include "asset_dependencies.h"
+
+#include "base/hash.h"
+#include "base/job_system.h"
+#include "base/json.hpp"
+#include "base/log.h"
+#include "platform/os.h"
+
+#include <fstream>
+
+static constexpr uint32_t dependencies_file_version = 1;
+
+static uint64_t hash_file(const fs::path& fullpath, size_t size) {
+  if (auto data = os::map_file(fullpath, 0, size))
+    return utils::hash64(data.get(), size);
+
+  std::ifstream file(fullpath, std::ios::in | std::ios::binary);
+  std::vector<char> data(size);
+  file.read(data.data(), (std::streamsize) size);
+  return utils::hash64(data.data(), data.size());
+}
+
+static uint64_t hash_string(const std::string& str) {
+  return utils::hash64(str.data(), str.size());
+}
+
+void asset_dependency_graph::add(const fs::path& output, asset_build_inputs inputs, build_func build) {
+  auto [it, inserted] = index_.emplace(output.generic_string(), nodes_.size());
+  if (inserted) {
+    nodes_.emplace_back();
+  }
+
+  node& node = nodes_[it->second];
+  node.output = output;
+  node.inputs = std::move(inputs);
+  node.build = std::move(build);
+}
+
+std::vector<std::vector<size_t>> asset_dependency_graph::sort_levels() {
+  for (node& node : nodes_) {
+    node.dependents.clear();
+    node.pending = 0;
+    node.key = 0;
+    node.failed = false;
+    node.built = false;
+  }
+
+  for (size_t i = 0; i < nodes_.size(); i++) {
+    for (const fs::path& dependency : nodes_[i].inputs.dependencies) {
+      auto it = index_.find(dependency.generic_string());
+      if (it == index_.end()) {
+        logger::core::Warning("Asset {} depends on {} which isn't built by dependency graph", nodes_[i].output.c_str(), dependency.c_str());
+        continue;
+      }
+
+      nodes_[it->second].dependents.push_back(i);
+      nodes_[i].pending++;
+    }
+  }
+
+  std::vector<std::vector<size_t>> levels;
+  std::vector<size_t> level;
+  for (size_t i = 0; i < nodes_.size(); i++) {
+    if (!nodes_[i].pending) {
+      level.push_back(i);
+    }
+  }
+
+  while (!level.empty()) {
+    std::vector<size_t> next;
+    for (size_t i : level) {
+      for (size_t dependent : nodes_[i].dependents) {
+        if (!--nodes_[dependent].pending) {
+          next.push_back(dependent);
+        }
+      }
+    }
+    levels.push_back(std::move(level));
+    level = std::move(next);
+  }
+
+  for (node& node : nodes_) {
+    if (node.pending) {
+      logger::core::Error("Asset {} is part of dependency cycle and won't be built", node.output.c_str());
+      node.failed = true;
+    }
+  }
+
+  return levels;
+}
+
+const asset_dependency_graph::source_record* asset_dependency_graph::find_source(const fs::path& output, const std::string& source) const {
+  auto it = records_.find(output.generic_string());
+  if (it == records_.end())
+    return nullptr;
+
+  auto source_it = it->second.sources.find(source);
+  return source_it != it->second.sources.end() ? &source_it->second : nullptr;
+}
+
+void asset_dependency_graph::build_node(node& node) {
+  node.current = {};
+
+  std::vector<uint64_t> parts {
+    hash_string(node.inputs.importer),
+    node.inputs.importer_version,
+    node.inputs.settings_hash
+  };
+
+  for (const fs::path& source : node.inputs.sources) {
+    fs::path fullpath = fs::to_project_path(source);
+    std::string name = source.generic_string();
+
+    std::error_code error;
+    source_record rec;
+    rec.size = fs::file_size(fullpath, error);
+    if (!error) {
+      rec.time = (int64_t) fs::last_write_time(fullpath, error).time_since_epoch().count();
+    }
+
+    if (error) {
+      logger::core::Error("Couldn't build asset {}: source {} doesn't exist", node.output.c_str(), source.c_str());
+      node.failed = true;
+      return;
+    }
+
+    const source_record* prev = find_source(node.output, name);
+    rec.hash = prev && prev->size == rec.size && prev->time == rec.time ? prev->hash : hash_file(fullpath, rec.size);
+
+    parts.push_back(hash_string(name));
+    parts.push_back(rec.hash);
+    node.current.sources.emplace(std::move(name), rec);
+  }
+
+  for (const fs::path& dependency : node.inputs.dependencies) {
+    auto it = index_.find(dependency.generic_string());
+    if (it == index_.end())
+      continue;
+
+    const auto& dependency_node = nodes_[it->second];
+    if (dependency_node.failed) {
+      logger::core::Warning("Skipped build of asset {} because {} failed", node.output.c_str(), dependency.c_str());
+      node.failed = true;
+      return;
+    }
+    parts.push_back(dependency_node.key);
+  }
+
+  node.key = utils::hash64(parts.data(), parts.size() * sizeof(uint64_t));
+  node.current.key = node.key;
+
+  auto it = records_.find(node.output.generic_string());
+  if (it != records_.end() && it->second.key == node.key && fs::exists(fs::to_project_path(node.output)))
+    return;
+
+  if (!node.build()) {
+    logger::core::Error("Couldn't build asset {}", node.output.c_str());
+    node.failed = true;
+    return;
+  }
+  node.built = true;
+}
+
+asset_build_stats asset_dependency_graph::build(job_system* jobs) {
+  asset_build_stats stats;
+  timer timer;
+
+  stats.nodes = nodes_.size();
+  for (const auto& level : sort_levels()) {
+    auto build_range = [&](size_t first, size_t last) {
+      for (size_t i = first; i < last; i++) {
+        build_node(nodes_[level[i]]);
+      }
+    };
+
+    if (jobs) {
+      jobs->parallel_for(level.size(), 1, build_range);
+    } else {
+      build_range(0, level.size());
+    }
+
+    // records are read by builds of the level, they change only between levels
+    for (size_t i : level) {
+      node& node = nodes_[i];
+      if (node.failed) {
+        records_.erase(node.output.generic_string());
+        continue;
+      }
+
+      records_[node.output.generic_string()] = std::move(node.current);
+      stats.built += node.built;
+    }
+  }
+
+  for (const node& node : nodes_) {
+    stats.failed += node.failed;
+  }
+
+  stats.total = timer.time();
+  logger::core::Info("Built {} of {} assets in {} ms, {} failed", stats.built, stats.nodes, stats.total.as_milliseconds(), stats.failed);
+  return stats;
+}
+
+void asset_dependency_graph::load(const fs::path& fullpath) {
+  records_.clear();
+  if (!fs::exists(fullpath))
+    return;
+
+  // fs::read_file throws on failed reads, broken file only means a full rebuild
+  std::ifstream file(fullpath, std::ios::in);
+  nlohmann::json j = nlohmann::json::parse(file, nullptr, false);
+  if (j.is_discarded() || !j.is_object() || j.value("version", 0u) != dependencies_file_version) {
+    logger::core::Warning("Ignored asset dependencies at path {}, every asset will be rebuilt", fullpath.c_str());
+    return;
+  }
+
+  auto outputs = j.find("outputs");
+  if (outputs == j.end() || !outputs->is_object())
+    return;
+
+  size_t stale = 0;
+  for (auto& [output, output_json] : outputs->items()) {
+    // outputs removed since the last build would be kept in the file forever
+    if (!fs::exists(fs::to_project_path(output))) {
+      stale++;
+      continue;
+    }
+
+    record& rec = records_[output];
+    rec.key = output_json.value("key", uint64_t(0));
+
+    auto sources = output_json.find("sources");
+    if (sources == output_json.end() || !sources->is_object())
+      continue;
+
+    for (auto& [source, source_json] : sources->items()) {
+      source_record& source_rec = rec.sources[source];
+      source_rec.size = source_json.value("size", uint64_t(0));
+      source_rec.time = source_json.value("time", int64_t(0));
+      source_rec.hash = source_json.value("hash", uint64_t(0));
+    }
+  }
+
+  if (stale) {
+    logger::core::Info("Dropped {} asset dependency records of outputs which don't exist", stale);
+  }
+}
+
+void asset_dependency_graph::save(const fs::path& fullpath) const {
+  nlohmann::json outputs = nlohmann::json::object();
+  for (const auto& [output, rec] : records_) {
+    nlohmann::json sources = nlohmann::json::object();
+    for (const auto& [source, source_rec] : rec.sources) {
+      sources[source] = { { "size", source_rec.size }, { "time", source_rec.time }, { "hash", source_rec.hash } };
+    }
+    outputs[output] = { { "key", rec.key }, { "sources", std::move(sources) } };
+  }
+
+  fs::assure(fullpath.parent_path());
+  std::string text = nlohmann::json { { "version", dependencies_file_version }, { "outputs", std::move(outputs) } }.dump(2);
+  fs::write_file(fullpath, text.data(), text.size());
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "platform/file_system.h"
+#include "base/timer.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class job_system;
+
+// Everything derived asset is computed from, output is rebuilt when any of it changes.
+struct asset_build_inputs {
+  std::string importer;
+  uint32_t importer_version = 0;
+  uint64_t settings_hash = 0;
+  // project relative source files
+  std::vector<fs::path> sources;
+  // outputs of other nodes which have to be built first
+  std::vector<fs::path> dependencies;
+};
+
+struct asset_build_stats {
+  size_t nodes = 0;
+  size_t built = 0;
+  size_t failed = 0;
+  time_span total;
+};
+
+// Derived assets keyed by project relative output path. Key of every node combines importer, settings, source
+// contents and keys of its dependencies, keys of built nodes are persisted and stale nodes are the ones whose key
+// changed or output file is missing. Source files are rehashed only if their size or write time changed.
+class asset_dependency_graph {
+ public:
+  // Returns false if output couldn't be built, dependent nodes are skipped then.
+  using build_func = std::function<bool()>;
+
+  // Node with the same output is replaced.
+  void add(const fs::path& output, asset_build_inputs inputs, build_func build);
+
+  // Builds stale nodes in dependency order, nodes of the same level are built on jobs.
+  // Build functions of the same level run concurrently and must only touch their own assets.
+  asset_build_stats build(job_system* jobs = nullptr);
+
+  void load(const fs::path& fullpath);
+  void save(const fs::path& fullpath) const;
+
+ private:
+  struct source_record {
+    uint64_t size = 0;
+    int64_t time = 0;
+    uint64_t hash = 0;
+  };
+
+  struct record {
+    uint64_t key = 0;
+    std::unordered_map<std::string, source_record> sources;
+  };
+
+  struct node {
+    fs::path output;
+    asset_build_inputs inputs;
+    build_func build;
+    std::vector<size_t> dependents;
+    size_t pending = 0;
+    uint64_t key = 0;
+    bool failed = false;
+    bool built = false;
+    record current;
+  };
+
+  [[nodiscard]] std::vector<std::vector<size_t>> sort_levels();
+  void build_node(node& node);
+  [[nodiscard]] const source_record* find_source(const fs::path& output, const std::string& source) const;
+
+ private:
+  std::vector<node> nodes_;
+  std::unordered_map<std::string, size_t> index_;
+  std::unordered_map<std::string, record> records_;
+};
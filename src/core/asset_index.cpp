@@ -0,0 +1,228 @@
+#include "asset_index.h"
+#include "asset_repository.h"
+#include "assets_filesystem.h"
+#include "base/hash.h"
+#include "base/job_system.h"
+#include "base/json.hpp"
+#include "base/log.h"
+#include "platform/os.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <unordered_set>
+
+static constexpr uint32_t index_file_version = 1;
+
+static uint64_t hash_file(const fs::path& fullpath, size_t size) {
+  if (auto data = os::map_file(fullpath, 0, size))
+    return utils::hash64(data.get(), size);
+
+  std::ifstream file(fullpath, std::ios::in | std::ios::binary);
+  std::vector<char> data(size);
+  file.read(data.data(), (std::streamsize) size);
+  return utils::hash64(data.data(), data.size());
+}
+
+static std::vector<guid> collect_references(const asset& root) {
+  std::vector<guid> references;
+  std::vector<const asset_value*> stack;
+  for (auto& [_, val] : root) {
+    stack.push_back(&val);
+  }
+
+  while (!stack.empty()) {
+    const asset_value& val = *stack.back();
+    stack.pop_back();
+
+    if (val.is_reference()) {
+      references.push_back(val.get<guid>());
+    } else if (val.is_object()) {
+      for (auto& [_, sub] : val.get<const asset&>()) {
+        stack.push_back(&sub);
+      }
+    } else if (val.is_array()) {
+      for (auto& sub : val.get<const asset_array&>()) {
+        stack.push_back(&sub);
+      }
+    }
+  }
+
+  std::sort(references.begin(), references.end());
+  references.erase(std::unique(references.begin(), references.end()), references.end());
+  return references;
+}
+
+// Returns true if the file had to be parsed, files touched without changes keep what they had.
+static bool refresh_entry(const std::string& path, asset_index_entry& entry, const asset_index_entry* previous) {
+  fs::path fullpath = fs::to_project_path(path);
+  entry.type = fs::path(path).extension().string();
+  entry.hash = hash_file(fullpath, entry.size);
+  if (previous && previous->hash == entry.hash) {
+    entry.id = previous->id;
+    entry.dependencies = previous->dependencies;
+    return false;
+  }
+
+  asset_repository staging;
+  if (asset* asset = read_asset_file(staging, fullpath)) {
+    entry.id = staging.get_guid(*asset);
+    entry.dependencies = collect_references(*asset);
+  }
+  return true;
+}
+
+asset_index_stats asset_index::update(std::initializer_list<fs::path> extensions, job_system* jobs) {
+  asset_index_stats stats;
+  timer total_timer;
+
+  timer scan_timer;
+  std::unordered_set<std::string> extensions_set { extensions.begin(), extensions.end() };
+  std::unordered_map<std::string, asset_index_entry> entries;
+  std::vector<std::string> changed;
+  for (auto it = fs::recursive_directory_iterator(fs::project_path());
+            it != fs::recursive_directory_iterator();
+            it++) {
+    if (it->is_directory())
+      continue;
+
+    if (!extensions_set.empty() && !extensions_set.count(it->path().extension()))
+      continue;
+
+    std::string path = fs::relative(it->path(), fs::project_path()).generic_string();
+
+    std::error_code error;
+    asset_index_entry entry;
+    entry.size = fs::file_size(it->path(), error);
+    entry.time = (int64_t) fs::last_write_time(it->path(), error).time_since_epoch().count();
+    if (error)
+      continue;
+
+    auto previous = entries_.find(path);
+    if (previous != entries_.end() && previous->second.size == entry.size && previous->second.time == entry.time) {
+      entries.emplace(path, previous->second);
+      continue;
+    }
+
+    entries.emplace(path, std::move(entry));
+    changed.push_back(std::move(path));
+  }
+  stats.files = entries.size();
+  stats.scan = scan_timer.time();
+
+  // entries aren't added or removed meanwhile, every job touches its own ones
+  timer parse_timer;
+  std::atomic<size_t> parsed = 0;
+  auto refresh_range = [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      auto previous = entries_.find(changed[i]);
+      parsed += refresh_entry(changed[i], entries.at(changed[i]), previous != entries_.end() ? &previous->second : nullptr);
+    }
+  };
+
+  if (jobs) {
+    jobs->parallel_for(changed.size(), 1, refresh_range);
+  } else {
+    refresh_range(0, changed.size());
+  }
+  stats.parsed = parsed;
+  stats.parse = parse_timer.time();
+
+  entries_ = std::move(entries);
+  stats.total = total_timer.time();
+
+  logger::core::Info("Indexed {} assets in {} ms: scan {} ms, {} changed files, {} parsed in {} ms",
+                     stats.files, stats.total.as_milliseconds(), stats.scan.as_milliseconds(), changed.size(),
+                     stats.parsed, stats.parse.as_milliseconds());
+  return stats;
+}
+
+void asset_index::register_assets(asset_repository& repository) const {
+  repository.set_asset_loader([](asset_repository& staging, const fs::path& path) {
+    return read_asset_file(staging, fs::to_project_path(path));
+  });
+
+  // later path wins guid conflicts, the same way load_assets resolves them
+  std::vector<const std::string*> paths;
+  paths.reserve(entries_.size());
+  for (const auto& [path, entry] : entries_) {
+    if (entry.id.is_valid()) {
+      paths.push_back(&path);
+    }
+  }
+  std::sort(paths.begin(), paths.end(), [](const std::string* lhs, const std::string* rhs) { return *lhs < *rhs; });
+
+  std::unordered_map<guid, const std::string*> registered;
+  for (const std::string* path : paths) {
+    const guid& id = entries_.at(*path).id;
+    if (auto [it, inserted] = registered.emplace(id, path); !inserted) {
+      logger::core::Warning("Asset {} has the same guid as {}", path->c_str(), it->second->c_str());
+      it->second = path;
+    }
+    repository.add_unloaded_asset(id, *path);
+  }
+}
+
+const asset_index_entry* asset_index::find(const fs::path& path) const {
+  auto it = entries_.find(path.generic_string());
+  return it != entries_.end() ? &it->second : nullptr;
+}
+
+void asset_index::load(const fs::path& fullpath) {
+  entries_.clear();
+  if (!fs::exists(fullpath))
+    return;
+
+  std::ifstream file = fs::read_file(fullpath, std::ios::in);
+  nlohmann::json j = nlohmann::json::parse(file, nullptr, false);
+  auto assets = j.is_object() && j.value("version", 0u) == index_file_version ? j.find("assets") : j.end();
+  if (j.is_discarded() || assets == j.end() || !assets->is_object()) {
+    logger::core::Warning("Ignored asset index at path {}, every asset will be parsed", fullpath.c_str());
+    return;
+  }
+
+  for (auto& [path, entry_json] : assets->items()) {
+    if (!entry_json.is_object())
+      continue;
+
+    asset_index_entry& entry = entries_[path];
+    entry.id = guid::from_string(entry_json.value("guid", std::string()));
+    entry.type = entry_json.value("type", std::string());
+    entry.size = entry_json.value("size", uint64_t(0));
+    entry.time = entry_json.value("time", int64_t(0));
+    entry.hash = entry_json.value("hash", uint64_t(0));
+
+    auto dependencies = entry_json.find("dependencies");
+    if (dependencies == entry_json.end() || !dependencies->is_array())
+      continue;
+
+    for (auto& dependency : *dependencies) {
+      if (dependency.is_string()) {
+        entry.dependencies.push_back(guid::from_string(dependency.get_ref<const std::string&>()));
+      }
+    }
+  }
+}
+
+void asset_index::save(const fs::path& fullpath) const {
+  nlohmann::json assets = nlohmann::json::object();
+  for (const auto& [path, entry] : entries_) {
+    nlohmann::json dependencies = nlohmann::json::array();
+    for (const guid& dependency : entry.dependencies) {
+      dependencies.push_back(dependency.str());
+    }
+
+    assets[path] = {
+      { "guid", entry.id.str() },
+      { "type", entry.type },
+      { "size", entry.size },
+      { "time", entry.time },
+      { "hash", entry.hash },
+      { "dependencies", std::move(dependencies) }
+    };
+  }
+
+  fs::assure(fullpath.parent_path());
+  std::string text = nlohmann::json { { "version", index_file_version }, { "assets", std::move(assets) } }.dump(1);
+  fs::write_file(fullpath, text.data(), text.size());
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "base/guid.h"
+#include "base/timer.h"
+#include "platform/file_system.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class asset_repository;
+class job_system;
+
+struct asset_index_entry {
+  guid id;
+  // extension of the file
+  std::string type;
+  // assets referenced from the file
+  std::vector<guid> dependencies;
+  uint64_t size = 0;
+  int64_t time = 0;
+  uint64_t hash = 0;
+};
+
+struct asset_index_stats {
+  size_t files = 0;
+  size_t parsed = 0;
+  time_span scan;
+  time_span parse;
+  time_span total;
+};
+
+// Persistent index of project asset files, kept in .ubik/assets.json. Startup registers indexed assets in the
+// repository instead of parsing them, a file is parsed again only when its contents change.
+class asset_index {
+ public:
+  void load(const fs::path& fullpath);
+  void save(const fs::path& fullpath) const;
+
+  // Scans the project for files with the extensions, files changed since the last update are parsed on jobs.
+  asset_index_stats update(std::initializer_list<fs::path> extensions, job_system* jobs = nullptr);
+
+  // Indexed assets become known to the repository and are parsed on their first lookup.
+  void register_assets(asset_repository&) const;
+
+  [[nodiscard]] const asset_index_entry* find(const fs::path& path) const;
+  [[nodiscard]] const std::unordered_map<std::string, asset_index_entry>& entries() const { return entries_; }
+
+ private:
+  std::unordered_map<std::string, asset_index_entry> entries_;
+};
@@ -1,6 +1,8 @@
 #include "asset_repository.h"
 
 #include "base/log.h"
+#include "base/timer.h"
+#include "buffer_store.h"
 
 #include <iostream>
 
@@ -18,6 +20,315 @@ asset_array::iterator asset_array::insert(asset_array::const_iterator it, asset_
   return values_.insert(it, std::move(val));
 }
 
+asset_garbage_stats asset_repository::collect_garbage(const std::vector<asset_id>& roots) {
+  std::unique_lock lock(mutex_);
+  assert(!batch_depth_);
+  timer timer;
+
+  std::vector<bool> marked_assets(objects_.size());
+  std::vector<bool> marked_arrays(arrays_.size());
+  std::vector<bool> marked_buffers(buffers_.size());
+  std::vector<asset*> assets;
+  std::vector<asset_array*> arrays;
+
+  auto mark_asset = [&](asset* a) {
+    if (!marked_assets[a->id().idx]) {
+      marked_assets[a->id().idx] = true;
+      assets.push_back(a);
+    }
+  };
+
+  // owned asset can't outlive its owner, the whole tree stays
+  auto mark_tree = [&](asset* a) {
+    for (; a; a = a->owner_) {
+      mark_asset(a);
+    }
+  };
+
+  auto mark_guid = [&](const guid& id) {
+    if (auto it = guid_to_asset_.find(id); it != guid_to_asset_.end()) {
+      mark_tree(it->second);
+    }
+  };
+
+  auto visit = [&](const asset_value& val) {
+    if (val.is_object()) {
+      if (val.value_.object) mark_asset(val.value_.object);
+    } else if (val.is_array()) {
+      asset_array* array = val.value_.array;
+      if (array && !marked_arrays[array->id().idx]) {
+        marked_arrays[array->id().idx] = true;
+        arrays.push_back(array);
+      }
+    } else if (val.is_buffer()) {
+      marked_buffers[val.value_.buffer.idx] = true;
+    } else if (val.is_reference()) {
+      mark_guid(val.value_.reference->id);
+    } else if (val.is_string()) {
+      // legacy references, see resolve()
+      if (guid id = guid::from_string(val.get<std::string_view>()); id.is_valid()) {
+        mark_guid(id);
+      }
+    }
+  };
+
+  for (const auto& [a, info] : asset_to_info_) {
+    if (!info.path.empty()) {
+      mark_tree(a);
+    }
+  }
+
+  for (asset_id id : roots) {
+    if (id && id.idx < objects_.size() && objects_[id.idx]) {
+      mark_tree(objects_[id.idx]);
+    }
+  }
+
+  {
+    std::lock_guard cache_lock(cache_mutex_);
+    for (const cached_buffer& entry : pinned_) {
+      marked_buffers[entry.index] = true;
+    }
+  }
+
+  for (size_t assets_pos = 0, arrays_pos = 0; assets_pos < assets.size() || arrays_pos < arrays.size();) {
+    if (assets_pos < assets.size()) {
+      for (const auto& [_, val] : *assets[assets_pos++]) {
+        visit(val);
+      }
+    } else {
+      for (const auto& val : *arrays[arrays_pos++]) {
+        visit(val);
+      }
+    }
+  }
+
+  // slots are released first, unreachable objects go back to the pools in bulk
+  std::vector<asset*> garbage_assets;
+  for (uint32_t i = 0; i < objects_.size(); i++) {
+    if (objects_[i] && !marked_assets[i]) {
+      garbage_assets.push_back(release_asset_slot({ i }));
+    }
+  }
+  asset_pool_.destroy(garbage_assets.data(), garbage_assets.size());
+
+  std::vector<asset_array*> garbage_arrays;
+  for (uint32_t i = 0; i < arrays_.size(); i++) {
+    if (arrays_[i] && !marked_arrays[i]) {
+      garbage_arrays.push_back(arrays_[i]);
+      arrays_free_list_.push_back(i);
+      arrays_[i] = nullptr;
+    }
+  }
+  array_pool_.destroy(garbage_arrays.data(), garbage_arrays.size());
+
+  asset_garbage_stats stats;
+  stats.assets = garbage_assets.size();
+  stats.arrays = garbage_arrays.size();
+  if (stats.assets) {
+    invalidate_references();
+  }
+  if (stats.assets >= slab_trim_threshold) {
+    asset_pool_.trim();
+  }
+  if (stats.arrays >= slab_trim_threshold) {
+    array_pool_.trim();
+  }
+
+  std::vector<bool> free_buffers(buffers_.size());
+  for (uint32_t idx : buffers_free_list_) {
+    free_buffers[idx] = true;
+  }
+
+  for (uint32_t i = 0; i < buffers_.size(); i++) {
+    if (!free_buffers[i] && !marked_buffers[i]) {
+      release_buffer_memory({ i });
+      buffers_free_list_.push_back(i);
+      buffers_[i].destroy();
+      stats.buffers++;
+    }
+  }
+
+  {
+    std::lock_guard snapshots_lock(snapshots_mutex_);
+    for (auto it = snapshots_.begin(); it != snapshots_.end();) {
+      it = objects_[it->first] ? std::next(it) : snapshots_.erase(it);
+    }
+  }
+
+  if (stats.assets || stats.arrays || stats.buffers) {
+    logger::core::Info("Collected {} assets, {} arrays and {} buffers in {} ms", stats.assets, stats.arrays, stats.buffers, timer.time().as_milliseconds());
+  }
+  return stats;
+}
+
+asset_slot_remap asset_repository::compact() {
+  std::unique_lock lock(mutex_);
+  assert(!batch_depth_);
+
+  // slots keep their order, neighbours in memory stay neighbours
+  auto pack = [](auto& slots, std::vector<uint32_t>& remap) {
+    remap.assign(slots.size(), asset_slot_remap::invalid);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < slots.size(); i++) {
+      if (auto* ptr = slots[i]) {
+        ptr->id_.idx = count;
+        remap[i] = count;
+        slots[count++] = ptr;
+      }
+    }
+    slots.resize(count);
+    slots.shrink_to_fit();
+  };
+
+  asset_slot_remap remap;
+  pack(objects_, remap.assets);
+  pack(arrays_, remap.arrays);
+  objects_free_list_.clear();
+  arrays_free_list_.clear();
+
+  std::vector<bool> free_buffers(buffers_.size());
+  for (uint32_t idx : buffers_free_list_) {
+    free_buffers[idx] = true;
+  }
+
+  remap.buffers.assign(buffers_.size(), asset_slot_remap::invalid);
+  uint32_t buffers_count = 0;
+  for (uint32_t i = 0; i < buffers_.size(); i++) {
+    if (!free_buffers[i]) {
+      if (buffers_count != i) {
+        buffers_[buffers_count] = std::move(buffers_[i]);
+      }
+      remap.buffers[i] = buffers_count++;
+    }
+  }
+  buffers_.resize(buffers_count);
+  buffers_.shrink_to_fit();
+  buffers_free_list_.clear();
+
+  // every value lives in one asset or array
+  auto remap_buffer = [&](asset_value& val) {
+    if (val.is_buffer()) {
+      val.value_.buffer.idx = remap.buffers[val.value_.buffer.idx];
+    }
+  };
+
+  for (asset* a : objects_) {
+    for (auto& [_, val] : a->items()) {
+      remap_buffer(val);
+    }
+  }
+
+  for (asset_array* array : arrays_) {
+    for (auto& val : array->items()) {
+      remap_buffer(val);
+    }
+  }
+
+  {
+    std::lock_guard pending_lock(pending_mutex_);
+    std::unordered_map<uint32_t, std::shared_future<loaded_buffer_memory>> pending;
+    for (auto& [idx, future] : pending_buffers_) {
+      pending.emplace(remap.buffers[idx], std::move(future));
+    }
+    pending_buffers_ = std::move(pending);
+  }
+
+  {
+    std::lock_guard cache_lock(cache_mutex_);
+    cached_.clear();
+    for (auto* list : { &lru_, &pinned_ }) {
+      for (auto it = list->begin(); it != list->end(); ++it) {
+        it->index = remap.buffers[it->index];
+        cached_.emplace(it->index, it);
+      }
+    }
+  }
+
+  {
+    std::lock_guard snapshots_lock(snapshots_mutex_);
+    std::unordered_map<uint32_t, std::weak_ptr<const asset_snapshot>> snapshots;
+    for (auto& [idx, snapshot] : snapshots_) {
+      if (remap.assets[idx] != asset_slot_remap::invalid) {
+        snapshots.emplace(remap.assets[idx], std::move(snapshot));
+      }
+    }
+    snapshots_ = std::move(snapshots);
+  }
+
+  invalidate_references();
+
+  logger::core::Info("Compacted asset repository to {} assets, {} arrays and {} buffers", objects_.size(), arrays_.size(), buffers_.size());
+  return remap;
+}
+
+// Vectors, matrices and typed arrays are saved as objects with a single key naming the type, e.g. {"__vec3": [1, 2, 3]}.
+static symbol numeric_key(asset_value::type type) {
+  switch (type) {
+    case asset_value::type::VEC2: return symbols::vec2_;
+    case asset_value::type::VEC3: return symbols::vec3_;
+    case asset_value::type::VEC4: return symbols::vec4_;
+    case asset_value::type::QUAT: return symbols::quat_;
+    case asset_value::type::MAT4: return symbols::mat4_;
+    case asset_value::type::FLOAT_ARRAY: return symbols::float_array_;
+    case asset_value::type::INT_ARRAY: return symbols::int_array_;
+    default: return {};
+  }
+}
+
+static asset_value::type numeric_type(symbol key) {
+  for (auto type : { asset_value::type::VEC2, asset_value::type::VEC3, asset_value::type::VEC4, asset_value::type::QUAT,
+                     asset_value::type::MAT4, asset_value::type::FLOAT_ARRAY, asset_value::type::INT_ARRAY }) {
+    if (numeric_key(type) == key)
+      return type;
+  }
+  return asset_value::type::NONE;
+}
+
+// Null if count of numbers doesn't match the type.
+static asset_value numeric_value(asset_value::type type, const std::vector<double>& numbers) {
+  auto at = [&](size_t i) { return (float) numbers[i]; };
+  switch (type) {
+    case asset_value::type::VEC2: {
+      if (numbers.size() != 2) break;
+      return vec2 { at(0), at(1) };
+    }
+    case asset_value::type::VEC3: {
+      if (numbers.size() != 3) break;
+      return vec3 { at(0), at(1), at(2) };
+    }
+    case asset_value::type::VEC4: {
+      if (numbers.size() != 4) break;
+      return vec4 { at(0), at(1), at(2), at(3) };
+    }
+    case asset_value::type::QUAT: {
+      if (numbers.size() != 4) break;
+      return quat { at(0), at(1), at(2), at(3) };
+    }
+    case asset_value::type::MAT4: {
+      if (numbers.size() != 16) break;
+      mat4 m;
+      for (size_t i = 0; i < 16; i++) {
+        m.data[i / 4][i % 4] = at(i);
+      }
+      return m;
+    }
+    case asset_value::type::FLOAT_ARRAY: {
+      return asset_value::float_array(numbers.begin(), numbers.end());
+    }
+    case asset_value::type::INT_ARRAY: {
+      asset_value::int_array ints(numbers.size());
+      for (size_t i = 0; i < numbers.size(); i++) {
+        ints[i] = (int32_t) numbers[i];
+      }
+      return ints;
+    }
+    default:
+      break;
+  }
+  return nullptr;
+}
+
 nlohmann::json asset_to_json(const asset_value& val, asset_repository& rep, std::vector<buffer_id>& buffers) {
   switch ((asset_value::type) val) {
     case asset_value::type::BOOLEAN: {
@@ -33,7 +344,7 @@ nlohmann::json asset_to_json(const asset_value& val, asset_repository& rep, std:
       return static_cast<float>(val);
     }
     case asset_value::type::STRING: {
-      return static_cast<const std::string&>(val);
+      return val.get<std::string>();
     }
     case asset_value::type::ARRAY: {
       nlohmann::json j = nlohmann::json::array();
@@ -47,7 +358,7 @@ nlohmann::json asset_to_json(const asset_value& val, asset_repository& rep, std:
       nlohmann::json j = nlohmann::json::object();
       auto& obj = static_cast<const asset&>(val);
       for (auto& [name, sub] : obj) {
-        j[name] = asset_to_json(sub, rep, buffers);
+        j[name.str()] = asset_to_json(sub, rep, buffers);
       }
       j["__guid"] = rep.get_guid(obj);
       return j;
@@ -56,12 +367,40 @@ nlohmann::json asset_to_json(const asset_value& val, asset_repository& rep, std:
       buffers.push_back(val);
       return { { "__buffer_hash", std::to_string(rep.buffer_hash(val)) } };
     }
+    case asset_value::type::REFERENCE: {
+      return { { "__ref", val.get<guid>().str() } };
+    }
+    case asset_value::type::VEC2:
+    case asset_value::type::VEC3:
+    case asset_value::type::VEC4:
+    case asset_value::type::QUAT:
+    case asset_value::type::MAT4: {
+      return { { numeric_key(val).str(), std::vector<float>(val.floats(), val.floats() + val.floats_count()) } };
+    }
+    case asset_value::type::FLOAT_ARRAY: {
+      return { { numeric_key(val).str(), val.get<const asset_value::float_array&>() } };
+    }
+    case asset_value::type::INT_ARRAY: {
+      return { { numeric_key(val).str(), val.get<const asset_value::int_array&>() } };
+    }
     case asset_value::type::NONE:
       break;
   }
   return {};
 }
 
+static asset_value create_buffer_value(asset_repository& rep, const fs::path& buffers_path, const std::string& hash_str) {
+  char* end = nullptr;
+  uint64_t hash = std::strtoull(hash_str.c_str(), &end, 10);
+  fs::path buffer_path = end != hash_str.c_str() && !*end ? find_stored_buffer(hash, buffers_path) : fs::path();
+  if (buffer_path.empty()) {
+    logger::core::Warning("Couldn't load buffer {}", hash_str.c_str());
+    return rep.create_buffer(0);
+  }
+
+  return rep.create_buffer_from_file(buffer_path, 0, 0, hash);
+}
+
 asset_value parse_json(nlohmann::json& j, asset_repository& rep, const fs::path& buffers_path) {
   switch (j.type()) {
     case nlohmann::detail::value_t::number_float: {
@@ -81,18 +420,22 @@ asset_value parse_json(nlohmann::json& j, asset_repository& rep, const fs::path&
     }
     case nlohmann::detail::value_t::object: {
       if (j.contains("__buffer_hash")) {
-        fs::path buffer_path = fs::append(buffers_path, j.at("__buffer_hash"));
-        if (!fs::exists(buffer_path)) {
-          logger::core::Warning("Couldn't load buffer {}", buffer_path.c_str());
-          return rep.create_buffer(0);
-        }
+        return create_buffer_value(rep, buffers_path, j.at("__buffer_hash"));
+      }
+
+      if (j.contains("__ref")) {
+        return guid::from_string(j.at("__ref").get_ref<const std::string&>());
+      }
 
-        return rep.create_buffer_from_file(buffer_path, 0, 0);
+      if (j.size() == 1 && j.begin().value().is_array()) {
+        if (auto type = numeric_type(symbol(j.begin().key())); type != asset_value::type::NONE) {
+          return numeric_value(type, j.begin().value().get<std::vector<double>>());
+        }
       }
 
       asset* asset = nullptr;
       if (j.contains("__guid")) {
-        asset = &rep.create_asset(guid::from_string(j.at("__guid")));
+        asset = &rep.create_asset(guid::from_string(j.at("__guid").get_ref<const std::string&>()));
       } else {
         asset = &rep.create_asset();
       }
@@ -118,4 +461,241 @@ asset_value parse_json(nlohmann::json& j, asset_repository& rep, const fs::path&
     }
   }
   return nullptr;
-}
\ No newline at end of file
+}
+namespace {
+
+// Creates values in the repository as tokens arrive. Object guid may come after other keys,
+// so properties are collected on the stack and the asset is created when the object ends.
+class asset_json_sax : public nlohmann::json_sax<nlohmann::json> {
+ public:
+  asset_json_sax(asset_repository& rep, const fs::path& buffers_path)
+    : rep_(rep), buffers_path_(buffers_path)
+  {}
+
+  bool null() override { return add(nullptr); }
+  bool boolean(bool val) override { return add(val); }
+  bool number_integer(number_integer_t val) override { return add((int64_t) val); }
+  bool number_unsigned(number_unsigned_t val) override { return add((uint64_t) val); }
+  bool number_float(number_float_t val, const string_t&) override { return add((float) val); }
+
+  bool string(string_t& val) override {
+    if (!stack_.empty() && !stack_.back().array) {
+      frame& top = stack_.back();
+      if (top.key == symbols::buffer_hash_) {
+        top.buffer_hash = val;
+        return true;
+      }
+      if (top.key == symbols::ref_) {
+        top.ref = val;
+        return true;
+      }
+      if (top.key == symbols::guid_) {
+        top.object_guid = guid::from_string(val);
+      }
+    }
+    return add(std::move(val));
+  }
+
+  bool binary(binary_t&) override { return false; }
+
+  bool start_object(std::size_t) override {
+    if (!accepts_value())
+      return false;
+
+    stack_.emplace_back();
+    return true;
+  }
+
+  bool key(string_t& val) override {
+    stack_.back().key = symbol(val);
+    return true;
+  }
+
+  bool end_object() override {
+    frame top = std::move(stack_.back());
+    stack_.pop_back();
+
+    if (!top.buffer_hash.empty()) {
+      if (!top.properties.empty()) {
+        destroy_properties(top);
+      }
+      return add(create_buffer_value(rep_, buffers_path_, top.buffer_hash));
+    }
+
+    if (!top.ref.empty()) {
+      if (!top.properties.empty()) {
+        destroy_properties(top);
+      }
+      return add(guid::from_string(top.ref));
+    }
+
+    // {"__vec3": [...]} wrapper is replaced by the vector, other objects with a vector property stay objects
+    if (top.properties.size() == 1 && top.properties[0].second.is_numeric_aggregate() &&
+        numeric_type(top.properties[0].first) != asset_value::type::NONE) {
+      return add(std::move(top.properties[0].second));
+    }
+
+    if (stack_.empty()) {
+      // empty file
+      if (top.properties.empty()) {
+        empty_ = true;
+        return true;
+      }
+
+      // loaded asset replaces the one with the same guid, unless it's a partially read one to be destroyed
+      if (failed_) {
+        top.object_guid = guid::invalid();
+      } else if (top.object_guid.is_valid()) {
+        if (auto* existing = rep_.find_loaded_asset(top.object_guid)) {
+          rep_.destroy_asset(existing->id());
+        }
+      }
+    }
+
+    asset& obj = top.object_guid.is_valid() ? rep_.create_asset(top.object_guid) : rep_.create_asset();
+    for (auto& [name, value] : top.properties) {
+      rep_.set_value(obj, name, std::move(value));
+    }
+    return add(obj);
+  }
+
+  bool start_array(std::size_t) override {
+    if (!accepts_value() || stack_.empty())
+      return false;
+
+    // numbers of vectors and typed arrays are collected in place of an asset_array
+    auto numeric = stack_.back().array ? asset_value::type::NONE : numeric_type(stack_.back().key);
+
+    stack_.emplace_back();
+    if (numeric != asset_value::type::NONE) {
+      stack_.back().numeric = numeric;
+    } else {
+      stack_.back().array = &rep_.create_array();
+    }
+    return true;
+  }
+
+  bool end_array() override {
+    frame top = std::move(stack_.back());
+    stack_.pop_back();
+
+    if (top.numeric != asset_value::type::NONE) {
+      asset_value value = numeric_value(top.numeric, top.numbers);
+      return !value.is_null() && add(std::move(value));
+    }
+
+    return add(*top.array);
+  }
+
+  bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& ex) override {
+    logger::core::Error("JSON parse error at {}: {}", position, ex.what());
+    return false;
+  }
+
+  // Returns null if parsing failed, values created so far are destroyed.
+  asset* finish(bool parsed) {
+    if (!parsed) {
+      failed_ = true;
+
+      // open values are folded into the root, then the whole tree goes at once
+      while (!stack_.empty()) {
+        if (stack_.back().array) {
+          end_array();
+        } else if (stack_.back().numeric != asset_value::type::NONE) {
+          stack_.pop_back();
+        } else {
+          stack_.back().buffer_hash.clear();
+          stack_.back().ref.clear();
+          end_object();
+        }
+      }
+
+      if (root_) {
+        rep_.destroy_asset(root_->id());
+      }
+      return nullptr;
+    }
+
+    return root_;
+  }
+
+  [[nodiscard]] bool empty() const { return empty_; }
+
+ private:
+  struct frame {
+    asset_array* array = nullptr;
+    std::vector<std::pair<symbol, asset_value>> properties;
+    symbol key;
+    guid object_guid;
+    std::string buffer_hash;
+    std::string ref;
+    asset_value::type numeric = asset_value::type::NONE;
+    std::vector<double> numbers;
+  };
+
+  // only object root is accepted, so everything created is reachable from it
+  bool accepts_value() const {
+    return !stack_.empty() || !root_;
+  }
+
+  bool add(asset_value value) {
+    if (stack_.empty()) {
+      if (!value.is_object())
+        return false;
+
+      root_ = &value.get<asset&>();
+      return true;
+    }
+
+    frame& top = stack_.back();
+    if (top.numeric != asset_value::type::NONE) {
+      if (!value.is_number()) {
+        discard(std::move(value));
+        return false;
+      }
+      top.numbers.push_back(value.get<double>());
+      return true;
+    }
+
+    if (top.array) {
+      rep_.push_back(*top.array, std::move(value));
+    } else {
+      top.properties.emplace_back(top.key, std::move(value));
+    }
+    return true;
+  }
+
+  void destroy_properties(frame& frame) {
+    asset& tmp = rep_.create_asset();
+    for (auto& [name, value] : frame.properties) {
+      rep_.set_value(tmp, name, std::move(value));
+    }
+    rep_.destroy_asset(tmp.id());
+  }
+
+  void discard(asset_value value) {
+    asset& tmp = rep_.create_asset();
+    rep_.set_value(tmp, symbols::data, std::move(value));
+    rep_.destroy_asset(tmp.id());
+  }
+
+ private:
+  asset_repository& rep_;
+  const fs::path& buffers_path_;
+  std::vector<frame> stack_;
+  asset* root_ = nullptr;
+  bool failed_ = false;
+  bool empty_ = false;
+};
+
+}
+
+asset* parse_json(const char* first, const char* last, asset_repository& rep, const fs::path& buffers_path, bool* empty) {
+  asset_json_sax sax(rep, buffers_path);
+  bool parsed = nlohmann::json::sax_parse(first, last, &sax);
+  asset* root = sax.finish(parsed);
+  if (empty) {
+    *empty = parsed && sax.empty();
+  }
+  return root;
+}
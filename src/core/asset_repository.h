@@ -1,22 +1,41 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
 #include <string>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
 #include <unordered_map>
 #include <vector>
 
-#include "base/crc32.h"
+#include "base/hash.h"
+#include "base/math.h"
 #include "base/iterator_range.h"
 #include "base/guid.h"
+#include "base/symbol.h"
 #include "base/json.hpp"
 #include "base/slot_map.h"
+#include "base/slab_pool.h"
 #include "base/detector.h"
 #include "platform/file_system.h"
+#include "platform/os.h"
 #include "base/log.h"
+#include "base/job_system.h"
+#include "base/reentrant_shared_mutex.h"
+#include "core/buffer_compression.h"
 
 class asset;
 class asset_value;
 class asset_repository;
+class asset_snapshot;
 
 struct buffer_id {
   uint32_t idx;
@@ -43,6 +62,7 @@ class asset_array {
   const asset_value& at(size_t) const;
 
   array_id id() const { return id_; }
+  bool is_orphan() const { return !owner_; }
   const asset& owner() const { return *owner_; }
 
   bool empty() const { return values_.empty(); }
@@ -81,11 +101,24 @@ struct asset_id {
 
 class asset {
  public:
-  using key_t = std::string;
-  using container_t = std::unordered_map<key_t, asset_value>;
+  using key_t = symbol;
+  // properties sorted by symbol id, objects usually have a few keys so lookup is a short binary search
+  using container_t = std::vector<std::pair<key_t, asset_value>>;
   using iterator = container_t::iterator;
   using const_iterator = container_t::const_iterator;
 
+  // Key of const lookups. Text isn't interned, unknown keys don't grow the symbol table and simply aren't found.
+  struct lookup_key {
+    lookup_key(key_t key) : key(key), known(true) {}
+    lookup_key(std::string_view text) : key(symbol::find(text)), known(!key.empty() || text.empty()), text(text) {}
+    lookup_key(const char* text) : lookup_key(std::string_view(text)) {}
+    lookup_key(const std::string& text) : lookup_key(std::string_view(text)) {}
+
+    key_t key;
+    bool known;
+    std::string_view text;
+  };
+
  public:
   asset() = delete;
 
@@ -96,9 +129,7 @@ class asset {
   asset(const asset&) = delete;
   asset& operator=(const asset&) = delete;
 
-  const asset_value& at(const key_t& key) const {
-    return properties_.at(key);
-  }
+  const asset_value& at(lookup_key key) const;
 
   bool is_orphan() const { return !owner_; }
   const asset& owner() const { return *owner_; }
@@ -113,33 +144,30 @@ class asset {
     return version_;
   }
 
-  bool contains(const key_t& key) const { return properties_.count(key); }
+  bool contains(lookup_key key) const;
 
   asset_id id() const { return id_; }
 
-  const_iterator find(const key_t& key) const { return properties_.find(key); }
+  const_iterator find(lookup_key key) const;
   const_iterator begin() const { return properties_.begin(); }
   const_iterator end() const { return properties_.end(); }
 
+  size_t size() const { return properties_.size(); }
+
  private:
   friend class asset_repository;
 
-  asset_value& operator[](const key_t& key) {
-    return properties_[key];
-  }
-
-  void erase(const key_t& key) {
-    properties_.erase(key);
-  }
+  asset_value& operator[](key_t key);
 
-  void erase(const_iterator it) {
-    properties_.erase(it);
-  }
+  void erase(key_t key);
+  void erase(const_iterator it);
 
   auto items() { return iterator_range(properties_.begin(), properties_.end()); }
   auto items() const { return iterator_range(begin(), end()); }
 
-  iterator find_impl(const key_t& key) { return properties_.find(key); }
+  iterator find_impl(key_t key);
+
+  iterator lower_bound(key_t key);
 
 //  iterator begin() { return properties_.begin(); }
 //  iterator end() { return properties_.end(); }
@@ -153,23 +181,39 @@ class asset {
   uint32_t version_ {};
 };
 
-template<typename T, typename... Args>
-static T* create(Args&& ... args) {
-  auto deleter = [&](T* obj) {
-    operator delete(obj);
-  };
+// String values too long to be stored inline are allocated from a per-thread slab pool. Pools live until the
+// program exits, so a string can be released by any thread and its slot is then reused by the releasing thread.
+inline slab_pool<std::string>& string_pool() {
+  static thread_local auto* pool = new slab_pool<std::string>();
+  return *pool;
+}
 
-  std::unique_ptr<T, decltype(deleter)> obj((T*) operator new(sizeof(T)), deleter);
-  new (obj.get()) T(std::forward<Args>(args)...);
-  assert(obj != nullptr);
+template<typename... Args>
+inline std::string* create_string(Args&& ... args) {
+  return string_pool().create(std::forward<Args>(args)...);
+}
 
-  return obj.release();
+inline void free_string(std::string* ptr) {
+  string_pool().destroy(ptr);
 }
 
-template<typename T>
-static void free(T* ptr) {
-  ptr->~T();
-  operator delete(ptr);
+// Reference to an asset. The guid is what gets saved, the asset slot found by the first lookup is cached
+// together with the repository epoch, so it stays valid until some asset is destroyed.
+struct asset_reference {
+  explicit asset_reference(const guid& id) : id(id) {}
+
+  // Epoch of the repository in the high half, slot index in the low one. Epoch is widened before the shift.
+  static uint64_t cache_key(uint32_t epoch, uint32_t index) { return uint64_t(epoch) << 32u | index; }
+
+  guid id;
+  mutable std::atomic<uint64_t> cache { 0 };
+};
+
+// Values which don't fit asset_value are allocated like strings, from per-thread pools that are never freed.
+template<class T>
+inline slab_pool<T>& value_pool() {
+  static thread_local auto* pool = new slab_pool<T>();
+  return *pool;
 }
 
 template<typename T>
@@ -186,10 +230,23 @@ class asset_value {
     STRING,
     ARRAY,
     OBJECT,
-    BUFFER
+    BUFFER,
+    REFERENCE,
+    VEC2,
+    VEC3,
+    VEC4,
+    QUAT,
+    MAT4,
+    FLOAT_ARRAY,
+    INT_ARRAY
   };
 
+  using float_array = std::vector<float>;
+  using int_array = std::vector<int32_t>;
+
  private:
+  friend class asset_repository;
+
   using string_t = std::string;
 
   union value {
@@ -198,22 +255,34 @@ class asset_value {
     int64_t number_integer;
     uint64_t number_unsigned;
     float number_float;
+    // strings of up to short_string_capacity chars are stored inline, their size is kept in string_size_
+    char short_string[8];
     string_t* string;
     asset_array* array;
     asset* object;
     buffer_id buffer;
+    asset_reference* reference;
+    // vec2 is stored inline, vec3, vec4 and quat share 16 byte blocks
+    vec2 vector2;
+    std::array<float, 4>* vector;
+    mat4* matrix;
+    float_array* floats;
+    int_array* ints;
 
     value() noexcept : none() {}
     value(bool v) noexcept : boolean(v) {}
     value(int64_t v) noexcept : number_integer(v) {}
     value(uint64_t v) noexcept : number_unsigned(v) {}
     value(float v) noexcept : number_float(v) {}
-    value(const string_t& value) : string(create<string_t>(value)) {}
-    value(string_t&& value) : string(create<string_t>(std::move(value))) {}
-    value(string_t* ptr) : string(ptr) {}
     value(asset* val) : object(val) {}
     value(asset_array* val) : array(val) {}
     value(buffer_id id) : buffer(id) {}
+    value(const guid& id) : reference(value_pool<asset_reference>().create(id)) {}
+    value(vec2 v) : vector2(v) {}
+    value(const std::array<float, 4>& v) : vector(value_pool<std::array<float, 4>>().create(v)) {}
+    value(const mat4& m) : matrix(value_pool<mat4>().create(m)) {}
+    value(float_array&& v) : floats(value_pool<float_array>().create(std::move(v))) {}
+    value(int_array&& v) : ints(value_pool<int_array>().create(std::move(v))) {}
 
     value(type t) {
       switch (t) {
@@ -234,7 +303,7 @@ class asset_value {
           break;
         }
         case type::STRING: {
-          string = create<string_t>();
+          short_string[0] = '\0';
           break;
         }
         case type::ARRAY: {
@@ -249,6 +318,32 @@ class asset_value {
           buffer = { };
           break;
         }
+        case type::REFERENCE: {
+          reference = value_pool<asset_reference>().create(guid());
+          break;
+        }
+        case type::VEC2: {
+          vector2 = { };
+          break;
+        }
+        case type::VEC3:
+        case type::VEC4:
+        case type::QUAT: {
+          vector = value_pool<std::array<float, 4>>().create(std::array<float, 4> { 0.0f, 0.0f, 0.0f, t == type::QUAT ? 1.0f : 0.0f });
+          break;
+        }
+        case type::MAT4: {
+          matrix = value_pool<mat4>().create();
+          break;
+        }
+        case type::FLOAT_ARRAY: {
+          floats = value_pool<float_array>().create();
+          break;
+        }
+        case type::INT_ARRAY: {
+          ints = value_pool<int_array>().create();
+          break;
+        }
         case type::NONE: {
           none = { };
           break;
@@ -256,14 +351,68 @@ class asset_value {
       }
     }
 
-    void destroy(type t) {
+    void destroy(type t, uint8_t string_size) {
       if (t == type::STRING) {
-        free(string);
+        if (string_size == long_string)
+          free_string(string);
+      } else if (t == type::REFERENCE) {
+        value_pool<asset_reference>().destroy(reference);
+      } else if (t == type::VEC3 || t == type::VEC4 || t == type::QUAT) {
+        value_pool<std::array<float, 4>>().destroy(vector);
+      } else if (t == type::MAT4) {
+        value_pool<mat4>().destroy(matrix);
+      } else if (t == type::FLOAT_ARRAY) {
+        value_pool<float_array>().destroy(floats);
+      } else if (t == type::INT_ARRAY) {
+        value_pool<int_array>().destroy(ints);
       }
     }
   };
 
  private:
+  static constexpr size_t short_string_capacity = sizeof(value::short_string);
+  static constexpr uint8_t long_string = 0xFF;
+
+  void destroy_value() {
+    value_.destroy(type_, string_size_);
+  }
+
+  // New contents are built first, str may point into the current string.
+  void assign_string(std::string_view str) {
+    value val;
+    uint8_t size;
+    if (str.size() <= short_string_capacity) {
+      std::memcpy(val.short_string, str.data(), str.size());
+      size = (uint8_t) str.size();
+    } else {
+      val.string = create_string(str);
+      size = long_string;
+    }
+    destroy_value();
+    type_ = type::STRING;
+    value_ = val;
+    string_size_ = size;
+  }
+
+  void assign_string(string_t&& str) {
+    if (str.size() <= short_string_capacity) {
+      assign_string(std::string_view(str));
+      return;
+    }
+    string_t* ptr = create_string(std::move(str));
+    destroy_value();
+    type_ = type::STRING;
+    value_.string = ptr;
+    string_size_ = long_string;
+  }
+
+  [[nodiscard]] std::string_view string_view() const {
+    assert(is_string());
+    if (string_size_ == long_string)
+      return *value_.string;
+    return { value_.short_string, string_size_ };
+  }
+
   template<class T, class = void>
   struct is_base_numeric_type : std::false_type {};
 
@@ -277,13 +426,13 @@ class asset_value {
 
  public:
   static void to_asset_value(asset_value& asset_val, bool val) {
-    asset_val.value_.destroy(asset_val.type_);
+    asset_val.destroy_value();
     asset_val.type_ = type::BOOLEAN;
     asset_val.value_ = val;
   }
 
   static void to_asset_value(asset_value& asset_val, buffer_id val) {
-    asset_val.value_.destroy(asset_val.type_);
+    asset_val.destroy_value();
     asset_val.type_ = type::BUFFER;
     asset_val.value_ = val;
   }
@@ -296,7 +445,7 @@ class asset_value {
              TypeLimits::is_signed,
            int> = 0>
   static void to_asset_value(asset_value& asset_val, IntegerType val) {
-    asset_val.value_.destroy(asset_val.type_);
+    asset_val.destroy_value();
     asset_val.type_ = type::INTEGER;
     asset_val.value_ = static_cast<int64_t>(val);
   }
@@ -309,7 +458,7 @@ class asset_value {
              !TypeLimits::is_signed,
            int> = 0>
   static void to_asset_value(asset_value& asset_val, UnsignedType val) {
-    asset_val.value_.destroy(asset_val.type_);
+    asset_val.destroy_value();
     asset_val.type_ = type::UNSIGNED;
     asset_val.value_ = static_cast<uint64_t>(val);
   }
@@ -317,21 +466,17 @@ class asset_value {
   template<class FloatType,
            std::enable_if_t<std::is_floating_point_v<FloatType>, int> = 0>
   static void to_asset_value(asset_value& asset_val, FloatType val) {
-    asset_val.value_.destroy(asset_val.type_);
+    asset_val.destroy_value();
     asset_val.type_ = type::FLOAT;
     asset_val.value_ = static_cast<float>(val);
   }
 
   static void to_asset_value(asset_value& asset_val, string_t&& val) {
-    asset_val.value_.destroy(asset_val.type_);
-    asset_val.type_ = type::STRING;
-    asset_val.value_ = std::move(val);
+    asset_val.assign_string(std::move(val));
   }
 
   static void to_asset_value(asset_value& asset_val, const string_t& val) {
-    asset_val.value_.destroy(asset_val.type_);
-    asset_val.type_ = type::STRING;
-    asset_val.value_ = val;
+    asset_val.assign_string(std::string_view(val));
   }
 
   template<class StringCompatibleType,
@@ -340,19 +485,65 @@ class asset_value {
              std::is_constructible_v<string_t, StringCompatibleType>,
            int> = 0>
   static void to_asset_value(asset_value& asset_val, const StringCompatibleType& val) {
-    asset_val.value_.destroy(asset_val.type_);
-    asset_val.type_ = type::STRING;
-    asset_val.value_ = create<string_t>(val);
+    asset_val.assign_string(std::string_view(val));
+  }
+
+  static void to_asset_value(asset_value& asset_val, const guid& val) {
+    asset_val.destroy_value();
+    asset_val.type_ = type::REFERENCE;
+    asset_val.value_ = val;
+  }
+
+  static void to_asset_value(asset_value& asset_val, vec2 val) {
+    asset_val.destroy_value();
+    asset_val.type_ = type::VEC2;
+    asset_val.value_ = val;
+  }
+
+  static void to_asset_value(asset_value& asset_val, const vec3& val) {
+    asset_val.destroy_value();
+    asset_val.type_ = type::VEC3;
+    asset_val.value_ = std::array<float, 4> { val.x, val.y, val.z, 0.0f };
+  }
+
+  static void to_asset_value(asset_value& asset_val, const vec4& val) {
+    asset_val.destroy_value();
+    asset_val.type_ = type::VEC4;
+    asset_val.value_ = std::array<float, 4> { val.x, val.y, val.z, val.w };
+  }
+
+  static void to_asset_value(asset_value& asset_val, const quat& val) {
+    asset_val.destroy_value();
+    asset_val.type_ = type::QUAT;
+    asset_val.value_ = std::array<float, 4> { val.x, val.y, val.z, val.w };
+  }
+
+  static void to_asset_value(asset_value& asset_val, const mat4& val) {
+    asset_val.destroy_value();
+    asset_val.type_ = type::MAT4;
+    asset_val.value_ = val;
+  }
+
+  static void to_asset_value(asset_value& asset_val, float_array val) {
+    asset_val.destroy_value();
+    asset_val.type_ = type::FLOAT_ARRAY;
+    asset_val.value_ = std::move(val);
+  }
+
+  static void to_asset_value(asset_value& asset_val, int_array val) {
+    asset_val.destroy_value();
+    asset_val.type_ = type::INT_ARRAY;
+    asset_val.value_ = std::move(val);
   }
 
   static void to_asset_value(asset_value& asset_val, asset& ref) {
-    asset_val.value_.destroy(asset_val.type_);
+    asset_val.destroy_value();
     asset_val.type_ = type::OBJECT;
     asset_val.value_.object = &ref;
   }
 
   static void to_asset_value(asset_value& asset_val, asset_array& ref) {
-    asset_val.value_.destroy(asset_val.type_);
+    asset_val.destroy_value();
     asset_val.type_ = type::ARRAY;
     asset_val.value_.array = &ref;
   }
@@ -367,19 +558,39 @@ class asset_value {
     ref = val.value_.buffer;
   }
 
+  // Vectors are also read from objects with x, y, z, w properties, that's how they were stored before.
+  static void from_asset_value(const asset_value& val, vec2& ref) { read_vector(val, &ref.x, 2); }
+  static void from_asset_value(const asset_value& val, vec3& ref) { read_vector(val, &ref.x, 3); }
+  static void from_asset_value(const asset_value& val, vec4& ref) { read_vector(val, &ref.x, 4); }
+  static void from_asset_value(const asset_value& val, quat& ref) { read_vector(val, &ref.x, 4); }
+
+  static void from_asset_value(const asset_value& val, mat4& ref) {
+    assert(val.is_mat4());
+    ref = *val.value_.matrix;
+  }
+
+  static void from_asset_value(const asset_value& val, guid& ref) {
+    assert(val.is_reference());
+    ref = val.value_.reference->id;
+  }
+
   static void from_asset_value(const asset_value& val, string_t& ref) {
-    assert(val.is_string());
-    ref = *val.value_.string;
+    ref = val.string_view();
+  }
+
+  // View points into the value, it's valid while the value is alive and unchanged.
+  static void from_asset_value(const asset_value& val, std::string_view& ref) {
+    ref = val.string_view();
   }
 
   template<class ConstructibleStringType,
            std::enable_if_t<
              std::is_constructible_v<ConstructibleStringType, string_t> &&
-             !std::is_same_v<string_t, ConstructibleStringType>,
+             !std::is_same_v<string_t, ConstructibleStringType> &&
+             !std::is_same_v<std::string_view, ConstructibleStringType>,
            int> = 0>
   static void from_asset_value(const asset_value& val, ConstructibleStringType& ref) {
-    assert(val.is_string());
-    ref = *val.value_.string;
+    ref = string_t(val.string_view());
   }
 
   template<class ArithmeticType,
@@ -407,6 +618,15 @@ class asset_value {
       case type::STRING:
       case type::ARRAY:
       case type::OBJECT:
+      case type::BUFFER:
+      case type::REFERENCE:
+      case type::VEC2:
+      case type::VEC3:
+      case type::VEC4:
+      case type::QUAT:
+      case type::MAT4:
+      case type::FLOAT_ARRAY:
+      case type::INT_ARRAY:
       default: {
         break;
       }
@@ -443,9 +663,10 @@ class asset_value {
         std::is_same_v<T, float> ||
         std::is_same_v<T, uint64_t> ||
         std::is_same_v<T, int64_t> ||
-        std::is_same_v<T, string_t> ||
         std::is_same_v<T, asset> ||
-        std::is_same_v<T, asset_array>,
+        std::is_same_v<T, asset_array> ||
+        std::is_same_v<T, float_array> ||
+        std::is_same_v<T, int_array>,
       void>>
     : std:: true_type {};
 
@@ -463,7 +684,8 @@ class asset_value {
 
   asset_value(asset_value&& other) noexcept
     : type_(std::move(other.type_)),
-      value_(std::move(other.value_)) {
+      value_(std::move(other.value_)),
+      string_size_(other.string_size_) {
     other.type_ = type::NONE;
     other.value_ = {};
   }
@@ -473,6 +695,7 @@ class asset_value {
     using std::swap;
     swap(type_, tmp.type_);
     swap(value_, tmp.value_);
+    swap(string_size_, tmp.string_size_);
     return *this;
   }
 
@@ -496,7 +719,7 @@ class asset_value {
   }
 
   ~asset_value() noexcept {
-    value_.destroy(type_);
+    destroy_value();
   }
 
  private:
@@ -592,7 +815,7 @@ class asset_value {
   }
 
   constexpr bool is_primitive() const noexcept {
-    return is_null() || is_string() || is_boolean() || is_number();
+    return is_null() || is_string() || is_boolean() || is_number() || is_reference() || is_numeric_aggregate();
   }
 
   constexpr bool is_null() const noexcept {
@@ -635,12 +858,78 @@ class asset_value {
     return type_ == type::STRING;
   }
 
+  constexpr bool is_reference() const noexcept {
+    return type_ == type::REFERENCE;
+  }
+
+  // vectors, quaternion and matrix
+  constexpr bool is_vector() const noexcept {
+    return type_ == type::VEC2 || type_ == type::VEC3 || type_ == type::VEC4 || type_ == type::QUAT;
+  }
+
+  constexpr bool is_mat4() const noexcept {
+    return type_ == type::MAT4;
+  }
+
+  constexpr bool is_float_array() const noexcept {
+    return type_ == type::FLOAT_ARRAY;
+  }
+
+  constexpr bool is_int_array() const noexcept {
+    return type_ == type::INT_ARRAY;
+  }
+
+  constexpr bool is_numeric_aggregate() const noexcept {
+    return is_vector() || is_mat4() || is_float_array() || is_int_array();
+  }
+
+  // Floats of vector or matrix value in memory order, matrix is row-major.
+  [[nodiscard]] const float* floats() const {
+    switch (type_) {
+      case type::VEC2: return &value_.vector2.x;
+      case type::VEC3:
+      case type::VEC4:
+      case type::QUAT: return value_.vector->data();
+      case type::MAT4: return &value_.matrix->data[0][0];
+      default: return nullptr;
+    }
+  }
+
+  [[nodiscard]] size_t floats_count() const {
+    switch (type_) {
+      case type::VEC2: return 2;
+      case type::VEC3: return 3;
+      case type::VEC4:
+      case type::QUAT: return 4;
+      case type::MAT4: return 16;
+      default: return 0;
+    }
+  }
+
   static asset_value copy(const asset_value& other) {
     assert(other.is_primitive());
 
     asset_value copy;
+    if (other.type_ == type::STRING) {
+      copy.assign_string(other.string_view());
+      return copy;
+    }
+
     copy.type_ = other.type_;
-    copy.value_ = other.type_ == type::STRING ? create<string_t>(*other.value_.string) : other.value_;
+    if (other.type_ == type::REFERENCE) {
+      // cached slot belongs to the source repository
+      copy.value_ = other.value_.reference->id;
+    } else if (other.type_ == type::VEC3 || other.type_ == type::VEC4 || other.type_ == type::QUAT) {
+      copy.value_ = *other.value_.vector;
+    } else if (other.type_ == type::MAT4) {
+      copy.value_ = *other.value_.matrix;
+    } else if (other.type_ == type::FLOAT_ARRAY) {
+      copy.value_ = float_array(*other.value_.floats);
+    } else if (other.type_ == type::INT_ARRAY) {
+      copy.value_ = int_array(*other.value_.ints);
+    } else {
+      copy.value_ = other.value_;
+    }
     return copy;
   }
 
@@ -697,14 +986,6 @@ class asset_value {
     return is_number_float() ? &value_.number_float : nullptr;
   }
 
-  string_t* get_ptr_impl(string_t*) {
-    return is_string() ? value_.string : nullptr;
-  }
-
-  constexpr const string_t* get_ptr_impl(const string_t*) const {
-    return is_string() ? value_.string : nullptr;
-  }
-
   asset_array* get_ptr_impl(asset_array*) {
     return is_array() ? value_.array : nullptr;
   }
@@ -721,11 +1002,90 @@ class asset_value {
     return is_object() ? value_.object : nullptr;
   }
 
+  float_array* get_ptr_impl(float_array*) {
+    return is_float_array() ? value_.floats : nullptr;
+  }
+
+  constexpr const float_array* get_ptr_impl(const float_array*) const {
+    return is_float_array() ? value_.floats : nullptr;
+  }
+
+  int_array* get_ptr_impl(int_array*) {
+    return is_int_array() ? value_.ints : nullptr;
+  }
+
+  constexpr const int_array* get_ptr_impl(const int_array*) const {
+    return is_int_array() ? value_.ints : nullptr;
+  }
+
+  static void read_vector(const asset_value& val, float* out, size_t count);
+
  private:
   value value_ = { };
   type type_ = type::NONE;
+  uint8_t string_size_ = 0;
 };
 
+inline asset::iterator asset::lower_bound(key_t key) {
+  return std::lower_bound(properties_.begin(), properties_.end(), key,
+                          [](const auto& property, key_t k) { return property.first < k; });
+}
+
+inline asset::iterator asset::find_impl(key_t key) {
+  auto it = lower_bound(key);
+  return it != properties_.end() && it->first == key ? it : properties_.end();
+}
+
+inline asset::const_iterator asset::find(lookup_key key) const {
+  return key.known ? const_cast<asset*>(this)->find_impl(key.key) : end();
+}
+
+inline bool asset::contains(lookup_key key) const {
+  return find(key) != end();
+}
+
+inline const asset_value& asset::at(lookup_key key) const {
+  auto it = find(key);
+  if (it == end())
+    throw std::out_of_range("asset doesn't contain key " + (key.known ? key.key.str() : std::string(key.text)));
+
+  return it->second;
+}
+
+inline asset_value& asset::operator[](key_t key) {
+  auto it = lower_bound(key);
+  if (it == properties_.end() || it->first != key) {
+    it = properties_.emplace(it, key, asset_value());
+  }
+  return it->second;
+}
+
+inline void asset::erase(key_t key) {
+  if (auto it = find(key); it != end()) {
+    erase(it);
+  }
+}
+
+inline void asset::erase(const_iterator it) {
+  properties_.erase(it);
+}
+
+inline void asset_value::read_vector(const asset_value& val, float* out, size_t count) {
+  if (val.is_object()) {
+    constexpr symbol keys[] = { symbols::x, symbols::y, symbols::z, symbols::w };
+    const asset& obj = val.get<const asset&>();
+    for (size_t i = 0; i < count; i++) {
+      if (auto it = obj.find(keys[i]); it != obj.end()) {
+        out[i] = it->second.get<float>();
+      }
+    }
+    return;
+  }
+
+  assert(val.is_vector());
+  std::memcpy(out, val.floats(), sizeof(float) * std::min(count, val.floats_count()));
+}
+
 class asset_buffer {
  public:
   size_t size() const { return size_; }
@@ -740,17 +1100,103 @@ class asset_buffer {
   std::shared_ptr<uint8_t> ptr_;
 };
 
+struct loaded_buffer_memory {
+  std::shared_ptr<uint8_t> ptr;
+  bool mapped = false;
+};
+
+// Handle of asynchronous buffer load. Requests of the same buffer share one read.
+class buffer_request {
+ public:
+  buffer_request(size_t size, std::shared_future<loaded_buffer_memory> future)
+    : size_(size), future_(std::move(future))
+  {}
+
+  [[nodiscard]] bool ready() const {
+    return future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  void wait() const { future_.wait(); }
+
+  // Blocks until the buffer is loaded.
+  [[nodiscard]] asset_buffer get() const { return { size_, future_.get().ptr }; }
+
+ private:
+  size_t size_;
+  std::shared_future<loaded_buffer_memory> future_;
+};
+
+// Asset file is up to date while the root version and versions of its buffers don't change.
+struct asset_save_state {
+  uint32_t version = 0;
+  uint64_t buffers = 0;
+
+  bool operator==(const asset_save_state& other) const { return version == other.version && buffers == other.buffers; }
+  bool operator!=(const asset_save_state& other) const { return !(*this == other); }
+};
+
+// Memory held by the repository, buffers used only through asset_buffer handles aren't counted.
+struct buffer_memory_stats {
+  size_t budget = 0;
+  size_t resident = 0;
+  size_t cached = 0;
+  size_t modified = 0;
+  size_t cached_buffers = 0;
+  size_t pinned_buffers = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+};
+
+// Slots freed by asset_repository::collect_garbage.
+struct asset_garbage_stats {
+  size_t assets = 0;
+  size_t arrays = 0;
+  size_t buffers = 0;
+};
+
+// Slots of assets, arrays and buffers after asset_repository::compact, indexed by slots they had before.
+// Ids held outside the repository, like the one in version_component, are fixed up with it.
+struct asset_slot_remap {
+  static constexpr uint32_t invalid = std::numeric_limits<uint32_t>::max();
+
+  std::vector<uint32_t> assets;
+  std::vector<uint32_t> arrays;
+  std::vector<uint32_t> buffers;
+
+  [[nodiscard]] asset_id operator()(asset_id id) const { return { remap(assets, id.idx) }; }
+  [[nodiscard]] array_id operator()(array_id id) const { return { remap(arrays, id.idx) }; }
+  [[nodiscard]] buffer_id operator()(buffer_id id) const { return { remap(buffers, id.idx) }; }
+
+ private:
+  static uint32_t remap(const std::vector<uint32_t>& slots, uint32_t idx) {
+    return idx < slots.size() ? slots[idx] : invalid;
+  }
+};
+
 struct buffer_info {
   size_t size;
   fs::path path;
   size_t offset;
-  uint32_t hash;
+  uint64_t hash;
   mutable std::weak_ptr<uint8_t> weak_ptr;
   mutable std::shared_ptr<uint8_t> loaded_ptr;
+  // loaded memory is a read-only file mapping, it has to be copied before modification
+  mutable bool mapped = false;
+  // file is compressed buffer, size is the size of decompressed data
+  bool compressed = false;
+  // memory is a part of mapping owned elsewhere, e.g. by a bundle, it outlives the buffer
+  bool borrowed = false;
+  // changes with contents, unique within the repository
+  uint64_t version = 0;
 
   void destroy() {
     loaded_ptr.reset();
     weak_ptr.reset();
+    mapped = false;
+    compressed = false;
+    borrowed = false;
+    version = 0;
     path.clear();
     size = 0;
     offset = 0;
@@ -758,100 +1204,376 @@ struct buffer_info {
   }
 };
 
+// Lookups, buffer loads and snapshots can be done from any thread while one thread mutates the repository.
+// References returned by lookups are only safe to traverse inside read() or on the mutating thread,
+// jobs which need a consistent tree for longer work on snapshot().
 class asset_repository {
  public:
-  buffer_id create_buffer_from_file(const fs::path& path, uint32_t offset, uint32_t size) {
+  enum class batch_mode {
+    // version bumps are deferred to the end of the batch, each touched asset and its owners get one bump
+    DEFERRED,
+    // building new trees, versions stay as they are
+    CONSTRUCT
+  };
+
+  asset_repository() = default;
+  asset_repository(const asset_repository&) = delete;
+  asset_repository& operator=(const asset_repository&) = delete;
+
+  ~asset_repository() {
+    for (asset* a : objects_) {
+      if (a) asset_pool_.destroy(a);
+    }
+    for (asset_array* a : arrays_) {
+      if (a) array_pool_.destroy(a);
+    }
+  }
+
+  // Hash of the contents can be given if the file is named by it, then saving doesn't read the buffer.
+  buffer_id create_buffer_from_file(const fs::path& path, size_t offset, size_t size, uint64_t hash = 0) {
+    std::unique_lock lock(mutex_);
     assert(!path.empty());
     assert(fs::exists(path));
 
-    if (size == 0) {
+    bool compressed = is_compressed_buffer_file(path);
+    if (compressed) {
+      size_t raw_size = 0;
+      if (!compressed_buffer_size(path, raw_size)) {
+        logger::core::Error("Couldn't read compressed buffer {}", path.c_str());
+      }
+      assert(offset == 0);
+      size = raw_size;
+    } else if (size == 0) {
       size = fs::file_size(path);
     }
 
-    uint32_t index;
-    if (!buffers_free_list_.empty()) {
-      index = buffers_free_list_.back();
-      buffers_free_list_.pop_back();
-    } else {
-      index = buffers_.size();
-      buffers_.resize(index+1);
-    }
-
+    uint32_t index = add_buffer().idx;
     buffers_[index].path = std::move(path);
     buffers_[index].size = size;
     buffers_[index].offset = offset;
+    buffers_[index].compressed = compressed;
+    buffers_[index].hash = hash;
+    buffers_[index].version = ++buffer_versions_;
     return { index };
   }
 
+  // Buffer of a file range which is mapped already, e.g. a part of packed bundle. It shares the memory while
+  // the mapping lives and maps the range again after that.
+  buffer_id create_buffer_from_mapping(const fs::path& path, size_t offset, size_t size, uint64_t hash, std::shared_ptr<uint8_t> memory) {
+    std::unique_lock lock(mutex_);
+    buffer_id id = add_buffer();
+    buffer_info& buf = buffers_[id.idx];
+    buf.path = path;
+    buf.size = size;
+    buf.offset = offset;
+    buf.compressed = false;
+    buf.hash = hash;
+    buf.version = ++buffer_versions_;
+    buf.weak_ptr = memory;
+    buf.mapped = true;
+    buf.borrowed = true;
+    return id;
+  }
+
   void map_buffer_to_file(buffer_id id, const fs::path& path, uint32_t offset = 0, uint32_t size = 0) {
     assert(!path.empty());
     assert(fs::exists(path));
 
+    std::unique_lock lock(mutex_);
+    drop_pending_buffer(id);
+
     auto& buf = buffers_[id.idx];
+    if (buf.loaded_ptr) {
+      modified_bytes_ -= buf.size;
+    }
+    auto ptr = buf.weak_ptr.lock();
     buf.path = path;
     buf.loaded_ptr.reset();
     buf.offset = offset;
-    buf.size = size == 0 ? fs::file_size(path) : size;
+    buf.compressed = is_compressed_buffer_file(path);
+    if (buf.compressed) {
+      // memory is the same as before, only the file backing it changes
+      assert(offset == 0);
+    } else {
+      buf.size = size == 0 ? fs::file_size(path) : size;
+    }
+
+    // memory is clean now, it stays in the cache instead of being released
+    if (ptr && !buf.borrowed) {
+      touch_cached_buffer(id, std::move(ptr));
+    }
   }
 
-  void write_buffer_to_file(buffer_id id, const fs::path& path, uint32_t offset, bool remap = false) {
-    auto& buf = buffers_[id.idx];
-    std::ofstream dst(path, std::ios::out | std::ios::binary);
-    if (offset) dst.rdbuf()->pubseekoff(offset, std::ios::beg, std::ios::in | std::ios::out);
+  // With BLOCK compression buffer goes to path with compressed_buffer_extension if it compresses well.
+  // Returns path of the written file.
+  fs::path write_buffer_to_file(buffer_id id, const fs::path& path, uint32_t offset, buffer_compression compression = buffer_compression::NONE) {
+    asset_buffer data = load_buffer(id);
 
-    if (!buf.weak_ptr.expired()) {
-      std::copy_n(buf.weak_ptr.lock().get(), buf.size, std::ostreambuf_iterator<char>(dst));
-    } else {
-      std::ifstream src(buf.path, std::ios::in | std::ios::binary);
-      if (buf.offset) src.rdbuf()->pubseekoff(buf.offset, std::ios::beg, std::ios::in | std::ios::out);
-      std::copy_n(std::istreambuf_iterator<char>(src), buf.size, std::ostreambuf_iterator<char>(dst));
+    if (compression == buffer_compression::BLOCK && offset == 0) {
+      std::vector<uint8_t> compressed = compress_buffer(data.data(), data.size(), io_jobs_);
+      if (!compressed.empty()) {
+        fs::path compressed_path = fs::concat(path, compressed_buffer_extension);
+        fs::write_file(compressed_path, compressed.data(), compressed.size());
+        return compressed_path;
+      }
+    }
+
+    // whole files are replaced atomically, content addressed files must never be seen half written
+    if (!offset) {
+      fs::write_file(path, data.data(), data.size());
+      return path;
     }
+
+    std::ofstream dst(path, std::ios::out | std::ios::binary);
+    dst.rdbuf()->pubseekoff(offset, std::ios::beg, std::ios::in | std::ios::out);
+    dst.write(reinterpret_cast<const char*>(data.data()), (std::streamsize) data.size());
+    return path;
   }
 
   void update_buffer(buffer_id id, uint32_t offset, const void* data, uint32_t size) {
+    std::unique_lock lock(mutex_);
+    // keeps prefetched memory alive until it's copied
+    auto pending = take_pending_buffer(id);
+    auto cached = uncache_buffer(id, false);
+
     buffer_info& buf = buffers_[id.idx];
     auto ptr = buf.weak_ptr.lock();
-    if (!ptr) {
-      ptr = std::shared_ptr<uint8_t>(new uint8_t[buf.size], std::default_delete<uint8_t[]>());
+    long owners = 1 + (pending == ptr) + (cached == ptr) + (buf.loaded_ptr == ptr);
+    if (!ptr || buf.mapped || ptr.use_count() > owners) {
+      // copy on write, readers and snapshots holding the memory keep their data
+      auto copy = allocate_buffer_memory(buf.size);
+      if (ptr) {
+        std::memcpy(copy.get(), ptr.get(), buf.size);
+      } else if (!buf.path.empty()) {
+        read_buffer_file(buf, copy.get(), io_jobs_);
+      }
+
+      ptr = std::move(copy);
       buf.weak_ptr = ptr;
+      buf.mapped = false;
+      buf.borrowed = false;
     }
 
+    if (!buf.loaded_ptr) {
+      modified_bytes_ += buf.size;
+    }
     buf.loaded_ptr = ptr; // don't delete loaded memory until buffer is not saved to file
     buf.hash = 0;
+    buf.version = ++buffer_versions_;
     std::memcpy(ptr.get() + offset, data, size);
   }
 
   void destroy_buffer(buffer_id id) {
-    buffers_[id.idx].loaded_ptr.reset();
-    assert(buffers_[id.idx].weak_ptr.expired());
+    std::unique_lock lock(mutex_);
+    release_buffer_memory(id);
+    assert(buffers_[id.idx].weak_ptr.expired() || buffers_[id.idx].borrowed);
 
     buffers_free_list_.push_back(id.idx);
     buffers_[id.idx].destroy();
   }
 
   asset_buffer load_buffer(buffer_id id) {
+    std::shared_lock lock(mutex_);
+    std::lock_guard buffer_lock(buffer_mutex(id));
+
     buffer_info& buf = buffers_[id.idx];
-    auto ptr = buf.weak_ptr.lock();
-    if (!ptr) {
-      ptr = std::shared_ptr<uint8_t>(new uint8_t[buf.size], std::default_delete<uint8_t[]>());
-      buf.weak_ptr = ptr;
+    auto ptr = take_pending_buffer(id);
+    if (!ptr) ptr = buf.weak_ptr.lock();
+    if (ptr) {
+      buffer_hits_++;
+    } else {
+      buffer_misses_++;
+      // pages are read on first access, mapping is released with the last asset_buffer
+      if (!buf.compressed) {
+        ptr = os::map_file(buf.path, buf.offset, buf.size);
+      }
+      buf.mapped = (bool) ptr;
 
-      std::ifstream file(buf.path, std::ios::in | std::ios::out | std::ios::binary);
-      if (buf.offset) file.rdbuf()->pubseekoff(buf.offset, std::ios::beg, std::ios::in | std::ios::out);
-      std::copy_n(std::istreambuf_iterator<char>(file), buf.size, ptr.get());
+      if (!ptr) {
+        ptr = allocate_buffer_memory(buf.size);
+        read_buffer_file(buf, ptr.get(), io_jobs_);
+      }
+
+      buf.weak_ptr = ptr;
+      buf.borrowed = false;
     }
 
+    if (!buf.loaded_ptr && !buf.borrowed) {
+      touch_cached_buffer(id, ptr);
+    }
     return { buf.size, ptr };
   }
 
-  uint32_t buffer_hash(buffer_id id) {
+  // Jobs used by load_buffer_async, without them asynchronous loads are done on the calling thread.
+  void set_io_jobs(job_system* jobs) { io_jobs_ = jobs; }
+
+  buffer_request load_buffer_async(buffer_id id) {
+    std::shared_lock lock(mutex_);
+    std::lock_guard buffer_lock(buffer_mutex(id));
+
     buffer_info& buf = buffers_[id.idx];
-    if (!buf.hash) {
-      auto data = load_buffer(id);
-      buf.hash = utils::crc32(data.data(), data.size());
+    if (auto future = find_pending_buffer(id); future.valid())
+      return { buf.size, std::move(future) };
+
+    if (auto ptr = buf.weak_ptr.lock()) {
+      buffer_hits_++;
+      if (!buf.loaded_ptr && !buf.borrowed) {
+        touch_cached_buffer(id, ptr);
+      }
+
+      std::promise<loaded_buffer_memory> loaded;
+      loaded.set_value({ std::move(ptr), buf.mapped });
+      return { buf.size, loaded.get_future().share() };
+    }
+
+    buffer_misses_++;
+    auto read = [path = buf.path, offset = buf.offset, size = buf.size, compressed = buf.compressed, jobs = io_jobs_]() {
+      return read_buffer_memory(path, offset, size, compressed, jobs);
+    };
+
+    std::shared_future<loaded_buffer_memory> future;
+    if (io_jobs_) {
+      future = io_jobs_->submit(std::move(read)).share();
+    } else {
+      std::promise<loaded_buffer_memory> loaded;
+      loaded.set_value(read());
+      future = loaded.get_future().share();
+    }
+
+    std::lock_guard pending_lock(pending_mutex_);
+    pending_buffers_.emplace(id.idx, future);
+    return { buf.size, std::move(future) };
+  }
+
+  template<class It>
+  void prefetch(It first, It last) {
+    for (; first != last; ++first) {
+      load_buffer_async(*first);
+    }
+  }
+
+  // Releases prefetched buffers nobody loaded. Finished reads move to the buffer cache and count against
+  // the memory budget, memory of reads still in flight is freed when they complete.
+  template<class It>
+  void cancel_prefetch(It first, It last) {
+    std::shared_lock lock(mutex_);
+    for (; first != last; ++first) {
+      buffer_id id = *first;
+      std::lock_guard buffer_lock(buffer_mutex(id));
+      auto future = find_pending_buffer(id);
+      if (!future.valid())
+        continue;
+
+      if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        drop_pending_buffer(id);
+        continue;
+      }
+
+      auto ptr = take_pending_buffer(id);
+      if (!buffers_[id.idx].loaded_ptr && !buffers_[id.idx].borrowed) {
+        touch_cached_buffer(id, std::move(ptr));
+      }
+    }
+  }
+
+  // Prefetched memory is held by the repository until the buffer is loaded, its prefetch is cancelled or
+  // it's destroyed.
+  [[nodiscard]] size_t pending_buffer_loads() const {
+    std::lock_guard lock(pending_mutex_);
+    return std::count_if(pending_buffers_.begin(), pending_buffers_.end(), [](const auto& it) {
+      return it.second.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    });
+  }
+
+  // Clean buffers loaded from files stay in memory after their last asset_buffer is released, least recently
+  // used ones are evicted once memory held by the repository goes over the budget. Modified buffers are held
+  // until they are saved. Budget 0 disables the cache, memory lives as long as asset_buffer handles.
+  void set_buffer_memory_budget(size_t bytes) {
+    std::shared_lock lock(mutex_);
+    std::vector<std::shared_ptr<uint8_t>> evicted;
+    std::lock_guard cache_lock(cache_mutex_);
+    cache_budget_ = bytes;
+    evict_cached_buffers(evicted);
+  }
+
+  // Pinned buffer isn't evicted whatever the budget, memory loaded while it's pinned stays. Pins are counted.
+  void pin_buffer(buffer_id id) {
+    std::shared_lock lock(mutex_);
+    std::lock_guard buffer_lock(buffer_mutex(id));
+    std::lock_guard cache_lock(cache_mutex_);
+
+    auto it = cached_.find(id.idx);
+    if (it == cached_.end()) {
+      pinned_.push_front({ id.idx, 0, nullptr, 0 });
+      it = cached_.emplace(id.idx, pinned_.begin()).first;
+    } else if (!it->second->pins) {
+      pinned_.splice(pinned_.begin(), lru_, it->second);
     }
 
-    return buf.hash;
+    cached_buffer& entry = *it->second;
+    entry.pins++;
+
+    buffer_info& buf = buffers_[id.idx];
+    if (!entry.ptr && !buf.loaded_ptr) {
+      if (auto ptr = buf.weak_ptr.lock()) {
+        cached_bytes_ += buf.size;
+        entry.size = buf.size;
+        entry.ptr = std::move(ptr);
+      }
+    }
+  }
+
+  void unpin_buffer(buffer_id id) {
+    std::shared_lock lock(mutex_);
+    std::vector<std::shared_ptr<uint8_t>> evicted;
+    std::lock_guard cache_lock(cache_mutex_);
+
+    auto it = cached_.find(id.idx);
+    assert(it != cached_.end() && it->second->pins);
+    if (--it->second->pins)
+      return;
+
+    if (!it->second->ptr) {
+      pinned_.erase(it->second);
+      cached_.erase(it);
+      return;
+    }
+
+    lru_.splice(lru_.begin(), pinned_, it->second);
+    evict_cached_buffers(evicted);
+  }
+
+  [[nodiscard]] buffer_memory_stats buffer_memory() const {
+    std::lock_guard lock(cache_mutex_);
+    buffer_memory_stats stats;
+    stats.budget = cache_budget_;
+    stats.cached = cached_bytes_;
+    stats.modified = modified_bytes_;
+    stats.resident = stats.cached + stats.modified;
+    stats.cached_buffers = lru_.size() + std::count_if(pinned_.begin(), pinned_.end(), [](const auto& entry) { return entry.ptr != nullptr; });
+    stats.pinned_buffers = pinned_.size();
+    stats.hits = buffer_hits_;
+    stats.misses = buffer_misses_;
+    stats.evictions = buffer_evictions_;
+    return stats;
+  }
+
+  // Content hash, it names buffer files so it's 64-bit to keep collisions away at project sizes.
+  uint64_t buffer_hash(buffer_id id) {
+    std::shared_lock lock(mutex_);
+    buffer_info& buf = buffers_[id.idx];
+    {
+      std::lock_guard buffer_lock(buffer_mutex(id));
+      if (buf.hash)
+        return buf.hash;
+    }
+
+    auto data = load_buffer(id);
+    uint64_t hash = utils::hash64(data.data(), data.size());
+
+    std::lock_guard buffer_lock(buffer_mutex(id));
+    buf.hash = hash;
+    return hash;
   }
 
   asset& create_asset() {
@@ -859,6 +1581,7 @@ class asset_repository {
   }
 
   asset& create_asset(guid guid) {
+    std::unique_lock lock(mutex_);
     if (!guid.is_valid())
       guid = guid::generate();
 
@@ -871,84 +1594,292 @@ class asset_repository {
       objects_.resize(index+1);
     }
 
-    asset* ptr = (objects_[index] = std::make_unique<asset>(asset_id { index })).get();
+    asset* ptr = objects_[index] = asset_pool_.create(asset_id { index });
 
     if (auto it = guid_to_asset_.find(guid); it != guid_to_asset_.end()) {
       logger::core::Error("Couldn't create asset with guid {} because it has been reserved.", guid.str());
       guid = guid::generate();
     }
 
+    // new asset replaces the one in file
+    forget_unloaded_asset(guid);
     guid_to_asset_[guid] = ptr;
     asset_to_info_[ptr].id = guid;
     return *ptr;
   }
 
   void destroy_asset(asset_id id) {
+    std::unique_lock lock(mutex_);
     asset& a = *objects_[id.idx];
     assert(a.is_orphan());
 
     destroy_asset_value_recursive(a);
   }
 
-  const fs::path& get_asset_path(asset_id asset_id) {
+  // Lookups return copies, the repository may change once the lock is released.
+  fs::path get_asset_path(asset_id asset_id) const {
+    std::shared_lock lock(mutex_);
     assert(objects_[asset_id.idx]);
-    auto a = objects_[asset_id.idx].get();
-    return asset_to_info_[a].path;
+    auto a = objects_[asset_id.idx];
+    return asset_to_info_.at(a).path;
   }
 
   bool set_asset_path(asset_id asset_id, const fs::path& p) {
+    std::unique_lock lock(mutex_);
     assert(objects_[asset_id.idx]);
-    auto a = objects_[asset_id.idx].get();
+    auto a = objects_[asset_id.idx];
     auto& existed = path_to_asset_[p];
     if (existed != nullptr && existed != a)
       return false;
 
     existed = a;
-    asset_to_info_[a].path = p;
+    forget_unloaded_path(p);
+    auto& info = asset_to_info_[a];
+    if (info.path != p) {
+      info.saved.reset();
+    }
+    info.path = p;
     return true;
   }
 
-  const guid& get_guid(const asset& asset) {
+  [[nodiscard]] asset_save_state save_state(const asset& root) const {
+    std::shared_lock lock(mutex_);
+    asset_save_state state { root.version(), 0 };
+    for_each_buffer(root, [&](buffer_id id) {
+      state.buffers = (state.buffers ^ buffers_[id.idx].version) * 0x100000001B3ULL;
+    });
+    return state;
+  }
+
+  // Asset file at the asset path was written from the state or loaded.
+  void mark_saved(const asset& root, const asset_save_state& state) {
+    std::unique_lock lock(mutex_);
+    asset_to_info_.at(const_cast<asset*>(&root)).saved = state;
+  }
+
+  void mark_saved(const asset& root) {
+    mark_saved(root, save_state(root));
+  }
+
+  // True if the root was changed since it was saved or loaded, or it never was.
+  [[nodiscard]] bool is_dirty(const asset& root) const {
+    std::shared_lock lock(mutex_);
+    const auto& saved = asset_to_info_.at(const_cast<asset*>(&root)).saved;
+    return !saved || *saved != save_state(root);
+  }
+
+  guid get_guid(const asset& asset) const {
     return get_guid(asset.id());
   }
 
-  const guid& get_guid(asset_id asset_id) {
+  guid get_guid(asset_id asset_id) const {
+    std::shared_lock lock(mutex_);
     assert(objects_[asset_id.idx]);
-    auto a = objects_[asset_id.idx].get();
-    return asset_to_info_[a].id;
+    auto a = objects_[asset_id.idx];
+    return asset_to_info_.at(a).id;
   }
 
-  asset* get_asset(asset_id id) {
+  asset* get_asset(asset_id id) const {
+    std::shared_lock lock(mutex_);
     if (id.idx >= objects_.size() || !objects_[id.idx])
       return nullptr;
 
-    return objects_[id.idx].get();
+    return objects_[id.idx];
   }
 
   asset* get_asset_by_path(const fs::path& p) const {
-    auto it = path_to_asset_.find(p);
-    return it != path_to_asset_.end() ? it->second : nullptr;
+    {
+      std::shared_lock lock(mutex_);
+      auto it = path_to_asset_.find(p);
+      if (it != path_to_asset_.end())
+        return it->second;
+
+      if (!unloaded_paths_.count(p))
+        return nullptr;
+    }
+    return load_unloaded_asset(p);
   }
 
   asset* get_asset(const guid& id) const {
+    std::string path;
+    {
+      std::shared_lock lock(mutex_);
+      auto it = guid_to_asset_.find(id);
+      if (it != guid_to_asset_.end())
+        return it->second;
+
+      auto unloaded = unloaded_.find(id);
+      if (unloaded == unloaded_.end())
+        return nullptr;
+      path = unloaded->second;
+    }
+    return load_unloaded_asset(path);
+  }
+
+  // Lookups which don't load assets on demand.
+  asset* find_loaded_asset(const guid& id) const {
+    std::shared_lock lock(mutex_);
     auto it = guid_to_asset_.find(id);
     return it != guid_to_asset_.end() ? it->second : nullptr;
   }
 
+  asset* find_loaded_asset_by_path(const fs::path& p) const {
+    std::shared_lock lock(mutex_);
+    auto it = path_to_asset_.find(p);
+    return it != path_to_asset_.end() ? it->second : nullptr;
+  }
+
+  // Referenced asset, or null if it doesn't exist. Legacy guid strings are parsed on every call.
+  asset* resolve(const asset_value& ref) const {
+    guid id;
+    {
+      std::shared_lock lock(mutex_);
+      if (ref.is_string()) {
+        id = guid::from_string(ref.get<std::string_view>());
+        auto it = guid_to_asset_.find(id);
+        if (it != guid_to_asset_.end())
+          return it->second;
+      } else if (ref.is_reference()) {
+        const asset_reference& reference = *ref.value_.reference;
+        uint32_t epoch = epoch_.load(std::memory_order_relaxed);
+        uint64_t cache = reference.cache.load(std::memory_order_relaxed);
+        if (cache >> 32u == epoch)
+          return objects_[(uint32_t) cache];
+
+        id = reference.id;
+        auto it = guid_to_asset_.find(id);
+        if (it != guid_to_asset_.end()) {
+          reference.cache.store(asset_reference::cache_key(epoch, it->second->id().idx), std::memory_order_relaxed);
+          return it->second;
+        }
+      }
+
+      if (!unloaded_.count(id))
+        return nullptr;
+    }
+    // reference caches the slot on the next resolve
+    return get_asset(id);
+  }
+
+  // Parses the asset file at the project path into a repository of its own, returns null if it can't.
+  using asset_loader = std::function<asset*(asset_repository& staging, const fs::path& path)>;
+
+  // Assets which exist in files but aren't loaded yet are loaded by the lookups above on first use. Shared lock
+  // can't be upgraded, inside read() such assets aren't found. Loaded asset is clean and has its path.
+  void set_asset_loader(asset_loader loader) {
+    std::unique_lock lock(mutex_);
+    loader_ = std::move(loader);
+  }
+
+  // Does nothing if an asset with the guid or path is loaded already.
+  void add_unloaded_asset(const guid& id, const fs::path& path) {
+    std::unique_lock lock(mutex_);
+    if (guid_to_asset_.count(id) || path_to_asset_.count(path))
+      return;
+
+    forget_unloaded_asset(id);
+    forget_unloaded_path(path);
+    unloaded_.emplace(id, path);
+    unloaded_paths_.emplace(path, id);
+  }
+
+  [[nodiscard]] size_t unloaded_assets_count() const {
+    std::shared_lock lock(mutex_);
+    return unloaded_.size();
+  }
+
+  // Runs func with the repository locked for reading, assets can't change or go away until it returns.
+  // Mutators called from func throw std::logic_error.
+  template<class F>
+  decltype(auto) read(F&& func) const {
+    std::shared_lock lock(mutex_);
+    return func();
+  }
+
+  // Immutable copy of the asset tree. Snapshots are shared while the asset version doesn't change.
+  std::shared_ptr<const asset_snapshot> snapshot(asset_id id);
+
+  // Deep copies asset tree owned by another repository. Guids are preserved, buffers share already loaded memory.
+  asset& import_asset(asset_repository& src, const asset& root) {
+    std::shared_lock src_lock(src.mutex_);
+    std::unique_lock lock(mutex_);
+    begin_batch(batch_mode::CONSTRUCT);
+    asset& dst = create_asset(src.get_guid(root));
+    for (auto& [name, val] : root) {
+      set_value(dst, name, import_asset_value(src, val));
+    }
+    end_batch();
+    return dst;
+  }
+
   void copy_value(asset& a, const asset::key_t& key, const asset_value& value) {
-    set_value(a, key, copy_asset_value(value));
+    std::unique_lock lock(mutex_);
+    begin_batch(batch_mode::CONSTRUCT);
+    asset_value copy = copy_asset_value(value);
+    end_batch();
+
+    set_value(a, key, std::move(copy));
   }
 
   void set_value(asset& a, const asset::key_t& key, asset_value value) {
+    std::unique_lock lock(mutex_);
     auto it = a.find_impl(key);
     if (it != a.end()) {
       destroy_asset_value_recursive(std::move(it->second));
     }
 
-    set_owner(value, &a);
+    // owners of the assigned values are set when the batch ends
+    if (batch_depth_) {
+      batch_touched_.push_back(a.id().idx);
+    } else {
+      set_owner(value, &a);
+    }
 
     a[key] = std::move(value);
-    a.increment_version();
+
+    if (!batch_depth_) {
+      a.increment_version();
+    }
+  }
+
+  // Until the outermost batch ends owners of values assigned by set_value and asset versions aren't updated.
+  // Nested batches take mode of the outermost one. Readers on other threads wait for the batch to end.
+  void begin_batch(batch_mode mode = batch_mode::DEFERRED) {
+    mutex_.lock();
+    if (!batch_depth_++) {
+      batch_mode_ = mode;
+    }
+  }
+
+  void end_batch() {
+    assert(batch_depth_);
+    std::unique_lock lock(mutex_, std::adopt_lock);
+    if (--batch_depth_)
+      return;
+
+    std::sort(batch_touched_.begin(), batch_touched_.end());
+    batch_touched_.erase(std::unique(batch_touched_.begin(), batch_touched_.end()), batch_touched_.end());
+
+    // ids of assets destroyed during the batch are null or point to reused slots, extra work on those is harmless
+    for (uint32_t idx : batch_touched_) {
+      if (asset* a = objects_[idx]) {
+        for (auto& [_, value] : a->items()) {
+          set_owner(value, a);
+        }
+      }
+    }
+
+    if (batch_mode_ == batch_mode::DEFERRED) {
+      std::vector<bool> bumped(objects_.size());
+      for (uint32_t idx : batch_touched_) {
+        for (asset* curr = objects_[idx]; curr && !bumped[curr->id().idx]; curr = curr->owner_) {
+          bumped[curr->id().idx] = true;
+          ++curr->version_;
+        }
+      }
+    }
+
+    batch_touched_.clear();
   }
 
   void set_value(asset_id asset_id, const asset::key_t& key, asset_value value) {
@@ -962,17 +1893,34 @@ class asset_repository {
   }
 
   void set_ref(asset& a, const asset::key_t& key, asset_id value) {
-    auto& guid = get_guid(value);
-    set_value(a, key, guid.str());
+    std::unique_lock lock(mutex_);
+    set_value(a, key, reference(value));
+  }
+
+  // Reference value to the asset with the lookup already cached.
+  asset_value reference(asset_id id) const {
+    std::shared_lock lock(mutex_);
+    asset* target = objects_[id.idx];
+    assert(target);
+
+    asset_value ref = asset_to_info_.at(target).id;
+    ref.value_.reference->cache.store(asset_reference::cache_key(epoch_.load(std::memory_order_relaxed), id.idx), std::memory_order_relaxed);
+    return ref;
+  }
+
+  asset_value reference(const asset& a) const {
+    return reference(a.id());
   }
 
   void erase(asset& a, const asset::key_t& key) {
+    std::unique_lock lock(mutex_);
     auto it = a.find_impl(key);
     if (it == a.end())
       return;
 
     destroy_asset_value_recursive(std::move(it->second));
     a.erase(key);
+    touch(&a);
   }
 
   void erase(asset_id asset_id, const asset::key_t& key) {
@@ -981,6 +1929,7 @@ class asset_repository {
   }
 
   asset_array& create_array() {
+    std::unique_lock lock(mutex_);
     uint32_t index;
     if (!arrays_free_list_.empty()) {
       index = arrays_free_list_.back();
@@ -990,7 +1939,7 @@ class asset_repository {
       arrays_.resize(index+1);
     }
 
-    return *(arrays_[index] = std::make_unique<asset_array>(array_id { index }));
+    return *(arrays_[index] = array_pool_.create(array_id { index }));
   }
 
 //  void destroy_array(asset_array& arr) {
@@ -1003,14 +1952,21 @@ class asset_repository {
   }
 
   void push_back(asset_array& array, asset_value val) {
-    set_owner(val, &array.owner());
+    std::unique_lock lock(mutex_);
+    // arrays built in a batch get their owner when they are assigned
+    if (!batch_depth_ || !array.is_orphan()) {
+      set_owner(val, array.owner_);
+    }
 
     array.push_back(std::move(val));
+    touch(array);
   }
 
   void pop_back(asset_array& array) {
+    std::unique_lock lock(mutex_);
     destroy_asset_value_recursive(std::move(array.back()));
     array.pop_back();
+    touch(array);
   }
 
   void pop_back(array_id id) {
@@ -1019,28 +1975,44 @@ class asset_repository {
   }
 
   buffer_id create_buffer(uint32_t size) {
-    buffer_id id = add_buffer();
-    buffer_info& buffer = get_buffer_info(id);
-
-    auto ptr = std::shared_ptr<uint8_t>(new uint8_t[size ? size : 1], std::default_delete<uint8_t[]>());
+    auto ptr = allocate_buffer_memory(size);
     if (size) {
       std::memset(ptr.get(), 0, size);
     }
+    return create_buffer(std::move(ptr), size);
+  }
+
+  // Uninitialized memory for buffers.
+  static std::shared_ptr<uint8_t> allocate_buffer_memory(size_t size) {
+    return std::shared_ptr<uint8_t>(new uint8_t[size ? size : 1], std::default_delete<uint8_t[]>());
+  }
+
+  // Buffer takes memory filled elsewhere, e.g. by import jobs, without copying it.
+  buffer_id create_buffer(std::shared_ptr<uint8_t> memory, size_t size) {
+    std::unique_lock lock(mutex_);
+    buffer_id id = add_buffer();
+    buffer_info& buffer = get_buffer_info(id);
 
     buffer.size = size;
     buffer.path = {};
     buffer.offset = 0;
-    buffer.weak_ptr = ptr;
-    buffer.loaded_ptr = ptr; // don't delete memory until buffer is not mapped to file
+    buffer.compressed = false;
+    buffer.version = ++buffer_versions_;
+    buffer.weak_ptr = memory;
+    buffer.loaded_ptr = std::move(memory); // don't delete memory until buffer is not mapped to file
+    modified_bytes_ += size;
     return id;
   }
 
   asset_array::const_iterator erase(asset_array& array, asset_array::const_iterator it) {
+    std::unique_lock lock(mutex_);
     auto ps = it - array.begin();
     auto ptr = array.items().begin() + ps;
     destroy_asset_value_recursive(std::move(*ptr));
 
-    return array.erase(it);
+    auto next = array.erase(it);
+    touch(array);
+    return next;
   }
 
   asset_array::const_iterator erase(array_id id, asset_array::const_iterator it) {
@@ -1054,15 +2026,46 @@ class asset_repository {
   }
 
   asset_array::const_iterator insert(asset_array& array, asset_array::const_iterator it, asset_value val) {
-    set_owner(val, &array.owner());
-    return array.insert(it, std::move(val));
+    std::unique_lock lock(mutex_);
+    if (!batch_depth_ || !array.is_orphan()) {
+      set_owner(val, array.owner_);
+    }
+
+    auto pos = array.insert(it, std::move(val));
+    touch(array);
+    return pos;
   }
 
+  // Frees assets, arrays and buffers which can't be reached from roots: assets with a path, the given assets and
+  // pinned buffers. Owned assets keep their owners, references and guid strings keep loaded assets they point to.
+  // Values created but not assigned yet are unreachable, call it on the mutating thread between edits.
+  asset_garbage_stats collect_garbage(const std::vector<asset_id>& roots = {});
+
+  // Moves live assets, arrays and buffers to the lowest slots so the slot vectors are dense again.
+  // Ids held outside the repository are stale until they are remapped, references are looked up again.
+  asset_slot_remap compact();
+
+  // Not synchronized, iterate on the mutating thread or inside read().
   auto begin() const { return asset_to_info_.begin(); }
   auto end() const { return asset_to_info_.end(); }
 
  private:
 
+  // Versions identify tree contents, snapshots and reloads rely on every change reaching the root.
+  void touch(asset* a) {
+    if (batch_depth_) {
+      batch_touched_.push_back(a->id().idx);
+    } else {
+      a->increment_version();
+    }
+  }
+
+  void touch(asset_array& array) {
+    if (!array.is_orphan()) {
+      touch(&array.owner());
+    }
+  }
+
   void set_owner(asset_value& value, asset* owner) {
     if (value.is_object()) {
       asset& obj = value;
@@ -1087,10 +2090,11 @@ class asset_repository {
     }
   }
 
-  void free_asset(asset_id id) {
-    auto& ptr = objects_[id.idx];
+  // Forgets the asset, the object itself is still alive and has to be destroyed by the caller.
+  asset* release_asset_slot(asset_id id) {
+    asset* ptr = objects_[id.idx];
 
-    if (auto it = asset_to_info_.find(ptr.get()); it != asset_to_info_.end()) {
+    if (auto it = asset_to_info_.find(ptr); it != asset_to_info_.end()) {
       if (it->second.id.is_valid()) {
         guid_to_asset_.erase(it->second.id);
       }
@@ -1101,12 +2105,21 @@ class asset_repository {
     }
 
     objects_free_list_.push_back(id.idx);
-    ptr.reset();
+    objects_[id.idx] = nullptr;
+    return ptr;
+  }
+
+  // Cached slots of references are looked up again.
+  void invalidate_references() {
+    if (epoch_.fetch_add(1, std::memory_order_relaxed) == ~uint32_t(0)) {
+      epoch_.store(1, std::memory_order_relaxed);
+    }
   }
 
   void free_array(array_id id) {
     arrays_free_list_.push_back(id.idx);
-    arrays_[id.idx].reset();
+    array_pool_.destroy(arrays_[id.idx]);
+    arrays_[id.idx] = nullptr;
   }
 
   asset_value copy_asset_value(const asset_value& src) {
@@ -1130,44 +2143,334 @@ class asset_repository {
       buffer_id dst_id = add_buffer();
       buffer_info& buf_dst = get_buffer_info(dst_id);
       buf_dst = get_buffer_info(src);
+      if (buf_dst.loaded_ptr) {
+        modified_bytes_ += buf_dst.size;
+      }
       return dst_id;
     }
 
     return asset_value::copy(src);
   }
 
+  asset_value import_asset_value(asset_repository& src, const asset_value& value) {
+    if (value.is_object()) {
+      return import_asset(src, static_cast<const asset&>(value));
+    }
+
+    if (value.is_array()) {
+      asset_array& arr_dst = create_array();
+      for (auto& val : static_cast<const asset_array&>(value)) {
+        push_back(arr_dst, import_asset_value(src, val));
+      }
+      return arr_dst;
+    }
+
+    if (value.is_buffer()) {
+      buffer_id src_id = value;
+      buffer_id dst_id = add_buffer();
+      std::lock_guard buffer_lock(src.buffer_mutex(src_id));
+      buffer_info& buf_dst = get_buffer_info(dst_id);
+      buf_dst = src.get_buffer_info(src_id);
+      buf_dst.version = ++buffer_versions_;
+      if (buf_dst.loaded_ptr) {
+        modified_bytes_ += buf_dst.size;
+      }
+      return dst_id;
+    }
+
+    return asset_value::copy(value);
+  }
+
+  // Collects the whole tree first and then releases it in one pass, nested values are not moved around.
+  template<class F>
+  static void for_each_buffer(const asset& root, F&& func) {
+    std::vector<const asset_value*> stack;
+    for (auto& [_, val] : root) {
+      stack.push_back(&val);
+    }
+
+    while (!stack.empty()) {
+      const asset_value& val = *stack.back();
+      stack.pop_back();
+
+      if (val.is_buffer()) {
+        func(val.get<buffer_id>());
+      } else if (val.is_object()) {
+        for (auto& [_, sub] : val.get<const asset&>()) {
+          stack.push_back(&sub);
+        }
+      } else if (val.is_array()) {
+        for (auto& sub : val.get<const asset_array&>()) {
+          stack.push_back(&sub);
+        }
+      }
+    }
+  }
+
   void destroy_asset_value_recursive(asset_value value) {
-    std::vector<asset_value> queue;
-    queue.emplace_back(std::move(value));
-    while (!queue.empty()) {
-      asset_value back = std::move(queue.back());
-      queue.pop_back();
-      if (back.is_object()) {
-        auto& obj = static_cast<asset&>(back);
-        for (auto& [_, sub] : obj.items()) {
-          if (!sub.is_primitive()) {
-            queue.emplace_back(std::move(sub));
-          }
+    std::vector<asset*> objects;
+    std::vector<asset_array*> arrays;
+
+    auto visit = [&](asset_value& val) {
+      if (val.is_object()) {
+        objects.push_back(&static_cast<asset&>(val));
+      } else if (val.is_array()) {
+        arrays.push_back(&static_cast<asset_array&>(val));
+      } else if (val.is_buffer()) {
+        destroy_buffer(val);
+      }
+    };
+
+    visit(value);
+    for (size_t objects_pos = 0, arrays_pos = 0; objects_pos < objects.size() || arrays_pos < arrays.size();) {
+      if (objects_pos < objects.size()) {
+        for (auto& [_, sub] : objects[objects_pos++]->items()) {
+          visit(sub);
         }
-        free_asset(obj.id());
-      } else if (back.is_array()) {
-        auto& arr = static_cast<asset_array&>(back);
-        for (auto& sub : arr.items()) {
-          if (!sub.is_primitive()) {
-            queue.emplace_back(std::move(sub));
-          }
+      } else {
+        for (auto& sub : arrays[arrays_pos++]->items()) {
+          visit(sub);
         }
-        free_array(arr.id());
-      } else if (back.is_buffer()) {
-        destroy_buffer(back);
       }
     }
+
+    // slots are released one by one, objects go back to the pools in bulk
+    objects_free_list_.reserve(objects_free_list_.size() + objects.size());
+    for (asset* obj : objects) {
+      release_asset_slot(obj->id());
+    }
+    asset_pool_.destroy(objects.data(), objects.size());
+    invalidate_references();
+
+    arrays_free_list_.reserve(arrays_free_list_.size() + arrays.size());
+    for (asset_array* arr : arrays) {
+      arrays_free_list_.push_back(arr->id().idx);
+      arrays_[arr->id().idx] = nullptr;
+    }
+    array_pool_.destroy(arrays.data(), arrays.size());
+
+    // big trees leave whole slabs free, they are returned to the system
+    if (objects.size() >= slab_trim_threshold) {
+      asset_pool_.trim();
+    }
+    if (arrays.size() >= slab_trim_threshold) {
+      array_pool_.trim();
+    }
   }
 
   buffer_info& get_buffer_info(buffer_id id) {
     return buffers_[id.idx];
   }
 
+  std::mutex& buffer_mutex(buffer_id id) const {
+    return buffer_mutexes_[id.idx % buffer_mutexes_.size()];
+  }
+
+  std::shared_future<loaded_buffer_memory> find_pending_buffer(buffer_id id) const {
+    std::lock_guard lock(pending_mutex_);
+    auto it = pending_buffers_.find(id.idx);
+    return it != pending_buffers_.end() ? it->second : std::shared_future<loaded_buffer_memory>();
+  }
+
+  // Memory still used through asset_buffer handles is released with the last of them.
+  void release_buffer_memory(buffer_id id) {
+    drop_pending_buffer(id);
+    uncache_buffer(id, true);
+    if (buffers_[id.idx].loaded_ptr) {
+      modified_bytes_ -= buffers_[id.idx].size;
+    }
+    buffers_[id.idx].loaded_ptr.reset();
+  }
+
+  void drop_pending_buffer(buffer_id id) {
+    std::lock_guard lock(pending_mutex_);
+    pending_buffers_.erase(id.idx);
+  }
+
+  // Waits for asynchronous load of the buffer if there is one in flight and returns its memory.
+  // Called with the buffer locked.
+  std::shared_ptr<uint8_t> take_pending_buffer(buffer_id id) {
+    std::shared_future<loaded_buffer_memory> future;
+    {
+      std::lock_guard lock(pending_mutex_);
+      auto it = pending_buffers_.find(id.idx);
+      if (it == pending_buffers_.end())
+        return {};
+
+      future = std::move(it->second);
+      pending_buffers_.erase(it);
+    }
+
+    loaded_buffer_memory loaded = future.get();
+
+    buffer_info& buf = buffers_[id.idx];
+    if (auto ptr = buf.weak_ptr.lock())
+      return ptr;
+
+    buf.weak_ptr = loaded.ptr;
+    buf.mapped = loaded.mapped;
+    buf.borrowed = false;
+    return std::move(loaded.ptr);
+  }
+
+  // Runs on io jobs, pages of the mapping are touched so the file is read before the buffer is used.
+  static loaded_buffer_memory read_buffer_memory(const fs::path& path, size_t offset, size_t size, bool compressed, job_system* jobs) {
+    if (compressed) {
+      auto ptr = allocate_buffer_memory(size);
+      decompress_buffer_file(path, ptr.get(), size, jobs);
+      return { std::move(ptr), false };
+    }
+
+    if (auto ptr = os::map_file(path, offset, size)) {
+      constexpr size_t page_size = 4096;
+      volatile uint8_t sink = 0;
+      for (size_t i = 0; i < size; i += page_size) {
+        sink = sink + ptr.get()[i];
+      }
+      return { std::move(ptr), true };
+    }
+
+    auto ptr = allocate_buffer_memory(size);
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (offset) file.seekg((std::streamoff) offset);
+    file.read(reinterpret_cast<char*>(ptr.get()), (std::streamsize) size);
+    return { std::move(ptr), false };
+  }
+
+  static void decompress_buffer_file(const fs::path& path, uint8_t* dst, size_t size, job_system* jobs) {
+    if (!decompress_buffer(path, dst, size, jobs)) {
+      logger::core::Error("Couldn't decompress buffer {}", path.c_str());
+      std::memset(dst, 0, size);
+    }
+  }
+
+  static void read_buffer_file(const buffer_info& buf, uint8_t* dst, job_system* jobs) {
+    if (buf.compressed) {
+      decompress_buffer_file(buf.path, dst, buf.size, jobs);
+      return;
+    }
+
+    std::ifstream file(buf.path, std::ios::in | std::ios::binary);
+    if (buf.offset) file.seekg((std::streamoff) buf.offset);
+    file.read(reinterpret_cast<char*>(dst), (std::streamsize) buf.size);
+  }
+
+  // Called with the buffer locked when its clean memory is used, the buffer becomes the most recently used one.
+  void touch_cached_buffer(buffer_id id, std::shared_ptr<uint8_t> ptr) {
+    std::vector<std::shared_ptr<uint8_t>> evicted;
+    std::lock_guard lock(cache_mutex_);
+
+    auto it = cached_.find(id.idx);
+    if (it == cached_.end()) {
+      if (!cache_budget_)
+        return;
+
+      lru_.push_front({ id.idx, 0, nullptr, 0 });
+      it = cached_.emplace(id.idx, lru_.begin()).first;
+    } else if (!it->second->pins) {
+      lru_.splice(lru_.begin(), lru_, it->second);
+    }
+
+    cached_buffer& entry = *it->second;
+    cached_bytes_ = cached_bytes_ - entry.size + buffers_[id.idx].size;
+    entry.size = buffers_[id.idx].size;
+    if (entry.ptr != ptr) {
+      evicted.push_back(std::exchange(entry.ptr, std::move(ptr)));
+    }
+    evict_cached_buffers(evicted);
+  }
+
+  // Memory leaves the cache when the buffer is modified or destroyed, returns it so the caller decides when it goes.
+  // Pins of modified buffer stay.
+  std::shared_ptr<uint8_t> uncache_buffer(buffer_id id, bool unpin) {
+    std::lock_guard lock(cache_mutex_);
+    auto it = cached_.find(id.idx);
+    if (it == cached_.end())
+      return {};
+
+    cached_buffer& entry = *it->second;
+    cached_bytes_ -= entry.size;
+    entry.size = 0;
+    auto ptr = std::move(entry.ptr);
+
+    if (unpin || !entry.pins) {
+      (entry.pins ? pinned_ : lru_).erase(it->second);
+      cached_.erase(it);
+    }
+    return ptr;
+  }
+
+  // Called with the cache locked, memory is released by the caller after unlocking.
+  void evict_cached_buffers(std::vector<std::shared_ptr<uint8_t>>& evicted) {
+    auto it = lru_.end();
+    while (it != lru_.begin() && (!cache_budget_ || cached_bytes_ + modified_bytes_ > cache_budget_)) {
+      --it;
+      // eviction doesn't free memory used through handles, it's released with the last of them
+      if (cache_budget_ && it->ptr.use_count() > 1)
+        continue;
+
+      cached_bytes_ -= it->size;
+      evicted.push_back(std::move(it->ptr));
+      cached_.erase(it->index);
+      it = lru_.erase(it);
+      buffer_evictions_++;
+    }
+  }
+
+  // Called with the repository locked exclusively.
+  void forget_unloaded_asset(const guid& id) {
+    if (auto it = unloaded_.find(id); it != unloaded_.end()) {
+      unloaded_paths_.erase(it->second);
+      unloaded_.erase(it);
+    }
+  }
+
+  void forget_unloaded_path(const std::string& path) {
+    if (auto it = unloaded_paths_.find(path); it != unloaded_paths_.end()) {
+      unloaded_.erase(it->second);
+      unloaded_paths_.erase(it);
+    }
+  }
+
+  // File is parsed without locks, threads loading the same asset race and the first one to import it wins.
+  asset* load_unloaded_asset(const std::string& path) const {
+    if (mutex_.held_shared_by_this_thread()) {
+      logger::core::Warning("Asset {} isn't loaded and can't be loaded while the repository is locked for reading", path);
+      return nullptr;
+    }
+
+    asset_loader loader;
+    {
+      std::shared_lock lock(mutex_);
+      loader = loader_;
+    }
+
+    asset_repository staging;
+    asset* staged = loader ? loader(staging, path) : nullptr;
+
+    auto& self = const_cast<asset_repository&>(*this);
+    std::unique_lock lock(mutex_);
+    if (auto it = path_to_asset_.find(path); it != path_to_asset_.end())
+      return it->second;
+
+    if (!staged) {
+      logger::core::Error("Couldn't load asset {}", path);
+      self.forget_unloaded_path(path);
+      return nullptr;
+    }
+
+    if (auto it = guid_to_asset_.find(staging.get_guid(*staged)); it != guid_to_asset_.end()) {
+      logger::core::Warning("Asset {} has the same guid as loaded asset {}", path, asset_to_info_.at(it->second).path.c_str());
+      self.forget_unloaded_path(path);
+      return nullptr;
+    }
+
+    asset& a = self.import_asset(staging, *staged);
+    self.set_asset_path(a.id(), path);
+    self.mark_saved(a);
+    return &a;
+  }
+
   buffer_id add_buffer() {
     uint32_t index;
     if (!buffers_free_list_.empty()) {
@@ -1182,23 +2485,142 @@ class asset_repository {
   }
 
  private:
-  std::vector<std::unique_ptr<asset>> objects_;
-  std::vector<std::unique_ptr<asset_array>> arrays_;
+  // trees freed at once with at least this many objects or arrays trim the pools
+  static constexpr size_t slab_trim_threshold = 256;
+
+  slab_pool<asset> asset_pool_;
+  slab_pool<asset_array> array_pool_;
+  std::vector<asset*> objects_;
+  std::vector<asset_array*> arrays_;
   std::vector<uint32_t> objects_free_list_;
   std::vector<uint32_t> arrays_free_list_;
 
   std::vector<buffer_info> buffers_;
+  uint64_t buffer_versions_ = 0;
   std::vector<uint32_t> buffers_free_list_;
 
+  job_system* io_jobs_ = nullptr;
+  std::unordered_map<uint32_t, std::shared_future<loaded_buffer_memory>> pending_buffers_;
+
+  // clean memory of buffers, least recently used at the back of lru_, pinned ones are kept apart
+  struct cached_buffer {
+    uint32_t index;
+    size_t size = 0;
+    std::shared_ptr<uint8_t> ptr;
+    uint32_t pins = 0;
+  };
+
+  std::list<cached_buffer> lru_;
+  std::list<cached_buffer> pinned_;
+  std::unordered_map<uint32_t, std::list<cached_buffer>::iterator> cached_;
+  size_t cache_budget_ = 0;
+  size_t cached_bytes_ = 0;
+  uint64_t buffer_evictions_ = 0;
+  std::atomic<size_t> modified_bytes_ = 0;
+  std::atomic<uint64_t> buffer_hits_ = 0;
+  std::atomic<uint64_t> buffer_misses_ = 0;
+
+  // shared lock for lookups and loads, per buffer state is guarded by one of the sharded mutexes
+  mutable reentrant_shared_mutex mutex_;
+  mutable std::array<std::mutex, 16> buffer_mutexes_;
+  mutable std::mutex pending_mutex_;
+  // taken after buffer mutexes
+  mutable std::mutex cache_mutex_;
+
   struct asset_info {
     guid id;
     fs::path path;
+    std::optional<asset_save_state> saved;
   };
 
   std::unordered_map<guid, asset*> guid_to_asset_;
   std::unordered_map<std::string, asset*> path_to_asset_;
   std::unordered_map<asset*, asset_info> asset_to_info_;
+
+  // assets in files, loaded on first lookup
+  asset_loader loader_;
+  std::unordered_map<guid, std::string> unloaded_;
+  std::unordered_map<std::string, guid> unloaded_paths_;
+
+  // never 0, that's the epoch of references which were never looked up
+  std::atomic<uint32_t> epoch_ = 1;
+
+  uint32_t batch_depth_ = 0;
+  batch_mode batch_mode_ = batch_mode::DEFERRED;
+  std::vector<uint32_t> batch_touched_;
+
+  std::mutex snapshots_mutex_;
+  std::unordered_map<uint32_t, std::weak_ptr<const asset_snapshot>> snapshots_;
+};
+
+// Copy of an asset tree in its own repository. Jobs can read it without locks while the source changes,
+// buffers share loaded memory with the source until they are updated there.
+class asset_snapshot {
+ public:
+  asset_snapshot(asset_repository& src, const asset& root)
+    : root_(&repository_.import_asset(src, root)), version_(root.version())
+  {}
+
+  asset_snapshot(const asset_snapshot&) = delete;
+  asset_snapshot& operator=(const asset_snapshot&) = delete;
+
+  [[nodiscard]] const asset& root() const { return *root_; }
+
+  // Version of the source asset the snapshot was taken at.
+  [[nodiscard]] uint32_t version() const { return version_; }
+
+  [[nodiscard]] guid get_guid() const { return repository_.get_guid(*root_); }
+
+  [[nodiscard]] const asset* get_asset(const guid& id) const { return repository_.get_asset(id); }
+
+  asset_buffer load_buffer(buffer_id id) const { return repository_.load_buffer(id); }
+
+ private:
+  mutable asset_repository repository_;
+  const asset* root_;
+  uint32_t version_;
+};
+
+inline std::shared_ptr<const asset_snapshot> asset_repository::snapshot(asset_id id) {
+  std::shared_lock lock(mutex_);
+  asset* a = objects_[id.idx];
+  assert(a);
+
+  std::lock_guard snapshots_lock(snapshots_mutex_);
+  auto& cached = snapshots_[id.idx];
+  if (auto snapshot = cached.lock()) {
+    // slots are reused, guid tells if it's still the same asset
+    if (snapshot->version() == a->version() && snapshot->get_guid() == asset_to_info_.at(a).id)
+      return snapshot;
+  }
+
+  auto snapshot = std::make_shared<const asset_snapshot>(*this, *a);
+  cached = snapshot;
+  return snapshot;
+}
+
+class asset_batch {
+ public:
+  explicit asset_batch(asset_repository& repository, asset_repository::batch_mode mode = asset_repository::batch_mode::DEFERRED)
+    : repository_(repository) {
+    repository_.begin_batch(mode);
+  }
+
+  ~asset_batch() { repository_.end_batch(); }
+
+  asset_batch(const asset_batch&) = delete;
+  asset_batch& operator=(const asset_batch&) = delete;
+
+ private:
+  asset_repository& repository_;
 };
 
 nlohmann::json asset_to_json(const asset_value& val, asset_repository& rep, std::vector<buffer_id>& buffers);
+
+// Buffers are looked up in the project buffer store, then in buffers_path where older saves kept them.
 asset_value parse_json(nlohmann::json& j, asset_repository& rep, const fs::path& buffers_path);
+
+// Streams JSON text straight into the repository without building nlohmann::json tree.
+// The root has to be an object, it replaces the asset with the same guid. Returns null on parse error or empty object,
+// empty is set for the latter.
+asset* parse_json(const char* first, const char* last, asset_repository& rep, const fs::path& buffers_path, bool* empty = nullptr);
@@ -1,56 +1,298 @@
 #include "assets_filesystem.h"
 #include "asset_repository.h"
+#include "asset_binary.h"
+#include "asset_bundle.h"
+#include "buffer_store.h"
 #include "base/log.h"
 #include "base/json.hpp"
+#include "platform/os.h"
+#include "base/job_system.h"
+#include "base/timer.h"
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
 #include <unordered_set>
 
 static fs::path get_buffers_path(const fs::path& path) {
   return fs::concat(path, ".buffers");
 }
 
-void load_assets(
+namespace {
+
+struct asset_file_data {
+  std::shared_ptr<uint8_t> data;
+  size_t size = 0;
+};
+
+struct staged_assets {
+  asset_repository repository;
+  std::vector<std::pair<asset*, const fs::path*>> assets;
+  asset_load_stats stats;
+};
+
+}
+
+static asset_file_data read_asset_data(const fs::path& fullpath) {
+  asset_file_data file_data;
+  file_data.size = fs::file_size(fullpath);
+  file_data.data = os::map_file(fullpath, 0, file_data.size);
+  if (!file_data.data) {
+    file_data.data = std::shared_ptr<uint8_t>(new uint8_t[file_data.size ? file_data.size : 1], std::default_delete<uint8_t[]>());
+    std::ifstream file = fs::read_file(fullpath, std::ios::in | std::ios::binary);
+    file.read(reinterpret_cast<char*>(file_data.data.get()), (std::streamsize) file_data.size);
+  }
+  return file_data;
+}
+
+static asset* parse_asset_data(asset_repository& repository, const asset_file_data& file_data, const fs::path& fullpath) {
+  asset_batch batch(repository, asset_repository::batch_mode::CONSTRUCT);
+
+  const uint8_t* data = file_data.data.get();
+  if (is_binary_asset(data, file_data.size)) {
+    if (auto* asset = repository.find_loaded_asset(binary_asset_guid(data, file_data.size))) {
+      repository.destroy_asset(asset->id());
+    }
+
+    asset* asset = parse_binary(data, file_data.size, repository, get_buffers_path(fullpath));
+    if (!asset) {
+      logger::core::Error("Couldn't parse binary asset {}", fullpath.c_str());
+    }
+    return asset;
+  }
+
+  auto* text = reinterpret_cast<const char*>(data);
+  bool empty = false;
+  asset* asset = parse_json(text, text + file_data.size, repository, get_buffers_path(fullpath), &empty);
+  // empty documents are skipped silently
+  if (!asset && !empty) {
+    logger::core::Error("Couldn't parse asset {}", fullpath.c_str());
+  }
+  return asset;
+}
+
+static time_span add_time(time_span lhs, time_span rhs) {
+  return time_span::microseconds(lhs.as_microseconds() + rhs.as_microseconds());
+}
+
+static void load_staged_assets(const assets_filesystem& filesystem, staged_assets& staged, const std::vector<fs::path>& paths,
+                               size_t first, size_t last) {
+  std::unordered_map<guid, size_t> loaded;
+  for (size_t i = first; i < last; i++) {
+    asset* asset = filesystem.read(staged.repository, paths[i], &staged.stats);
+    if (!asset)
+      continue;
+
+    // file with the same guid replaced earlier asset in staging repository
+    auto [it, inserted] = loaded.emplace(staged.repository.get_guid(*asset), staged.assets.size());
+    if (!inserted) {
+      logger::core::Warning("Asset {} has the same guid as {}", paths[i].c_str(), staged.assets[it->second].second->c_str());
+      staged.assets[it->second].first = nullptr;
+      it->second = staged.assets.size();
+    }
+    staged.assets.emplace_back(asset, &paths[i]);
+  }
+}
+
+asset_load_stats load_assets(
     const assets_filesystem& filesystem,
     asset_repository& repository,
-    std::initializer_list<fs::path> extensions) {
+    std::initializer_list<fs::path> extensions,
+    job_system* jobs) {
 
+  asset_load_stats stats;
+  timer total_timer;
+
+  timer scan_timer;
+  std::vector<fs::path> paths;
   std::unordered_set<std::string> extensions_set { extensions.begin(), extensions.end() };
-  for (auto it = fs::recursive_directory_iterator(fs::project_path());
-            it != fs::recursive_directory_iterator();
-            it++) {
-    if (it->is_directory())
-      continue;
+  if (const asset_bundle* bundle = filesystem.bundle()) {
+    for (const bundle_entry& entry : bundle->entries()) {
+      if (entry.kind == bundle_entry_kind::ASSET && (extensions_set.empty() || extensions_set.count(entry.type))) {
+        paths.emplace_back(entry.path);
+      }
+    }
+  } else {
+    for (auto it = fs::recursive_directory_iterator(fs::project_path());
+              it != fs::recursive_directory_iterator();
+              it++) {
+      if (it->is_directory())
+        continue;
 
-    if (!extensions_set.empty() && !extensions_set.count(it->path().extension()))
-      continue;
+      if (!extensions_set.empty() && !extensions_set.count(it->path().extension()))
+        continue;
+
+      paths.push_back(fs::relative(it->path(), fs::project_path()));
+    }
+  }
+  // order doesn't depend on directory listing, later path wins guid conflicts
+  std::sort(paths.begin(), paths.end());
+  stats.scan = scan_timer.time();
 
-    fs::path relative = fs::relative(it->path(), fs::project_path());
-    filesystem.load(repository, relative);
+  // every batch parses into its own repository, the main one is touched only by this thread
+  const size_t workers = jobs ? jobs->workers_count() + 1 : 1;
+  const size_t batch_size = std::max<size_t>(1, (paths.size() + workers * 4 - 1) / (workers * 4));
+  std::vector<std::unique_ptr<staged_assets>> batches((paths.size() + batch_size - 1) / batch_size);
+  for (auto& batch : batches) {
+    batch = std::make_unique<staged_assets>();
   }
+
+  auto load_batch = [&](size_t first, size_t last) {
+    load_staged_assets(filesystem, *batches[first / batch_size], paths, first, last);
+  };
+
+  if (jobs) {
+    jobs->parallel_for(paths.size(), batch_size, load_batch);
+  } else if (!paths.empty()) {
+    for (size_t first = 0; first < paths.size(); first += batch_size) {
+      load_batch(first, std::min(first + batch_size, paths.size()));
+    }
+  }
+
+  timer merge_timer;
+  std::unordered_map<guid, const fs::path*> merged;
+  for (auto& batch : batches) {
+    stats.read = add_time(stats.read, batch->stats.read);
+    stats.parse = add_time(stats.parse, batch->stats.parse);
+    stats.bytes += batch->stats.bytes;
+
+    for (auto& [staged_asset, path] : batch->assets) {
+      if (!staged_asset)
+        continue;
+
+      const guid& guid = batch->repository.get_guid(*staged_asset);
+      if (auto* existing = repository.find_loaded_asset(guid)) {
+        if (auto it = merged.find(guid); it != merged.end()) {
+          logger::core::Warning("Asset {} has the same guid as {}", path->c_str(), it->second->c_str());
+        }
+        repository.destroy_asset(existing->id());
+      }
+      if (auto* existing = repository.find_loaded_asset_by_path(*path)) {
+        repository.destroy_asset(existing->id());
+      }
+
+      asset& asset = repository.import_asset(batch->repository, *staged_asset);
+      repository.set_asset_path(asset.id(), *path);
+      repository.mark_saved(asset);
+      merged[guid] = path;
+      stats.files++;
+    }
+
+    // staging memory goes as soon as its assets are copied
+    batch.reset();
+  }
+  stats.merge = merge_timer.time();
+  stats.total = total_timer.time();
+
+  logger::core::Info("Loaded {} assets ({} KB) in {} ms: scan {} ms, read {} ms, parse {} ms, merge {} ms (read and parse are summed over workers)",
+                     stats.files, stats.bytes / 1024, stats.total.as_milliseconds(), stats.scan.as_milliseconds(),
+                     stats.read.as_milliseconds(), stats.parse.as_milliseconds(), stats.merge.as_milliseconds());
+  return stats;
 }
 
-void assets_filesystem::load(asset_repository& repository, const fs::path& path) const {
+asset* read_asset_file(asset_repository& repository, const fs::path& fullpath) {
+  return parse_asset_data(repository, read_asset_data(fullpath), fullpath);
+}
+
+asset* assets_filesystem::read(asset_repository& repository, const fs::path& path, asset_load_stats* stats) const {
+  if (bundle_) {
+    const bundle_entry* entry = bundle_->find(path);
+    if (!entry) {
+      logger::core::Error("Asset {} isn't in bundle {}", path.c_str(), bundle_->path().c_str());
+      return nullptr;
+    }
+
+    // bundle is mapped already, there's nothing to read
+    timer parse_timer;
+    if (auto* existing = repository.find_loaded_asset(entry->id)) {
+      repository.destroy_asset(existing->id());
+    }
+    asset* asset = bundle_->load(repository, path);
+    if (stats) {
+      stats->parse = add_time(stats->parse, parse_timer.time());
+      stats->bytes += entry->size;
+    }
+    return asset;
+  }
+
   fs::path fullpath = fs::to_project_path(path);
-  std::ifstream file = fs::read_file(fullpath, std::ios::in);
-  nlohmann::json j = nlohmann::json::parse(file);
-  if (j.empty())
-    return;
 
-  guid guid = guid::from_string(j.at("__guid"));
-  if (auto* asset = repository.get_asset(guid)) {
-    repository.destroy_asset(asset->id());
+  timer read_timer;
+  asset_file_data file_data = read_asset_data(fullpath);
+  if (stats) {
+    stats->read = add_time(stats->read, read_timer.time());
+    stats->bytes += file_data.size;
+  }
+
+  timer parse_timer;
+  asset* asset = parse_asset_data(repository, file_data, fullpath);
+  if (stats) {
+    stats->parse = add_time(stats->parse, parse_timer.time());
+  }
+  return asset;
+}
+
+void assets_filesystem::load(asset_repository& repository, const fs::path& path) const {
+  if (asset* asset = read(repository, path)) {
+    repository.set_asset_path(asset->id(), path);
+    repository.mark_saved(*asset);
+  }
+}
+
+bool assets_filesystem::open_bundle(asset_repository& repository, const fs::path& fullpath) {
+  auto bundle = std::make_shared<asset_bundle>();
+  if (!bundle->open(fullpath))
+    return false;
+
+  // loader keeps the bundle mapped as long as the repository can ask for its assets
+  repository.set_asset_loader([bundle](asset_repository& staging, const fs::path& path) {
+    return bundle->load(staging, path);
+  });
+
+  for (const bundle_entry& entry : bundle->entries()) {
+    if (entry.kind == bundle_entry_kind::ASSET) {
+      repository.add_unloaded_asset(entry.id, entry.path);
+    }
   }
 
-  asset& asset = parse_json(j, repository, get_buffers_path(fullpath));
-  repository.set_asset_path(asset.id(), path);
+  bundle_ = std::move(bundle);
+  return true;
 }
 
-void save_assets(assets_filesystem& filesystem, asset_repository& repository, bool remap_buffers) {
-  for (auto& [asset, info] : repository) {
-    filesystem.save(repository, info.path, remap_buffers);
+asset_format assets_filesystem::format(const fs::path& path) const {
+  auto it = formats_.find(path.extension());
+  return it != formats_.end() ? it->second : default_format_;
+}
+
+size_t save_assets(assets_filesystem& filesystem, asset_repository& repository, bool remap_buffers, job_system* jobs) {
+  timer timer;
+
+  // sub-assets have no path, they are saved with their roots
+  std::vector<fs::path> paths;
+  repository.read([&]() {
+    for (auto& [asset, info] : repository) {
+      if (!info.path.empty() && repository.is_dirty(*asset)) {
+        paths.push_back(info.path);
+      }
+    }
+  });
+
+  // roots are independent files, each of them is serialized under its own shared lock
+  auto save_range = [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      filesystem.save(repository, paths[i], remap_buffers);
+    }
+  };
+
+  if (jobs) {
+    jobs->parallel_for(paths.size(), 1, save_range);
+  } else {
+    save_range(0, paths.size());
   }
+
+  logger::core::Info("Saved {} modified assets in {} ms", paths.size(), timer.time().as_milliseconds());
+  return paths.size();
 }
 
 void assets_filesystem::save(asset_repository& repository, const fs::path& path, bool remap_buffers) {
@@ -62,42 +304,66 @@ void assets_filesystem::save(asset_repository& repository, const fs::path& path,
 }
 
 void assets_filesystem::save(asset_repository& repository, asset& asset, const fs::path& path, bool remap_buffers) {
+  if (bundle_) {
+    logger::core::Error("Asset save failed: {} is served from read-only bundle {}", path.c_str(), bundle_->path().c_str());
+    return;
+  }
+
   fs::path fullpath = fs::to_project_path(path);
   fs::path buffers_directory = get_buffers_path(fullpath);
 
+  // state is taken together with the contents, changes made during the write keep the asset dirty
+  asset_save_state state;
   std::vector<buffer_id> buffers;
-  nlohmann::json j = asset_to_json(asset, repository, buffers);
-
-  std::ofstream file(fullpath, std::ios::trunc);
-  file << j.dump(2);
-
-  fs::assure(buffers_directory);
+  std::vector<uint8_t> data;
+  std::string text;
+  repository.read([&]() {
+    state = repository.save_state(asset);
+    if (format(path) == asset_format::BINARY) {
+      data = asset_to_binary(asset, repository, buffers);
+    } else {
+      text = asset_to_json(asset, repository, buffers).dump(2);
+    }
+  });
 
-  std::unordered_set<std::string> buffer_paths;
-  for (buffer_id& buf_id : buffers) {
-    fs::path buf_path = fs::append(buffers_directory, std::to_string(repository.buffer_hash(buf_id)));
-    buffer_paths.insert(buf_path);
+  std::vector<uint64_t> hashes;
+  hashes.reserve(buffers.size());
+  for (buffer_id buf_id : buffers) {
+    hashes.push_back(repository.buffer_hash(buf_id));
+  }
+  buffer_store_.set_references(path, hashes);
 
-    if (!fs::exists(buf_path)) {
-      repository.write_buffer_to_file(buf_id, buf_path, 0);
+  for (size_t i = 0; i < buffers.size(); i++) {
+    fs::path buf_path = find_stored_buffer(hashes[i]);
+    if (buf_path.empty()) {
+      std::error_code error;
+      buf_path = stored_buffer_path(hashes[i]);
+      fs::create_directories(buf_path.parent_path(), error);
+      buf_path = repository.write_buffer_to_file(buffers[i], buf_path, 0, buffer_compression_);
+      if (!fs::exists(buf_path)) {
+        logger::core::Error("Asset save failed: couldn't write buffer {}", buf_path.c_str());
+        return;
+      }
       logger::core::Info("Saved buffer at path {}", buf_path.c_str());
     }
 
     if (remap_buffers) {
-      repository.map_buffer_to_file(buf_id, buf_path, 0);
+      repository.map_buffer_to_file(buffers[i], buf_path, 0);
     }
   }
 
-  std::vector<fs::path> paths_to_remove;
-  auto dir_listing = fs::directory_iterator(buffers_directory);
-  std::remove_copy_if(fs::begin(dir_listing), fs::end(dir_listing), std::back_inserter(paths_to_remove),
-          [&](const fs::path& p) {
-              return buffer_paths.count(p);
-          });
+  // asset file goes last, it never refers to buffers which aren't stored yet
+  bool written = text.empty() ? fs::write_file(fullpath, data.data(), data.size()) : fs::write_file(fullpath, text.data(), text.size());
+  if (!written) {
+    logger::core::Error("Asset save failed: couldn't write file {}", fullpath.c_str());
+    return;
+  }
 
-  for (auto& p : paths_to_remove) {
-    fs::remove(p);
+  // buffers saved before the project store existed, nothing refers to them once remapped
+  if (remap_buffers && fs::exists(buffers_directory)) {
+    fs::remove_all(buffers_directory);
   }
 
+  repository.mark_saved(asset, state);
   logger::core::Info("Asset saved at path {}", path.c_str());
 }
@@ -1,20 +1,81 @@
 #pragma once
 
 #include "platform/file_system.h"
+#include "base/timer.h"
+#include "core/buffer_compression.h"
+#include "core/buffer_store.h"
+
+#include <memory>
+#include <unordered_map>
 
 class asset_repository;
 class asset;
+class asset_bundle;
+class job_system;
+struct asset_load_stats;
+
+enum class asset_format {
+  JSON,
+  BINARY
+};
 
 class assets_filesystem {
  public:
-  assets_filesystem() noexcept = default;
+  assets_filesystem() = default;
 
+  // Writes the asset even if it isn't modified, save_assets skips those.
   void save(asset_repository&, const fs::path&, bool remap_buffers);
   void load(asset_repository&, const fs::path&) const;
 
+  // Parses the asset at the path into the repository without registering the path, from the bundle in runtime
+  // mode. Asset with the same guid is replaced. Read and parse times and bytes read are added to stats.
+  asset* read(asset_repository&, const fs::path&, asset_load_stats* stats = nullptr) const;
+
+  // Format used on save, loading detects it from file contents.
+  void set_default_format(asset_format format) { default_format_ = format; }
+  void set_format(const fs::path& extension, asset_format format) { formats_[extension] = format; }
+  [[nodiscard]] asset_format format(const fs::path& path) const;
+
+  // Applied to buffers written on save, buffers already on disk are kept as they are.
+  void set_buffer_compression(buffer_compression compression) { buffer_compression_ = compression; }
+
+  // Runtime mode, assets and their buffers are served from the packed bundle instead of project files.
+  // Bundled assets are registered in the repository and loaded on first lookup, nothing can be saved.
+  bool open_bundle(asset_repository&, const fs::path& fullpath);
+  [[nodiscard]] const asset_bundle* bundle() const { return bundle_.get(); }
+
+  // Removes buffers no saved asset refers to on jobs.
+  void collect_garbage(job_system* jobs = nullptr) { buffer_store_.collect_garbage(jobs); }
+  [[nodiscard]] buffer_store& buffers() { return buffer_store_; }
+
  private:
   void save(asset_repository&, asset&, const fs::path&, bool remap_buffers);
+
+ private:
+  asset_format default_format_ = asset_format::JSON;
+  buffer_compression buffer_compression_ = buffer_compression::NONE;
+  buffer_store buffer_store_;
+  std::shared_ptr<const asset_bundle> bundle_;
+  std::unordered_map<std::string, asset_format> formats_;
 };
 
-void load_assets(const assets_filesystem&, asset_repository&, std::initializer_list<fs::path> extensions = {});
-void save_assets(assets_filesystem&, asset_repository&, bool remap_buffers);
\ No newline at end of file
+// Reads JSON or binary asset file, asset with the same guid is replaced. Returns null if the file can't be parsed.
+asset* read_asset_file(asset_repository&, const fs::path& fullpath);
+
+struct asset_load_stats {
+  size_t files = 0;
+  size_t bytes = 0;
+  time_span scan;
+  time_span read;
+  time_span parse;
+  time_span merge;
+  time_span total;
+};
+
+// Files are parsed on jobs into staging repositories and merged on the calling thread. In runtime mode all
+// bundled assets are loaded instead of project files.
+asset_load_stats load_assets(const assets_filesystem&, asset_repository&, std::initializer_list<fs::path> extensions = {}, job_system* jobs = nullptr);
+
+// Saves assets with a path changed since they were loaded or saved, on jobs. Files are replaced atomically.
+// Returns count of saved assets.
+size_t save_assets(assets_filesystem&, asset_repository&, bool remap_buffers, job_system* jobs = nullptr);
@@ -0,0 +1,239 @@
+#include "buffer_compression.h"
+
+#include "base/compression.h"
+#include "base/job_system.h"
+#include "platform/os.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+constexpr uint8_t magic[4] = { 'U', 'B', 'K', 'Z' };
+constexpr uint8_t format_version = 1;
+constexpr size_t header_size = 24;
+constexpr uint32_t stored_flag = 0x80000000U;
+
+struct compressed_header {
+  uint64_t raw_size = 0;
+  uint32_t chunk_size = 0;
+  uint32_t chunks = 0;
+};
+
+// chunk offsets from the start of the file and their table entries
+struct compressed_layout {
+  compressed_header header;
+  std::vector<uint32_t> table;
+  std::vector<uint64_t> offsets;
+};
+
+bool parse_header(const uint8_t* data, compressed_header& header) {
+  if (std::memcmp(data, magic, sizeof(magic)) != 0 || data[4] != format_version)
+    return false;
+
+  std::memcpy(&header.raw_size, data + 8, sizeof(header.raw_size));
+  std::memcpy(&header.chunk_size, data + 16, sizeof(header.chunk_size));
+  std::memcpy(&header.chunks, data + 20, sizeof(header.chunks));
+
+  if (!header.chunk_size || (header.chunk_size & stored_flag))
+    return false;
+
+  return header.chunks == (header.raw_size + header.chunk_size - 1) / header.chunk_size;
+}
+
+size_t chunk_raw_size(const compressed_header& header, size_t chunk) {
+  return std::min<uint64_t>(header.chunk_size, header.raw_size - (uint64_t) chunk * header.chunk_size);
+}
+
+bool parse_table(const uint8_t* data, uint64_t file_size, compressed_layout& layout) {
+  const auto& header = layout.header;
+  layout.table.resize(header.chunks);
+  layout.offsets.resize(header.chunks);
+  std::memcpy(layout.table.data(), data, header.chunks * sizeof(uint32_t));
+
+  uint64_t offset = header_size + (uint64_t) header.chunks * sizeof(uint32_t);
+  for (size_t i = 0; i < header.chunks; i++) {
+    uint32_t entry = layout.table[i];
+    uint32_t size = entry & ~stored_flag;
+    size_t raw_size = chunk_raw_size(header, i);
+    if ((entry & stored_flag) ? size != raw_size : size > utils::lz_compress_bound(raw_size))
+      return false;
+
+    layout.offsets[i] = offset;
+    offset += size;
+  }
+  return offset == file_size;
+}
+
+bool decode_chunk(const uint8_t* src, uint32_t entry, uint8_t* dst, size_t raw_size) {
+  if (entry & stored_flag) {
+    std::memcpy(dst, src, raw_size);
+    return true;
+  }
+  return utils::lz_decompress(src, entry, dst, raw_size);
+}
+
+void write32(uint8_t* p, uint32_t v) { std::memcpy(p, &v, sizeof(v)); }
+void write64(uint8_t* p, uint64_t v) { std::memcpy(p, &v, sizeof(v)); }
+
+}
+
+bool is_compressed_buffer_file(const fs::path& path) {
+  return path.extension() == compressed_buffer_extension;
+}
+
+bool compressed_buffer_size(const fs::path& path, size_t& raw_size) {
+  // files shorter than the header are raw, they aren't opened at all
+  std::error_code error;
+  uint64_t file_size = fs::file_size(path, error);
+  if (error || file_size < header_size)
+    return false;
+
+  // plain stream, fs::read_file would throw on a short read instead of returning false
+  uint8_t data[header_size];
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file.read(reinterpret_cast<char*>(data), header_size))
+    return false;
+
+  compressed_header header;
+  if (!parse_header(data, header))
+    return false;
+
+  raw_size = header.raw_size;
+  return true;
+}
+
+std::vector<uint8_t> compress_buffer(const uint8_t* data, size_t size, job_system* jobs) {
+  if (!size)
+    return {};
+
+  const size_t chunks = (size + compressed_buffer_chunk_size - 1) / compressed_buffer_chunk_size;
+  std::vector<std::vector<uint8_t>> compressed(chunks);
+  std::vector<uint32_t> table(chunks);
+
+  auto compress_range = [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      const uint8_t* src = data + i * compressed_buffer_chunk_size;
+      size_t raw_size = std::min<size_t>(compressed_buffer_chunk_size, size - i * compressed_buffer_chunk_size);
+
+      auto& out = compressed[i];
+      out.resize(raw_size);
+      size_t compressed_size = utils::lz_compress(src, raw_size, out.data(), out.size());
+      if (!compressed_size || compressed_size >= raw_size) {
+        std::memcpy(out.data(), src, raw_size);
+        table[i] = (uint32_t) raw_size | stored_flag;
+      } else {
+        out.resize(compressed_size);
+        table[i] = (uint32_t) compressed_size;
+      }
+    }
+  };
+
+  if (jobs) {
+    jobs->parallel_for(chunks, 1, compress_range);
+  } else {
+    compress_range(0, chunks);
+  }
+
+  size_t total = header_size + chunks * sizeof(uint32_t);
+  for (const auto& chunk : compressed) {
+    total += chunk.size();
+  }
+
+  if (total > size - size / 8)
+    return {};
+
+  std::vector<uint8_t> result(total);
+  uint8_t* p = result.data();
+  std::memcpy(p, magic, sizeof(magic));
+  p[4] = format_version;
+  write64(p + 8, size);
+  write32(p + 16, compressed_buffer_chunk_size);
+  write32(p + 20, (uint32_t) chunks);
+  p += header_size;
+
+  std::memcpy(p, table.data(), chunks * sizeof(uint32_t));
+  p += chunks * sizeof(uint32_t);
+
+  for (const auto& chunk : compressed) {
+    std::memcpy(p, chunk.data(), chunk.size());
+    p += chunk.size();
+  }
+  return result;
+}
+
+bool decompress_buffer(const fs::path& path, uint8_t* dst, size_t size, job_system* jobs) {
+  std::error_code error;
+  uint64_t file_size = fs::file_size(path, error);
+  if (error || file_size < header_size)
+    return false;
+
+  compressed_layout layout;
+
+  // large buffers are decompressed from the mapping on jobs, the rest is streamed through one chunk of memory
+  if (jobs && size > compressed_buffer_chunk_size) {
+    if (auto mapping = os::map_file(path, 0, file_size)) {
+      const uint8_t* data = mapping.get();
+      if (!parse_header(data, layout.header) || layout.header.raw_size != size)
+        return false;
+
+      if (file_size < header_size + (uint64_t) layout.header.chunks * sizeof(uint32_t) ||
+          !parse_table(data + header_size, file_size, layout))
+        return false;
+
+      std::atomic<bool> ok { true };
+      jobs->parallel_for(layout.header.chunks, 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+          uint8_t* chunk_dst = dst + i * layout.header.chunk_size;
+          if (!decode_chunk(data + layout.offsets[i], layout.table[i], chunk_dst, chunk_raw_size(layout.header, i))) {
+            ok = false;
+          }
+        }
+      });
+      return ok;
+    }
+  }
+
+  // plain stream, fs::read_file would throw on a short read instead of returning false
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  uint8_t header_data[header_size];
+  if (!file.read(reinterpret_cast<char*>(header_data), header_size))
+    return false;
+
+  if (!parse_header(header_data, layout.header) || layout.header.raw_size != size)
+    return false;
+
+  const size_t table_size = layout.header.chunks * sizeof(uint32_t);
+  if (file_size < header_size + table_size)
+    return false;
+
+  std::vector<uint8_t> scratch(table_size);
+  if (!file.read(reinterpret_cast<char*>(scratch.data()), (std::streamsize) table_size) ||
+      !parse_table(scratch.data(), file_size, layout))
+    return false;
+
+  for (size_t i = 0; i < layout.header.chunks; i++) {
+    uint32_t chunk_size = layout.table[i] & ~stored_flag;
+    scratch.resize(chunk_size);
+    if (!file.read(reinterpret_cast<char*>(scratch.data()), chunk_size))
+      return false;
+
+    uint8_t* chunk_dst = dst + i * layout.header.chunk_size;
+    if (!decode_chunk(scratch.data(), layout.table[i], chunk_dst, chunk_raw_size(layout.header, i)))
+      return false;
+  }
+  return true;
+}
+
+fs::path find_buffer_file(const fs::path& raw_path) {
+  if (fs::exists(raw_path))
+    return raw_path;
+
+  fs::path compressed_path = fs::concat(raw_path, compressed_buffer_extension);
+  if (fs::exists(compressed_path))
+    return compressed_path;
+
+  return {};
+}
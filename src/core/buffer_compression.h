@@ -0,0 +1,36 @@
+#pragma once
+
+#include "platform/file_system.h"
+
+#include <cstdint>
+#include <vector>
+
+class job_system;
+
+enum class buffer_compression {
+  NONE,
+  // utils::lz_compress in independent chunks, file gets compressed_buffer_extension
+  BLOCK
+};
+
+// Compressed buffer file:
+//   header  "UBKZ", version byte, 3 reserved bytes, raw size (u64), chunk size (u32), chunks count (u32)
+//   table   compressed size of every chunk (u32), high bit is set if the chunk is stored uncompressed
+//   chunks
+// Chunks are decompressed independently, so large buffers are streamed chunk by chunk or decompressed on jobs.
+constexpr const char* compressed_buffer_extension = ".lz";
+constexpr uint32_t compressed_buffer_chunk_size = 256 * 1024;
+
+[[nodiscard]] bool is_compressed_buffer_file(const fs::path& path);
+
+// Returns false if the file isn't a valid compressed buffer.
+bool compressed_buffer_size(const fs::path& path, size_t& raw_size);
+
+// Returns empty vector if compression saves less than an eighth of data, raw file is better then since it can be mapped.
+std::vector<uint8_t> compress_buffer(const uint8_t* data, size_t size, job_system* jobs = nullptr);
+
+// Returns false if the file is malformed or doesn't hold exactly size bytes.
+bool decompress_buffer(const fs::path& path, uint8_t* dst, size_t size, job_system* jobs = nullptr);
+
+// Path of the raw or compressed file holding buffer named by raw_path, empty if there is none.
+fs::path find_buffer_file(const fs::path& raw_path);
@@ -0,0 +1,223 @@
+#include "buffer_store.h"
+
+#include "buffer_compression.h"
+#include "base/job_system.h"
+#include "base/json.hpp"
+#include "base/log.h"
+
+#include <algorithm>
+#include <fstream>
+
+static constexpr uint32_t index_version = 1;
+static constexpr size_t hash_digits = 16;
+
+static fs::path index_path() {
+  return fs::append(buffer_store_path(), "index.json");
+}
+
+static std::string hash_to_hex(uint64_t hash) {
+  constexpr char digits[] = "0123456789abcdef";
+  std::string hex(hash_digits, '0');
+  for (size_t i = 0; i < hash_digits; i++) {
+    hex[hash_digits - 1 - i] = digits[(hash >> (i * 4)) & 0xF];
+  }
+  return hex;
+}
+
+static bool hex_to_hash(std::string_view hex, uint64_t& hash) {
+  if (hex.size() != hash_digits)
+    return false;
+
+  hash = 0;
+  for (char c : hex) {
+    uint64_t digit;
+    if (c >= '0' && c <= '9') digit = c - '0';
+    else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+    else return false;
+    hash = (hash << 4) | digit;
+  }
+  return true;
+}
+
+fs::path buffer_store_path() {
+  return fs::to_project_path(".ubik/buffers");
+}
+
+fs::path stored_buffer_path(uint64_t hash) {
+  std::string name = hash_to_hex(hash);
+  return fs::append(fs::append(buffer_store_path(), name.substr(0, 2).c_str()), name.c_str());
+}
+
+fs::path find_stored_buffer(uint64_t hash, const fs::path& legacy_directory) {
+  if (fs::path path = find_buffer_file(stored_buffer_path(hash)); !path.empty())
+    return path;
+
+  if (!legacy_directory.empty())
+    return find_buffer_file(fs::append(legacy_directory, std::to_string(hash).c_str()));
+
+  return {};
+}
+
+buffer_store::~buffer_store() {
+  if (garbage_collection_.valid()) {
+    garbage_collection_.wait();
+  }
+}
+
+void buffer_store::load_index() {
+  if (loaded_)
+    return;
+  loaded_ = true;
+
+  fs::path path = index_path();
+  if (!fs::exists(path)) {
+    // files of a store whose index was lost can't be told apart from garbage
+    std::error_code error;
+    trusted_ = !fs::exists(buffer_store_path()) || fs::is_empty(buffer_store_path(), error);
+    if (!trusted_) {
+      logger::core::Warning("Buffer store {} has no index, its files won't be collected", buffer_store_path().c_str());
+    }
+    return;
+  }
+
+  std::ifstream file = fs::read_file(path, std::ios::in);
+  nlohmann::json j = nlohmann::json::parse(file, nullptr, false);
+  auto assets = j.is_object() && j.value("version", 0u) == index_version ? j.find("assets") : j.end();
+  if (j.is_discarded() || assets == j.end() || !assets->is_object()) {
+    logger::core::Warning("Couldn't read buffer store index {}, its files won't be collected", path.c_str());
+    trusted_ = false;
+    return;
+  }
+
+  for (auto& [asset_path, hashes_json] : assets->items()) {
+    auto& hashes = assets_[asset_path];
+    for (auto& hash_json : hashes_json) {
+      uint64_t hash;
+      if (hash_json.is_string() && hex_to_hash(hash_json.get_ref<const std::string&>(), hash)) {
+        hashes.push_back(hash);
+        references_[hash]++;
+      }
+    }
+  }
+}
+
+void buffer_store::save_index() const {
+  nlohmann::json assets = nlohmann::json::object();
+  for (const auto& [asset_path, hashes] : assets_) {
+    nlohmann::json hashes_json = nlohmann::json::array();
+    for (uint64_t hash : hashes) {
+      hashes_json.push_back(hash_to_hex(hash));
+    }
+    assets[asset_path] = std::move(hashes_json);
+  }
+
+  std::error_code error;
+  fs::create_directories(buffer_store_path(), error);
+  std::string text = nlohmann::json { { "version", index_version }, { "assets", std::move(assets) } }.dump(1);
+  fs::write_file(index_path(), text.data(), text.size());
+}
+
+void buffer_store::set_references(const fs::path& asset_path, std::vector<uint64_t> hashes) {
+  std::sort(hashes.begin(), hashes.end());
+  hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+  std::lock_guard lock(mutex_);
+  load_index();
+
+  auto& current = assets_[asset_path.generic_string()];
+  if (current == hashes)
+    return;
+
+  for (uint64_t hash : hashes) {
+    references_[hash]++;
+  }
+
+  for (uint64_t hash : current) {
+    if (auto it = references_.find(hash); it != references_.end() && !--it->second) {
+      references_.erase(it);
+    }
+  }
+
+  current = std::move(hashes);
+  save_index();
+}
+
+void buffer_store::remove_references(const fs::path& asset_path) {
+  set_references(asset_path, {});
+
+  std::lock_guard lock(mutex_);
+  assets_.erase(asset_path.generic_string());
+  save_index();
+}
+
+uint32_t buffer_store::references(uint64_t hash) {
+  std::lock_guard lock(mutex_);
+  load_index();
+
+  auto it = references_.find(hash);
+  return it != references_.end() ? it->second : 0;
+}
+
+void buffer_store::collect_garbage(job_system* jobs) {
+  if (garbage_collection_.valid()) {
+    garbage_collection_.wait();
+  }
+
+  if (jobs) {
+    garbage_collection_ = jobs->submit([this]() { return remove_garbage(); });
+  } else {
+    std::promise<size_t> removed;
+    removed.set_value(remove_garbage());
+    garbage_collection_ = removed.get_future();
+  }
+}
+
+size_t buffer_store::wait_garbage_collection() {
+  return garbage_collection_.valid() ? garbage_collection_.get() : 0;
+}
+
+size_t buffer_store::remove_garbage() {
+  {
+    std::lock_guard lock(mutex_);
+    load_index();
+    if (!trusted_)
+      return 0;
+  }
+
+  std::error_code error;
+  std::vector<fs::path> files;
+  for (const auto& shard : fs::directory_iterator(buffer_store_path(), error)) {
+    if (!shard.is_directory())
+      continue;
+
+    for (const auto& file : fs::directory_iterator(shard.path(), error)) {
+      files.push_back(file.path());
+    }
+  }
+
+  size_t removed = 0;
+  for (const fs::path& file : files) {
+    fs::path name = file.filename();
+    if (is_compressed_buffer_file(name)) {
+      name.replace_extension();
+    }
+
+    uint64_t hash;
+    if (!hex_to_hash(name.string(), hash))
+      continue;
+
+    // checked under the lock, saves reference their buffers before looking for the files
+    std::lock_guard lock(mutex_);
+    if (references_.count(hash))
+      continue;
+
+    if (fs::remove(file, error)) {
+      removed++;
+    }
+  }
+
+  if (removed) {
+    logger::core::Info("Removed {} unreferenced buffers from {}", removed, buffer_store_path().c_str());
+  }
+  return removed;
+}
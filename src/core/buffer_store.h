@@ -0,0 +1,72 @@
+#pragma once
+
+#include "platform/file_system.h"
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class job_system;
+
+// Project-wide content addressed buffer files, .ubik/buffers/<first two hex digits of hash>/<hash in hex>[.lz].
+// Identical buffers of different assets share one file.
+fs::path buffer_store_path();
+fs::path stored_buffer_path(uint64_t hash);
+
+// File holding buffer with the hash, raw or compressed. Buffers saved before the store existed are looked up in
+// the legacy per-asset directory. Returns empty path if there is none.
+fs::path find_stored_buffer(uint64_t hash, const fs::path& legacy_directory = {});
+
+// Where parsers find buffer contents, a whole file or a range of a packed bundle. Memory is set if the range
+// is mapped already, the buffer then shares it. Empty path if there's no such buffer.
+struct buffer_location {
+  fs::path path;
+  size_t offset = 0;
+  size_t size = 0;
+  std::shared_ptr<uint8_t> memory;
+};
+
+using buffer_locator = std::function<buffer_location(uint64_t hash)>;
+
+// Reference counts of stored buffers, an asset file references every buffer it was saved with once.
+// Counts are persisted in .ubik/buffers/index.json, files nobody references are removed by collect_garbage.
+class buffer_store {
+ public:
+  buffer_store() = default;
+  ~buffer_store();
+
+  buffer_store(const buffer_store&) = delete;
+  buffer_store& operator=(const buffer_store&) = delete;
+
+  // Replaces buffers referenced by the asset file. Has to be called before the files are looked up or written,
+  // garbage collection running meanwhile keeps referenced files.
+  void set_references(const fs::path& asset_path, std::vector<uint64_t> hashes);
+  void remove_references(const fs::path& asset_path);
+
+  [[nodiscard]] uint32_t references(uint64_t hash);
+
+  // Removes unreferenced files of the store on jobs, previous collection is finished first.
+  // Does nothing if the store has files but no index, references of those files are unknown.
+  void collect_garbage(job_system* jobs = nullptr);
+
+  // Blocks until background collection finishes, returns count of removed files.
+  size_t wait_garbage_collection();
+
+ private:
+  void load_index();
+  void save_index() const;
+  size_t remove_garbage();
+
+ private:
+  std::mutex mutex_;
+  bool loaded_ = false;
+  bool trusted_ = true;
+  std::unordered_map<std::string, std::vector<uint64_t>> assets_;
+  std::unordered_map<uint64_t, uint32_t> references_;
+  std::future<size_t> garbage_collection_;
+};
@@ -2,10 +2,17 @@
 
 #include "core/meta/interface.h"
 
+#include <vector>
+
 class load_component_interface : public interface<void(const class asset&, struct world&, struct entity&)> {
   using interface::interface;
 };
 
+// Collects buffers the component reads on load, they are requested before entities are instantiated.
+class prefetch_component_interface : public interface<void(const class asset&, std::vector<struct buffer_id>&)> {
+  using interface::interface;
+};
+
 class instantiate_component_interface : public interface<void(struct world&, struct entity&)> {
   using interface::interface;
 };
\ No newline at end of file
@@ -8,17 +8,17 @@
 
 void load_camera_component(const asset& asset, world& world, entity& e) {
   auto& comp = world.get<camera_component>(e.id);
-  comp.fov = asset.at("fov");
-  comp.near = asset.at("near");
-  comp.far = asset.at("far");
-  comp.orthogonal_size = asset.at("orthogonal_size");
+  comp.fov = asset.at(symbols::fov);
+  comp.near = asset.at(symbols::near_);
+  comp.far = asset.at(symbols::far_);
+  comp.orthogonal_size = asset.at(symbols::orthogonal_size);
 
-  const ::asset& rect = asset.at("normalized_rect");
+  const ::asset& rect = asset.at(symbols::normalized_rect);
 
-  comp.normalized_rect.x = rect.at("x");
-  comp.normalized_rect.y = rect.at("y");
-  comp.normalized_rect.z = rect.at("z");
-  comp.normalized_rect.w = rect.at("w");
+  comp.normalized_rect.x = rect.at(symbols::x);
+  comp.normalized_rect.y = rect.at(symbols::y);
+  comp.normalized_rect.z = rect.at(symbols::z);
+  comp.normalized_rect.w = rect.at(symbols::w);
 
   comp.clear_color = color::black();
 }
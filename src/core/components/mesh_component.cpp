@@ -3,6 +3,7 @@
 
 #include "core/renderer.h"
 #include "core/render_pipeline.h"
+#include "core/occlusion.h"
 #include "core/texture.h"
 #include "gfx/command_buffers.h"
 #include "gfx/shader_repository.h"
@@ -23,25 +24,22 @@ void load_mesh_component(const asset& component_asset, world& world, entity& e)
   auto cmd_buf = renderer->create_resource_command_buffer();
 
   auto& comp = world.get<mesh_component>(e.id);
-  guid mesh_guid = guid::from_string(component_asset.at("mesh"));
-
-  asset* mesh_asset = rep->get_asset(mesh_guid);
-  auto &attributes = mesh_asset->at("attributes").get<asset_array &>();
-  auto *indices_buffer = rep->get_asset(guid::from_string(mesh_asset->at("indices")));
+  asset* mesh_asset = rep->resolve(component_asset.at(symbols::mesh));
+  auto &attributes = mesh_asset->at(symbols::attributes).get<asset_array &>();
 
   uint32_t vertex_buffer_size = 0;
   uint32_t stride = 0;
   vertex_layout_desc vertex_layout = {};
   for (const asset &attr : attributes) {
-    vertex_semantic::type semantic = (vertex_semantic::type) (uint32_t) attr.at("semantic");
-    asset *accessor = rep->get_asset(guid::from_string(attr.at("accessor")));
+    vertex_semantic::type semantic = (vertex_semantic::type) (uint32_t) attr.at(symbols::semantic);
+    asset *accessor = rep->resolve(attr.at(symbols::accessor));
 
     vertex_type::type type = vertex_type::COUNT;
-    uint32_t size = accessor->at("size");
-    uint32_t count = accessor->at("count");
-    uint32_t components = accessor->at("components");
-    bool unsigned_ = accessor->contains("unsigned") && accessor->at("unsigned");
-    bool is_float = accessor->contains("float") && accessor->at("float");
+    uint32_t size = accessor->at(symbols::size);
+    uint32_t count = accessor->at(symbols::count);
+    uint32_t components = accessor->at(symbols::components);
+    bool unsigned_ = accessor->contains(symbols::unsigned_) && accessor->at(symbols::unsigned_);
+    bool is_float = accessor->contains(symbols::float_) && accessor->at(symbols::float_);
     if (is_float && size == 4) {
       type = vertex_type::FLOAT;
     } else if (!is_float) {
@@ -67,17 +65,26 @@ void load_mesh_component(const asset& component_asset, world& world, entity& e)
     vertex_layout.add(semantic, type, components, semantic == vertex_semantic::NORMAL);
   }
 
-  uint8_t vertex_buffer[vertex_buffer_size];
+  // attributes are interleaved straight from the mapped buffers into vertex buffer memory
+  memory vertex_mem;
+  comp.vb = cmd_buf->create_vertex_buffer(
+      vertex_layout,
+      vertex_buffer_size,
+      vertex_mem
+  );
+  uint8_t* vertex_buffer = vertex_mem.data;
+
   size_t attribute_offset = 0;
+  std::vector<vec3> positions;
   for (const asset &attr : attributes) {
     size_t vertex_buffer_offset = 0;
-    asset *accessor = rep->get_asset(guid::from_string(attr.at("accessor")));
-    asset* buffer_asset = rep->get_asset(guid::from_string(accessor->at("buffer")));
-    asset_buffer buf = rep->load_buffer(buffer_asset->at("data"));
-    uint32_t size = accessor->at("size");
-    uint32_t count = accessor->at("count");
-    uint32_t components = accessor->at("components");
-    size_t offset = accessor->contains("offset") ? (size_t) accessor->at("offset") : 0;
+    asset *accessor = rep->resolve(attr.at(symbols::accessor));
+    asset* buffer_asset = rep->resolve(accessor->at(symbols::buffer));
+    asset_buffer buf = rep->load_buffer(buffer_asset->at(symbols::data));
+    uint32_t size = accessor->at(symbols::size);
+    uint32_t count = accessor->at(symbols::count);
+    uint32_t components = accessor->at(symbols::components);
+    size_t offset = accessor->contains(symbols::offset) ? (size_t) accessor->at(symbols::offset) : 0;
 
     for (size_t i = 0; i < count; ++i) {
       std::memcpy(vertex_buffer + vertex_buffer_offset + attribute_offset,
@@ -86,29 +93,66 @@ void load_mesh_component(const asset& component_asset, world& world, entity& e)
       vertex_buffer_offset += stride;
     }
 
+    vertex_semantic::type semantic = (vertex_semantic::type) (uint32_t) attr.at(symbols::semantic);
+    if (semantic == vertex_semantic::POSITION && size == sizeof(float) && components >= 3 && count > 0) {
+      const float* data = reinterpret_cast<const float*>(buf.data() + offset);
+      positions.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+        const float* p = data + i * components;
+        positions[i] = { p[0], p[1], p[2] };
+      }
+
+      vec3 min = positions[0];
+      vec3 max = min;
+      for (const vec3& p : positions) {
+        min = { std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z) };
+        max = { std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z) };
+      }
+      comp.bounds = { min, max };
+      comp.bounds_valid = true;
+    }
+
     attribute_offset += size * components;
   }
 
-  memory vertex_mem;
-  comp.vb = cmd_buf->create_vertex_buffer(
-      vertex_layout,
-      vertex_buffer_size,
-      vertex_mem
-  );
-  std::memcpy(vertex_mem.data, vertex_buffer, vertex_buffer_size);
-
-  asset *indices_accessor = rep->get_asset(guid::from_string(mesh_asset->at("indices")));
-  asset* buffer_asset = rep->get_asset(guid::from_string(indices_accessor->at("buffer")));
-  asset_buffer indices_buf = rep->load_buffer(buffer_asset->at("data"));
-  uint32_t indices_size = indices_accessor->at("size");
-  uint32_t indices_count = indices_accessor->at("count");
-  uint32_t indices_components = indices_accessor->at("components");
-  size_t indices_offset = indices_accessor->contains("offset") ? (size_t) indices_accessor->at("offset") : 0;
+  asset *indices_accessor = rep->resolve(mesh_asset->at(symbols::indices));
+  asset* buffer_asset = rep->resolve(indices_accessor->at(symbols::buffer));
+  asset_buffer indices_buf = rep->load_buffer(buffer_asset->at(symbols::data));
+  uint32_t indices_size = indices_accessor->at(symbols::size);
+  uint32_t indices_count = indices_accessor->at(symbols::count);
+  uint32_t indices_components = indices_accessor->at(symbols::components);
+  size_t indices_offset = indices_accessor->contains(symbols::offset) ? (size_t) indices_accessor->at(symbols::offset) : 0;
 
   memory index_mem;
   comp.ib = cmd_buf->create_index_buffer(indices_count * indices_size * indices_components, index_mem);
   std::memcpy(index_mem.data, indices_buf.data() + indices_offset, index_mem.size);
 
+  // hosts without render pipeline have no occlusion culling, defaults still decide which meshes keep occluders
+  const render_pipeline* pipeline = reg->find<render_pipeline>();
+  const occlusion_settings occlusion = pipeline ? pipeline->occlusion() : occlusion_settings {};
+  vec3 extents = comp.bounds.max - comp.bounds.min;
+  bool large = std::sqrt(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z) >= occlusion.auto_occluder_size;
+  bool occluder = component_asset.contains(symbols::occluder)
+      ? (bool) component_asset.at(symbols::occluder)
+      : large && indices_count / 3 <= occlusion.max_occluder_triangles;
+
+  if (occluder && !positions.empty() && (indices_size == 2 || indices_size == 4)) {
+    auto mesh = std::make_shared<occluder_mesh>();
+    mesh->positions = std::move(positions);
+    mesh->indices.resize(indices_count);
+    for (uint32_t i = 0; i < indices_count; ++i) {
+      const uint8_t* index = indices_buf.data() + indices_offset + i * indices_size;
+      if (indices_size == 2) {
+        uint16_t value;
+        std::memcpy(&value, index, sizeof(value));
+        mesh->indices[i] = value;
+      } else {
+        std::memcpy(&mesh->indices[i], index, sizeof(uint32_t));
+      }
+    }
+    comp.occluder = std::move(mesh);
+  }
+
   comp.uniform = cmd_buf->create_uniform(
       {
           { .type = uniform_type::SAMPLER, .binding = 0 },
@@ -120,15 +164,15 @@ void load_mesh_component(const asset& component_asset, world& world, entity& e)
   comp.model_buffer = cmd_buf->create_uniform_buffer(sizeof(mat4));
   comp.camera_buffer = cmd_buf->create_uniform_buffer(sizeof(view_projection));
 
-  if (component_asset.contains("texture")) {
-    guid texture_guid = guid::from_string(component_asset.at("texture"));
+  if (component_asset.contains(symbols::texture)) {
+    asset* texture_asset = rep->resolve(component_asset.at(symbols::texture));
 
     // TODO
     static std::unordered_map<guid, std::unique_ptr<texture>> textures;
 
-    auto& ptr = textures[texture_guid];
+    auto& ptr = textures[rep->get_guid(*texture_asset)];
     if (!ptr) {
-      ptr = std::make_unique<texture>(load_texture(*rep->get_asset(texture_guid), rep.get(), cmd_buf.get()));
+      ptr = std::make_unique<texture>(load_texture(*texture_asset, rep.get(), cmd_buf.get()));
     }
 
     cmd_buf->set_uniform(comp.uniform, 0, ptr->handle());
@@ -142,22 +186,46 @@ void load_mesh_component(const asset& component_asset, world& world, entity& e)
   renderer->submit(*cmd_buf);
 }
 
+void prefetch_mesh_component(const asset& component_asset, std::vector<buffer_id>& buffers) {
+  auto rep = reg->get<asset_repository>();
+
+  auto accessor_buffer = [&](const asset_value& accessor_ref) {
+    asset* accessor = rep->resolve(accessor_ref);
+    asset* buffer_asset = accessor ? rep->resolve(accessor->at(symbols::buffer)) : nullptr;
+    if (buffer_asset) {
+      buffers.push_back(buffer_asset->at(symbols::data));
+    }
+  };
+
+  if (asset* mesh_asset = rep->resolve(component_asset.at(symbols::mesh))) {
+    for (const asset& attr : mesh_asset->at(symbols::attributes).get<asset_array&>()) {
+      accessor_buffer(attr.at(symbols::accessor));
+    }
+    accessor_buffer(mesh_asset->at(symbols::indices));
+  }
+
+  if (component_asset.contains(symbols::texture)) {
+    if (asset* texture_asset = rep->resolve(component_asset.at(symbols::texture))) {
+      buffers.push_back(texture_asset->at(symbols::buffer));
+    }
+  }
+}
+
 void render_mesh(
     view& view,
+    const visibility_list& visible,
     const ecs::details::component_pool<transform_component>* transforms,
     const ecs::details::component_pool_base* components,
     renderer& renderer,
     render_command_buffer& render_commands,
     resource_command_buffer& resource_commands) {
 
-  auto component_view = ecs::component_view<const transform_component, const mesh_component> {
-      *transforms,
-      *static_cast<const ecs::details::component_pool<mesh_component>*>(components)
-  };
+  auto& meshes = *static_cast<const ecs::details::component_pool<mesh_component>*>(components);
+  shader_handle shader = reg->get<shader_repository>()->lookup("TestShader")->handle();
 
-  for (ecs::entity e : component_view) {
-    auto& mesh = component_view.get<const mesh_component>(e);
-    auto& transform = component_view.get<const transform_component>(e);
+  for (ecs::entity e : visible) {
+    auto& mesh = meshes.get(e);
+    auto& transform = transforms->get(e);
 
     memory camera_uniform_mem;
     resource_commands.update_uniform_buffer(mesh.camera_buffer, sizeof(view_projection), camera_uniform_mem);
@@ -170,7 +238,7 @@ void render_mesh(
 
     render_commands.draw({
                              .sort_key = view.sort_key,
-                             .shader = reg->get<shader_repository>()->lookup("TestShader")->handle(),
+                             .shader = shader,
                              .vertexbuf = mesh.vb,
                              .indexbuf = mesh.ib,
                              .uniforms = { mesh.uniform }
@@ -184,6 +252,7 @@ void register_mesh_component(systems_registry& registry) {
   auto type = meta::registration::type<mesh_component>();
   auto interface_registry = registry.get<::interface_registry>();
   interface_registry->register_interface(type.id(), load_component_interface(load_mesh_component));
+  interface_registry->register_interface(type.id(), prefetch_component_interface(prefetch_mesh_component));
   interface_registry->register_interface(type.id(), instantiate_component_interface(instantiate_component<mesh_component>));
   interface_registry->register_interface(type.id(), render_interface(render_mesh));
 }
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "gfx/gfx.h"
+#include "base/math.h"
+
+#include <memory>
+
+struct occluder_mesh;
 
 struct mesh_component {
   vertexbuf_handle vb;
@@ -8,6 +13,11 @@ struct mesh_component {
   uniform_handle uniform;
   uniformbuf_handle model_buffer;
   uniformbuf_handle camera_buffer;
+  aabb bounds;
+  // false if the mesh has no float positions to compute bounds from, such meshes are never culled
+  bool bounds_valid = false;
+  // simplified CPU copy of the mesh rasterized into the occlusion depth buffer, null if mesh is not an occluder
+  std::shared_ptr<const occluder_mesh> occluder;
 };
 
 void register_mesh_component(struct systems_registry& registry);
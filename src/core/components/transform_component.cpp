@@ -9,21 +9,9 @@
 void load_transform_component(const asset& asset, world& world, entity& e) {
   auto& comp = world.get<transform_component>(e.id);
 
-  const ::asset& position = asset.at("position");
-  comp.local.position.x = position.at("x").get<float>();
-  comp.local.position.y = position.at("y").get<float>();
-  comp.local.position.z = position.at("z").get<float>();
-
-  const ::asset& rotation = asset.at("rotation");
-  comp.local.rotation.x = rotation.at("x").get<float>();
-  comp.local.rotation.y = rotation.at("y").get<float>();
-  comp.local.rotation.z = rotation.at("z").get<float>();
-  comp.local.rotation.w = rotation.at("w").get<float>();
-
-  const ::asset& scale = asset.at("scale");
-  comp.local.scale.x = scale.at("x").get<float>();
-  comp.local.scale.y = scale.at("y").get<float>();
-  comp.local.scale.z = scale.at("z").get<float>();
+  comp.local.position = asset.at(symbols::position).get<vec3>();
+  comp.local.rotation = asset.at(symbols::rotation).get<quat>();
+  comp.local.scale = asset.at(symbols::scale).get<vec3>();
 
   comp.dirty = true;
 }
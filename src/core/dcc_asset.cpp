@@ -5,6 +5,8 @@
 #include "assimp/scene.h"
 #include "assimp/postprocess.h"
 
+#include "base/hash.h"
+#include "base/job_system.h"
 #include "base/log.h"
 #include "asset_repository.h"
 #include "world.h"
@@ -13,6 +15,10 @@
 #include "assets_filesystem.h"
 #include "texture_compiler.h"
 
+#include <array>
+#include <fstream>
+#include <limits>
+
 asset& process_node(aiNode *node, const aiScene *scene, asset_array& all_meshes, asset_array& nodes, asset_repository& repository) {
   asset& node_asset = repository.create_asset();
   repository.push_back(nodes, node_asset);
@@ -26,7 +32,7 @@ asset& process_node(aiNode *node, const aiScene *scene, asset_array& all_meshes,
     for (size_t i = 0; i < node->mNumMeshes; i++) {
       uint32_t mesh_index = node->mMeshes[i];
       const asset &mesh_asset = all_meshes[mesh_index];
-      repository.push_back(meshes, repository.get_guid(mesh_asset).str());
+      repository.push_back(meshes, repository.reference(mesh_asset));
     }
   }
 
@@ -40,24 +46,9 @@ asset& process_node(aiNode *node, const aiScene *scene, asset_array& all_meshes,
       }}
   );
 
-  asset& position = repository.create_asset();
-  repository.set_value(node_asset, "position", position);
-  repository.set_value(position, "x", local.position.x);
-  repository.set_value(position, "y", local.position.y);
-  repository.set_value(position, "z", local.position.z);
-
-  asset& rotation = repository.create_asset();
-  repository.set_value(node_asset, "rotation", rotation);
-  repository.set_value(rotation, "x", local.rotation.x);
-  repository.set_value(rotation, "y", local.rotation.y);
-  repository.set_value(rotation, "z", local.rotation.z);
-  repository.set_value(rotation, "w", local.rotation.w);
-
-  asset& scale = repository.create_asset();
-  repository.set_value(node_asset, "scale", scale);
-  repository.set_value(scale, "x", local.scale.x);
-  repository.set_value(scale, "y", local.scale.y);
-  repository.set_value(scale, "z", local.scale.z);
+  repository.set_value(node_asset, "position", local.position);
+  repository.set_value(node_asset, "rotation", local.rotation);
+  repository.set_value(node_asset, "scale", local.scale);
 
   if (node->mNumChildren > 0) {
     asset_array& children = repository.create_array();
@@ -65,7 +56,7 @@ asset& process_node(aiNode *node, const aiScene *scene, asset_array& all_meshes,
 
     for (size_t i = 0; i < node->mNumChildren; i++) {
       auto& child_asset = process_node(node->mChildren[i], scene, all_meshes, nodes, repository);
-      repository.push_back(children, repository.get_guid(child_asset).str());
+      repository.push_back(children, repository.reference(child_asset));
     }
   }
   return node_asset;
@@ -94,21 +85,55 @@ const struct aiTexture *GetEmbeddedTexture(const struct aiScene *scene, const ch
   return 0;
 }
 
-void extract_texture(
+static const char* texture_keys[] = { "diffuse", "normals", "emissive" };
+static const aiTextureType texture_types[] = { aiTextureType_DIFFUSE, aiTextureType_NORMALS, aiTextureType_EMISSIVE };
+static constexpr size_t no_texture = std::numeric_limits<size_t>::max();
+
+// Texture used by materials, contents are read on jobs and become its buffer.
+struct dcc_texture {
+  const aiTexture* embedded = nullptr;
+  fs::path path;
+  std::string name;
+  dcc_asset_texture_type type = dcc_asset_texture_type::UNKNOWN;
+  std::shared_ptr<uint8_t> data;
+  size_t size = 0;
+};
+
+// Streams of a mesh optimized and packed on jobs in the layout its accessors describe.
+struct dcc_mesh {
+  std::shared_ptr<uint8_t> vertices;
+  size_t vertices_size = 0;
+  size_t vertex_count = 0;
+  std::shared_ptr<uint8_t> indices;
+  size_t indices_size = 0;
+  size_t index_count = 0;
+  mesh_optimize_stats stats;
+};
+
+static dcc_asset_texture_type texture_type_from_extension(const fs::path& extension) {
+  if (extension == ".jpeg" || extension == ".jpg")
+    return dcc_asset_texture_type::JPEG;
+  if (extension == ".png")
+    return dcc_asset_texture_type::PNG;
+  if (extension == ".tiff")
+    return dcc_asset_texture_type::TIFF;
+  if (extension == ".tga")
+    return dcc_asset_texture_type::TGA;
+  return dcc_asset_texture_type::UNKNOWN;
+}
+
+// Index of the texture in textures, textures are added in order of first use. no_texture if the material has none.
+static size_t find_texture(
     const fs::path& asset_path,
     const aiScene* ai_scene,
-    const aiMaterial *ai_material,
+    const aiMaterial* ai_material,
     aiTextureType ai_texture_type,
-    asset_repository& repository,
-    asset& material_asset,
-    const asset::key_t& texture_key,
-    asset_array& textures,
-    asset_array& buffers,
-    std::unordered_map<std::string, asset_id>& texture_path_to_id) {
+    std::vector<dcc_texture>& textures,
+    std::unordered_map<std::string, size_t>& texture_path_to_index) {
 
   const uint32_t count = aiGetMaterialTextureCount(ai_material, ai_texture_type);
   if (!count)
-    return;
+    return no_texture;
 
   aiString ai_path;
   aiTextureMapping ai_mapping;
@@ -119,102 +144,234 @@ void extract_texture(
 
   const aiReturn res = aiGetMaterialTexture(ai_material, ai_texture_type, 0, &ai_path, &ai_mapping, &ai_uv_set, &ai_blend, &ai_op, &ai_map_mode, &ai_flags);
   if (res != aiReturn_SUCCESS) {
-    return;
+    return no_texture;
   }
 
   if (!ai_path.length) {
+    return no_texture;
+  }
+
+  auto [it, inserted] = texture_path_to_index.emplace(ai_path.C_Str(), textures.size());
+  if (!inserted)
+    return it->second;
+
+  dcc_texture& texture = textures.emplace_back();
+  if (ai_path.data[0] == '*') {
+    uint32_t texture_idx = std::atoi(ai_path.data + 1);
+    if (texture_idx < ai_scene->mNumTextures) {
+      texture.embedded = ai_scene->mTextures[texture_idx];
+    }
+  } else {
+    texture.embedded = GetEmbeddedTexture(ai_scene, ai_path.data);
+  }
+
+  if (texture.embedded) {
+    // TODO: compressed embedded textures
+    if (texture.embedded->mHeight > 0) {
+      texture.type = dcc_asset_texture_type::RAW;
+      texture.name = texture.embedded->mFilename.C_Str();
+    }
+  } else {
+    texture.path = fs::append(asset_path.parent_path(), ai_path.data);
+    texture.type = texture_type_from_extension(texture.path.extension());
+    texture.name = texture.path.filename().string();
+  }
+  return it->second;
+}
+
+// Runs on jobs, texture is left UNKNOWN if its contents can't be read.
+static void extract_texture(dcc_texture& texture) {
+  if (texture.type == dcc_asset_texture_type::UNKNOWN)
+    return;
+
+  if (texture.embedded) {
+    texture_data_desc desc {
+      .width = texture.embedded->mWidth,
+      .height = texture.embedded->mHeight,
+      .format = texture_format::RGBA8
+    };
+    texture.size = sizeof(desc) + texture_size(desc);
+    texture.data = asset_repository::allocate_buffer_memory(texture.size);
+    std::memcpy(texture.data.get(), &desc, sizeof(desc));
+    std::memcpy(texture.data.get() + sizeof(desc), texture.embedded->pcData, texture_size(desc));
     return;
   }
 
-  asset_id& texture_asset_id = texture_path_to_id[ai_path.C_Str()];
-  if (!texture_asset_id) {
-    auto& texture_asset = repository.create_asset();
-    repository.push_back(textures, texture_asset);
-    const aiTexture *ai_texture = nullptr;
-    if (ai_path.data[0] == '*') {
-      uint32_t texture_idx = std::atoi(ai_path.data + 1);
-      if (texture_idx < ai_scene->mNumTextures) {
-        ai_texture = ai_scene->mTextures[texture_idx];
-      }
-    } else {
-      ai_texture = GetEmbeddedTexture(ai_scene, ai_path.data);
+  std::error_code error;
+  size_t size = fs::file_size(texture.path, error);
+  if (error) {
+    logger::core::Warning("Extract texture during dcc_asset import failed: texture file at path {} doesn't exist.", texture.path.c_str());
+    texture.type = dcc_asset_texture_type::UNKNOWN;
+    return;
+  }
+
+  auto data = asset_repository::allocate_buffer_memory(size);
+  std::ifstream file(texture.path, std::ios::binary | std::ios::in);
+  if (!file.read(reinterpret_cast<char*>(data.get()), (std::streamsize) size)) {
+    logger::core::Warning("Extract texture during dcc_asset import failed: couldn't read texture file at path {}.", texture.path.c_str());
+    texture.type = dcc_asset_texture_type::UNKNOWN;
+    return;
+  }
+
+  texture.data = std::move(data);
+  texture.size = size;
+}
+
+template<typename T>
+static void read_setting(const asset& settings, const char* key, T& value) {
+  auto it = settings.find(key);
+  if (it == settings.end())
+    return;
+
+  if constexpr (std::is_same_v<T, bool>) {
+    if (it->second.is_boolean()) {
+      value = it->second.get<bool>();
+      return;
     }
+  } else if (it->second.is_number()) {
+    value = it->second.get<T>();
+    return;
+  }
+  logger::core::Warning("Ignored dcc import setting {} of unexpected type", key);
+}
 
-    if (ai_texture) {
+dcc_import_settings read_dcc_import_settings(const asset* dcc_asset) {
+  dcc_import_settings result;
+  if (!dcc_asset)
+    return result;
+
+  auto settings = dcc_asset->find("settings");
+  if (settings == dcc_asset->end() || !settings->second.is_object())
+    return result;
+
+  auto meshes = settings->second.get<const asset&>().find("meshes");
+  if (meshes == settings->second.get<const asset&>().end() || !meshes->second.is_object())
+    return result;
+
+  const asset& mesh_settings = meshes->second.get<const asset&>();
+  read_setting(mesh_settings, "deduplicate", result.meshes.deduplicate);
+  read_setting(mesh_settings, "vertex_cache", result.meshes.vertex_cache);
+  read_setting(mesh_settings, "overdraw", result.meshes.overdraw);
+  read_setting(mesh_settings, "overdraw_threshold", result.meshes.overdraw_threshold);
+  read_setting(mesh_settings, "vertex_fetch", result.meshes.vertex_fetch);
+  read_setting(mesh_settings, "cache_size", result.meshes.cache_size);
+  result.meshes.cache_size = std::max(result.meshes.cache_size, 3u);
+  return result;
+}
 
-      if (ai_texture->mHeight > 0) {
-        repository.set_value(texture_asset, "type", (uint32_t) dcc_asset_texture_type::RAW);
+uint64_t hash_dcc_import_settings(const dcc_import_settings& settings) {
+  const mesh_optimize_settings& meshes = settings.meshes;
+  uint32_t threshold_bits;
+  std::memcpy(&threshold_bits, &meshes.overdraw_threshold, sizeof(threshold_bits));
 
-        texture_data_desc desc {
-          .width = ai_texture->mWidth,
-          .height = ai_texture->mHeight,
-          .format = texture_format::RGBA8
-        };
-        auto buf_id = repository.create_buffer(sizeof(desc) + texture_size(desc));
-        repository.update_buffer(buf_id, 0, &desc, sizeof(desc));
-        repository.update_buffer(buf_id, sizeof(desc), ai_texture->pcData, texture_size(desc));
+  uint64_t parts[] = {
+    meshes.deduplicate, meshes.vertex_cache, meshes.overdraw, threshold_bits, meshes.vertex_fetch, meshes.cache_size
+  };
+  return utils::hash64(parts, sizeof(parts));
+}
 
-        auto& buffer_asset = repository.create_asset();
-        repository.set_value(buffer_asset, "data", buf_id);
-        repository.push_back(buffers, buffer_asset);
+static void write_dcc_import_settings(asset_repository& repository, asset& root, const dcc_import_settings& settings) {
+  asset& settings_asset = repository.create_asset();
+  repository.set_value(root, "settings", settings_asset);
+
+  asset& meshes = repository.create_asset();
+  repository.set_value(settings_asset, "meshes", meshes);
+  repository.set_value(meshes, "deduplicate", settings.meshes.deduplicate);
+  repository.set_value(meshes, "vertex_cache", settings.meshes.vertex_cache);
+  repository.set_value(meshes, "overdraw", settings.meshes.overdraw);
+  repository.set_value(meshes, "overdraw_threshold", settings.meshes.overdraw_threshold);
+  repository.set_value(meshes, "vertex_fetch", settings.meshes.vertex_fetch);
+  repository.set_value(meshes, "cache_size", settings.meshes.cache_size);
+}
 
-        repository.set_value(texture_asset, "name", ai_texture->mFilename.C_Str());
-        repository.set_ref(texture_asset, "buffer", buffer_asset.id());
-      } else {
-        // TODO:
-      }
+// Runs on jobs. Positions, normals, first uv set and tangents follow each other, then three indices per face.
+static void extract_mesh(const aiMesh* mesh, const mesh_optimize_settings& settings, dcc_mesh& out) {
+  out.vertex_count = mesh->mNumVertices;
 
-    } else {
-      fs::path texture_path { fs::append(asset_path.parent_path(), ai_path.data) };
-      if (fs::exists(texture_path)) {
-        std::ifstream file(texture_path, std::ios::binary | std::ios::in);
-
-        fs::path extension = texture_path.extension();
-        dcc_asset_texture_type texture_type = dcc_asset_texture_type::UNKNOWN;
-        if (extension == ".jpeg" || extension == ".jpg") {
-          texture_type = dcc_asset_texture_type::JPEG;
-        } else if (extension == ".png") {
-          texture_type = dcc_asset_texture_type::PNG;
-        } else if (extension == ".tiff") {
-          texture_type = dcc_asset_texture_type::TIFF;
-        } else if (extension == ".tga") {
-          texture_type = dcc_asset_texture_type::TGA;
-        }
+  std::vector<size_t> strides { sizeof(aiVector3D) };
+  if (mesh->HasNormals()) strides.push_back(sizeof(aiVector3D));
+  if (mesh->HasTextureCoords(0)) strides.push_back(2 * sizeof(float));
+  if (mesh->HasTangentsAndBitangents()) strides.push_back(sizeof(aiVector3D));
+
+  out.vertices_size = 0;
+  for (size_t stride : strides) {
+    out.vertices_size += stride * out.vertex_count;
+  }
 
-        if (texture_type != dcc_asset_texture_type::UNKNOWN) {
-          size_t buf_size = file.rdbuf()->pubseekoff(0, std::ios::end, std::ios::in);
-          char buffer[buf_size];
-          file.rdbuf()->pubseekpos(0, std::ios_base::in);
-          file.rdbuf()->sgetn(buffer, buf_size);
+  out.vertices = asset_repository::allocate_buffer_memory(out.vertices_size);
+  std::vector<vertex_stream> streams;
+  uint8_t* dst = out.vertices.get();
+  for (size_t stride : strides) {
+    streams.push_back({ dst, stride });
+    dst += stride * out.vertex_count;
+  }
 
-          auto buf_id = repository.create_buffer(buf_size);
-          repository.update_buffer(buf_id, 0, buffer, buf_size);
+  size_t stream = 0;
+  std::memcpy(streams[stream++].data, mesh->mVertices, sizeof(aiVector3D) * out.vertex_count);
 
-          auto &buffer_asset = repository.create_asset();
-          repository.set_value(buffer_asset, "data", buf_id);
-          repository.push_back(buffers, buffer_asset);
+  if (mesh->HasNormals()) {
+    std::memcpy(streams[stream++].data, mesh->mNormals, sizeof(aiVector3D) * out.vertex_count);
+  }
 
-          repository.set_value(texture_asset, "name", texture_path.filename().c_str());
-          repository.set_value(texture_asset, "type", (uint32_t) texture_type);
-          repository.set_ref(texture_asset, "buffer", buffer_asset.id());
-        }
-      } else {
-        logger::core::Warning("Extract texture during dcc_asset import failed: texture file at path {} doesn't exist.", texture_path.c_str());
-      }
+  if (mesh->HasTextureCoords(0)) {
+    auto* tex_coords = reinterpret_cast<float*>(streams[stream++].data);
+    for (size_t vert = 0; vert < out.vertex_count; ++vert) {
+      tex_coords[2 * vert + 0] = mesh->mTextureCoords[0][vert].x;
+      tex_coords[2 * vert + 1] = mesh->mTextureCoords[0][vert].y;
+    }
+  }
+
+  if (mesh->HasTangentsAndBitangents()) {
+    std::memcpy(streams[stream++].data, mesh->mTangents, sizeof(aiVector3D) * out.vertex_count);
+  }
+
+  out.index_count = 3 * mesh->mNumFaces;
+  out.indices_size = sizeof(uint32_t) * out.index_count;
+  out.indices = asset_repository::allocate_buffer_memory(out.indices_size);
+  auto* indices = reinterpret_cast<uint32_t*>(out.indices.get());
 
+  for (size_t face_i = 0; face_i < mesh->mNumFaces; ++face_i) {
+    const aiFace& face = mesh->mFaces[face_i];
+    // points and lines left by triangulation become degenerate triangles
+    for (uint32_t corner = 0; corner < 3; corner++) {
+      indices[3 * face_i + corner] = face.mNumIndices ? face.mIndices[std::min(corner, face.mNumIndices - 1)] : 0;
     }
+  }
+
+  out.stats = optimize_mesh(indices, out.index_count, streams.data(), streams.size(), out.vertex_count, settings);
 
-    if (!texture_asset.contains("type")) {
-      repository.set_value(texture_asset, "type", (uint32_t) dcc_asset_texture_type::UNKNOWN);
+  // fewer vertices are left, streams move down to follow each other again
+  dst = out.vertices.get();
+  for (const vertex_stream& s : streams) {
+    std::memmove(dst, s.data, s.stride * out.vertex_count);
+    dst += s.stride * out.vertex_count;
+  }
+  out.vertices_size = dst - out.vertices.get();
+}
+
+static void report_mesh_optimization(const fs::path& path, const std::vector<dcc_mesh>& meshes) {
+  vertex_cache_stats before, after;
+  for (const dcc_mesh& mesh : meshes) {
+    for (auto [total, stats] : { std::pair(&before, &mesh.stats.before), std::pair(&after, &mesh.stats.after) }) {
+      total->triangles += stats->triangles;
+      total->vertices += stats->vertices;
+      total->transformed += stats->transformed;
     }
+  }
 
-    texture_asset_id = texture_asset.id();
+  if (!before.triangles)
+    return;
+
+  for (vertex_cache_stats* total : { &before, &after }) {
+    total->acmr = (float) total->transformed / (float) total->triangles;
+    total->atvr = (float) total->transformed / (float) total->vertices;
   }
 
-  repository.set_ref(material_asset, texture_key, texture_asset_id);
+  logger::core::Info("Meshes of {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, {} -> {} vertices, {} triangles",
+                     path.c_str(), before.acmr, after.acmr, before.atvr, after.atvr, before.vertices, after.vertices, before.triangles);
 }
 
-asset_id create_dcc_asset(const fs::path &path, asset_repository& repository) {
+asset_id create_dcc_asset(const fs::path &path, asset_repository& repository, const dcc_import_settings& settings, job_system* jobs) {
   Assimp::Importer importer;
   const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
 
@@ -223,7 +380,41 @@ asset_id create_dcc_asset(const fs::path &path, asset_repository& repository) {
     return { };
   }
 
+  std::vector<dcc_texture> textures_data;
+  std::unordered_map<std::string, size_t> texture_path_to_index;
+  std::vector<std::array<size_t, std::size(texture_keys)>> material_textures(scene->mNumMaterials);
+
+  for (size_t mat_i = 0; mat_i < scene->mNumMaterials; ++mat_i) {
+    for (size_t key_i = 0; key_i < std::size(texture_keys); ++key_i) {
+      material_textures[mat_i][key_i] = find_texture(path, scene, scene->mMaterials[mat_i], texture_types[key_i], textures_data, texture_path_to_index);
+    }
+  }
+
+  // contents of textures and meshes are extracted on jobs, assets are created on this thread from the results
+  std::vector<dcc_mesh> meshes_data(scene->mNumMeshes);
+  auto extract = [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      if (i < textures_data.size()) {
+        extract_texture(textures_data[i]);
+      } else {
+        extract_mesh(scene->mMeshes[i - textures_data.size()], settings.meshes, meshes_data[i - textures_data.size()]);
+      }
+    }
+  };
+
+  if (jobs) {
+    jobs->parallel_for(textures_data.size() + meshes_data.size(), 1, extract);
+  } else {
+    extract(0, textures_data.size() + meshes_data.size());
+  }
+
+  report_mesh_optimization(path, meshes_data);
+
+  // the whole tree is new, versions are not tracked while it's built
+  asset_batch batch(repository, asset_repository::batch_mode::CONSTRUCT);
+
   asset& root = repository.create_asset();
+  write_dcc_import_settings(repository, root, settings);
 
   asset_array& materials = repository.create_array();
   repository.set_value(root, "materials", materials);
@@ -234,7 +425,7 @@ asset_id create_dcc_asset(const fs::path &path, asset_repository& repository) {
   asset_array& buffers = repository.create_array();
   repository.set_value(root, "buffers", buffers);
 
-  std::unordered_map<std::string, asset_id> texture_path_to_id;
+  std::vector<asset_id> texture_ids(textures_data.size());
 
   for (size_t mat_i = 0; mat_i < scene->mNumMaterials; ++mat_i) {
     const aiMaterial *ai_material = scene->mMaterials[mat_i];
@@ -250,45 +441,35 @@ asset_id create_dcc_asset(const fs::path &path, asset_repository& repository) {
 
     repository.set_value(material_asset, "double_sided", (bool) double_sided);
 
-    extract_texture(
-        path,
-        scene,
-        ai_material,
-        aiTextureType_DIFFUSE,
-        repository,
-        material_asset,
-        "diffuse",
-        textures,
-        buffers,
-        texture_path_to_id
-      );
-
-    extract_texture(
-        path,
-        scene,
-        ai_material,
-        aiTextureType_NORMALS,
-        repository,
-        material_asset,
-        "normals",
-        textures,
-        buffers,
-        texture_path_to_id
-    );
-
-    extract_texture(
-        path,
-        scene,
-        ai_material,
-        aiTextureType_EMISSIVE,
-        repository,
-        material_asset,
-        "emissive",
-        textures,
-        buffers,
-        texture_path_to_id
-    );
+    for (size_t key_i = 0; key_i < std::size(texture_keys); ++key_i) {
+      size_t texture_index = material_textures[mat_i][key_i];
+      if (texture_index == no_texture)
+        continue;
+
+      asset_id& texture_asset_id = texture_ids[texture_index];
+      if (!texture_asset_id) {
+        dcc_texture& texture = textures_data[texture_index];
+
+        auto& texture_asset = repository.create_asset();
+        repository.push_back(textures, texture_asset);
+        repository.set_value(texture_asset, "type", (uint32_t) texture.type);
+
+        if (texture.data) {
+          auto buf_id = repository.create_buffer(std::move(texture.data), texture.size);
+
+          auto& buffer_asset = repository.create_asset();
+          repository.set_value(buffer_asset, "data", buf_id);
+          repository.push_back(buffers, buffer_asset);
+
+          repository.set_value(texture_asset, "name", texture.name.c_str());
+          repository.set_ref(texture_asset, "buffer", buffer_asset.id());
+        }
 
+        texture_asset_id = texture_asset.id();
+      }
+
+      repository.set_ref(material_asset, texture_keys[key_i], texture_asset_id);
+    }
   }
 
   asset_array& accessors = repository.create_array();
@@ -300,6 +481,7 @@ asset_id create_dcc_asset(const fs::path &path, asset_repository& repository) {
   for (size_t mesh_i = 0; mesh_i < scene->mNumMeshes; ++mesh_i) {
 
     aiMesh* mesh = scene->mMeshes[mesh_i];
+    dcc_mesh& mesh_data = meshes_data[mesh_i];
 
     asset& mesh_asset = repository.create_asset();
     repository.push_back(meshes, mesh_asset);
@@ -321,123 +503,90 @@ asset_id create_dcc_asset(const fs::path &path, asset_repository& repository) {
 
     asset& position_accessor = repository.create_asset();
     repository.push_back(accessors, position_accessor);
-    repository.set_value(position_accessor, "buffer", repository.get_guid(v_buf_asset).str());
+    repository.set_value(position_accessor, "buffer", repository.reference(v_buf_asset));
 
     repository.set_value(position_accessor, "float", true);
     repository.set_value(position_accessor, "size", 4);
     repository.set_value(position_accessor, "components", 3);
     repository.set_value(position_accessor, "offset", v_buf_size);
-    repository.set_value(position_accessor, "count", mesh->mNumVertices);
-    v_buf_size += sizeof(aiVector3D) * mesh->mNumVertices;
+    repository.set_value(position_accessor, "count", mesh_data.vertex_count);
+    v_buf_size += sizeof(aiVector3D) * mesh_data.vertex_count;
 
     asset& position_attr = repository.create_asset();
     repository.push_back(attributes, position_attr);
-    repository.set_value(position_attr, "accessor", repository.get_guid(position_accessor).str());
+    repository.set_value(position_attr, "accessor", repository.reference(position_accessor));
     repository.set_value(position_attr, "semantic", (int) vertex_semantic::POSITION);
 
     if (mesh->HasNormals()) {
       asset &normals_accessor = repository.create_asset();
       repository.push_back(accessors, normals_accessor);
-      repository.set_value(normals_accessor, "buffer", repository.get_guid(v_buf_asset).str());
+      repository.set_value(normals_accessor, "buffer", repository.reference(v_buf_asset));
       repository.set_value(normals_accessor, "float", true);
       repository.set_value(normals_accessor, "size", 4);
       repository.set_value(normals_accessor, "components", 3);
       repository.set_value(normals_accessor, "offset", v_buf_size);
-      repository.set_value(normals_accessor, "count", mesh->mNumVertices);
-      v_buf_size += sizeof(aiVector3D) * mesh->mNumVertices;
+      repository.set_value(normals_accessor, "count", mesh_data.vertex_count);
+      v_buf_size += sizeof(aiVector3D) * mesh_data.vertex_count;
 
       asset& normal_attr = repository.create_asset();
       repository.push_back(attributes, normal_attr);
-      repository.set_value(normal_attr, "accessor", repository.get_guid(normals_accessor).str());
+      repository.set_value(normal_attr, "accessor", repository.reference(normals_accessor));
       repository.set_value(normal_attr, "semantic", (int) vertex_semantic::NORMAL);
     }
 
     if (mesh->HasTextureCoords(0)) {
       asset &tex_coord_accessor = repository.create_asset();
       repository.push_back(accessors, tex_coord_accessor);
-      repository.set_value(tex_coord_accessor, "buffer",repository.get_guid(v_buf_asset).str());
+      repository.set_value(tex_coord_accessor, "buffer",repository.reference(v_buf_asset));
       repository.set_value(tex_coord_accessor, "float", true);
       repository.set_value(tex_coord_accessor, "size", 4);
       repository.set_value(tex_coord_accessor, "components", 2);
       repository.set_value(tex_coord_accessor, "offset", v_buf_size);
-      repository.set_value(tex_coord_accessor, "count", mesh->mNumVertices);
-      v_buf_size += 2 * sizeof(ai_real) * mesh->mNumVertices;
+      repository.set_value(tex_coord_accessor, "count", mesh_data.vertex_count);
+      v_buf_size += 2 * sizeof(float) * mesh_data.vertex_count;
 
       asset& texcoord_attr = repository.create_asset();
       repository.push_back(attributes, texcoord_attr);
-      repository.set_value(texcoord_attr, "accessor", repository.get_guid(tex_coord_accessor).str());
+      repository.set_value(texcoord_attr, "accessor", repository.reference(tex_coord_accessor));
       repository.set_value(texcoord_attr, "semantic", (int) vertex_semantic::TEXCOORD0);
     }
 
     if (mesh->HasTangentsAndBitangents()) {
       asset &tangent_accessor = repository.create_asset();
       repository.push_back(accessors, tangent_accessor);
-      repository.set_value(tangent_accessor, "buffer", repository.get_guid(v_buf_asset).str());
+      repository.set_value(tangent_accessor, "buffer", repository.reference(v_buf_asset));
       repository.set_value(tangent_accessor, "float", true);
       repository.set_value(tangent_accessor, "size", 4);
       repository.set_value(tangent_accessor, "components", 3);
       repository.set_value(tangent_accessor, "offset", v_buf_size);
-      repository.set_value(tangent_accessor, "count", mesh->mNumVertices);
-      v_buf_size += sizeof(aiVector3D) * mesh->mNumVertices;
+      repository.set_value(tangent_accessor, "count", mesh_data.vertex_count);
+      v_buf_size += sizeof(aiVector3D) * mesh_data.vertex_count;
 
       asset& tangent_attr = repository.create_asset();
       repository.push_back(attributes, tangent_attr);
-      repository.set_value(tangent_attr, "accessor", repository.get_guid(tangent_accessor).str());
+      repository.set_value(tangent_attr, "accessor", repository.reference(tangent_accessor));
       repository.set_value(tangent_attr, "semantic", (int) vertex_semantic::TANGENT);
     }
 
     asset &index_accessor = repository.create_asset();
     repository.push_back(accessors, index_accessor);
-    repository.set_value(index_accessor, "buffer", repository.get_guid(i_buf_asset).str());
+    repository.set_value(index_accessor, "buffer", repository.reference(i_buf_asset));
     repository.set_value(index_accessor, "float", false);
     repository.set_value(index_accessor, "size", 4);
     repository.set_value(index_accessor, "unsigned", true);
     repository.set_value(index_accessor, "components", 1);
     repository.set_value(index_accessor, "offset", i_buf_size);
-    repository.set_value(index_accessor, "count", 3 * mesh->mNumFaces);
-    i_buf_size += sizeof(uint32_t) * 3 *  mesh->mNumFaces;
+    repository.set_value(index_accessor, "count", mesh_data.index_count);
+    i_buf_size += sizeof(uint32_t) * mesh_data.index_count;
 
-    repository.set_value(mesh_asset, "indices", repository.get_guid(index_accessor).str());
+    repository.set_value(mesh_asset, "indices", repository.reference(index_accessor));
 
-    auto vbuf_id = repository.create_buffer(v_buf_size);
+    assert(v_buf_size == mesh_data.vertices_size && i_buf_size == mesh_data.indices_size);
+    auto vbuf_id = repository.create_buffer(std::move(mesh_data.vertices), mesh_data.vertices_size);
     repository.set_value(v_buf_asset, "data", vbuf_id);
 
-    size_t vbuf_offset = 0;
-
-    repository.update_buffer(vbuf_id, vbuf_offset, mesh->mVertices, sizeof(aiVector3D) * mesh->mNumVertices);
-    vbuf_offset += sizeof(aiVector3D) * mesh->mNumVertices;
-
-    if (mesh->HasNormals()) {
-      repository.update_buffer(vbuf_id, vbuf_offset, mesh->mNormals, sizeof(aiVector3D) * mesh->mNumVertices);
-      vbuf_offset += sizeof(aiVector3D) * mesh->mNumVertices;
-    }
-
-    if (mesh->HasTextureCoords(0)) {
-      float tex_coord_buf[2 * mesh->mNumVertices];
-      for (size_t vert = 0; vert < mesh->mNumVertices; ++vert) {
-        tex_coord_buf[2 * vert + 0] = mesh->mTextureCoords[0][vert].x;
-        tex_coord_buf[2 * vert + 1] = mesh->mTextureCoords[0][vert].y;
-      }
-
-      repository.update_buffer(vbuf_id, vbuf_offset, tex_coord_buf, sizeof(tex_coord_buf));
-      vbuf_offset += sizeof(tex_coord_buf);
-    }
-
-    if (mesh->HasTangentsAndBitangents()) {
-      repository.update_buffer(vbuf_id, vbuf_offset, mesh->mTangents, sizeof(aiVector3D) * mesh->mNumVertices);
-      vbuf_offset += sizeof(aiVector3D) * mesh->mNumVertices;
-    }
-
-    auto ibuf_id = repository.create_buffer(i_buf_size);
+    auto ibuf_id = repository.create_buffer(std::move(mesh_data.indices), mesh_data.indices_size);
     repository.set_value(i_buf_asset, "data", ibuf_id);
-
-    size_t ibuf_offset = 0;
-
-    for (size_t face_i = 0; face_i < mesh->mNumFaces; ++face_i) {
-      aiFace& face = mesh->mFaces[face_i];
-      repository.update_buffer(ibuf_id, ibuf_offset, face.mIndices, sizeof(uint32_t) * face.mNumIndices);
-      ibuf_offset += sizeof(uint32_t) * face.mNumIndices;
-    }
   }
 
   asset_array& nodes = repository.create_array();
@@ -445,14 +594,14 @@ asset_id create_dcc_asset(const fs::path &path, asset_repository& repository) {
 
   asset& root_node_asset = process_node(scene->mRootNode, scene, meshes, nodes, repository);
 
-  repository.set_value(root, "scene_root", repository.get_guid(root_node_asset).str());
+  repository.set_value(root, "scene_root", repository.reference(root_node_asset));
   return root.id();
 }
 
 asset* parse_node(const asset& node_asset, asset_repository& rep, assets_filesystem& filesystem, const fs::path& path, std::unordered_map<guid, guid>& dcc_texture_to_texture) {
   asset& entity_asset = rep.create_asset();
   rep.set_value(entity_asset, "__type", "entity");
-  rep.set_value(entity_asset, "name", node_asset.at("name").get<std::string&>());
+  rep.set_value(entity_asset, "name", node_asset.at("name").get<std::string_view>());
 
   asset& components = rep.create_asset();
   rep.set_value(entity_asset, "components", components);
@@ -468,7 +617,7 @@ asset* parse_node(const asset& node_asset, asset_repository& rep, assets_filesys
   rep.set_value(entity_asset, "children", children);
 
   if (node_asset.contains("meshes")) {
-    for (const std::string& mesh_guid : node_asset.at("meshes").get<asset_array&>()) {
+    for (const asset_value& mesh_ref : node_asset.at("meshes").get<asset_array&>()) {
       asset& mesh_entity = rep.create_asset();
       asset& child_components = rep.create_asset();
       rep.set_value(mesh_entity, "components", child_components);
@@ -477,36 +626,19 @@ asset* parse_node(const asset& node_asset, asset_repository& rep, assets_filesys
       asset& child_transform_comp = rep.create_asset();
       rep.set_value(child_components, "transform_component", child_transform_comp);
 
-      asset& position = rep.create_asset();
-      rep.set_value(position, "x", 0.0f);
-      rep.set_value(position, "y", 0.0f);
-      rep.set_value(position, "z", 0.0f);
-
-      asset& rotation = rep.create_asset();
-      rep.set_value(rotation, "x", 0.0f);
-      rep.set_value(rotation, "y", 0.0f);
-      rep.set_value(rotation, "z", 0.0f);
-      rep.set_value(rotation, "w", 1.0f);
-
-      asset& scale = rep.create_asset();
-      rep.set_value(scale, "x", 1.0f);
-      rep.set_value(scale, "y", 1.0f);
-      rep.set_value(scale, "z", 1.0f);
-
-      rep.set_value(child_transform_comp, "position", position);
-      rep.set_value(child_transform_comp, "rotation", rotation);
-      rep.set_value(child_transform_comp, "scale", scale);
+      rep.set_value(child_transform_comp, "position", vec3::zero());
+      rep.set_value(child_transform_comp, "rotation", quat::identity());
+      rep.set_value(child_transform_comp, "scale", vec3::one());
 
       asset& child_mesh_comp = rep.create_asset();
       rep.set_value(child_components, "mesh_component", child_mesh_comp);
 
-      if (const asset* mesh_asset = rep.get_asset(guid::from_string(mesh_guid))) {
-        guid material_guid = guid::from_string(mesh_asset->at("material"));
-        if (asset* material_asset = rep.get_asset(material_guid); material_asset && material_asset->contains("diffuse")) {
-          guid diffuse_dcc_texture_guid = guid::from_string(material_asset->at("diffuse"));
-          guid& texture_guid = dcc_texture_to_texture[diffuse_dcc_texture_guid];
-          if (!texture_guid.is_valid()) {
-            if (asset *texture_asset = rep.get_asset(diffuse_dcc_texture_guid)) {
+      if (const asset* mesh_asset = rep.resolve(mesh_ref)) {
+        asset* material_asset = rep.resolve(mesh_asset->at("material"));
+        if (material_asset && material_asset->contains("diffuse")) {
+          if (asset *texture_asset = rep.resolve(material_asset->at("diffuse"))) {
+            guid& texture_guid = dcc_texture_to_texture[rep.get_guid(*texture_asset)];
+            if (!texture_guid.is_valid()) {
               const std::string& name = texture_asset->at("name");
               fs::path texture_path = fs::append(path.parent_path(), fs::concat(name, ".texture"));
 
@@ -520,13 +652,13 @@ asset* parse_node(const asset& node_asset, asset_repository& rep, assets_filesys
                 texture_guid = rep.get_guid(texture_output.id());
               }
             }
+            if (texture_guid.is_valid())
+              rep.set_value(child_mesh_comp, "texture", texture_guid);
           }
-          if (texture_guid.is_valid())
-            rep.set_value(child_mesh_comp, "texture", texture_guid);
         }
       }
 
-      rep.set_value(child_mesh_comp, "mesh", mesh_guid);
+      rep.copy_value(child_mesh_comp, "mesh", mesh_ref);
 
       rep.push_back(children, mesh_entity);
 
@@ -534,8 +666,8 @@ asset* parse_node(const asset& node_asset, asset_repository& rep, assets_filesys
   }
 
   if (node_asset.contains("children")) {
-    for (const std::string& guid_str : node_asset.at("children").get<asset_array&>()) {
-      asset* child_node_asset = rep.get_asset(guid::from_string(guid_str));
+    for (const asset_value& child_ref : node_asset.at("children").get<asset_array&>()) {
+      asset* child_node_asset = rep.resolve(child_ref);
       asset* child_entity_asset = parse_node(*child_node_asset, rep, filesystem, path, dcc_texture_to_texture);
       rep.push_back(children, *child_entity_asset);
     }
@@ -549,11 +681,11 @@ asset* parse_node(const asset& node_asset, asset_repository& rep, assets_filesys
 }
 
 asset_id create_entity_from_dcc_asset(const asset& dcc_asset, asset_repository& rep, assets_filesystem& filesystem) {
-  auto& path = rep.get_asset_path(dcc_asset.id());
+  fs::path path = rep.get_asset_path(dcc_asset.id());
 
   std::unordered_map<guid, guid> cache;
   asset* root_asset = parse_node(
-      *rep.get_asset(guid::from_string(dcc_asset.at("scene_root"))), rep, filesystem, path, cache);
+      *rep.resolve(dcc_asset.at("scene_root")), rep, filesystem, path, cache);
 
   return root_asset->id();
 }
\ No newline at end of file
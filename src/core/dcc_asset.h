@@ -1,6 +1,9 @@
 #pragma once
 
 #include "platform/file_system.h"
+#include "core/mesh_optimizer.h"
+
+#include <cstdint>
 
 class asset_id;
 class asset;
@@ -9,6 +12,7 @@ class assets_filesystem;
 class world;
 class entity;
 class interface_registry;
+class job_system;
 class renderer;
 
 enum class dcc_asset_texture_type {
@@ -21,6 +25,19 @@ enum class dcc_asset_texture_type {
   UNKNOWN
 };
 
-asset_id create_dcc_asset(const fs::path& path, asset_repository&);
+// Bump when imported dcc assets or entities created from them change, dependency graph rebuilds them then.
+constexpr uint32_t dcc_importer_version = 2;
+
+// Kept in the "settings" object of the .dcc_asset, reimports of the asset read them back from there.
+struct dcc_import_settings {
+  mesh_optimize_settings meshes;
+};
+
+// Defaults for keys the asset doesn't have, or for no asset.
+dcc_import_settings read_dcc_import_settings(const asset* dcc_asset);
+uint64_t hash_dcc_import_settings(const dcc_import_settings& settings);
+
+// Mesh and texture contents are extracted and meshes optimized on jobs, assets are created on the calling thread.
+asset_id create_dcc_asset(const fs::path& path, asset_repository&, const dcc_import_settings& settings = {}, job_system* jobs = nullptr);
 asset_id create_entity_from_dcc_asset(const asset& asset, asset_repository& rep, assets_filesystem& filesystem);
 
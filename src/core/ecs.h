@@ -395,6 +395,29 @@ public:
     free_idx_ = details::entity_traits::get_index(entity);
   }
 
+  // Destroys a range of entities walking every pool once instead of once per entity.
+  template<class It>
+  void destroy(It first, It last) {
+    for (auto& pool : pools_) {
+      if (!pool.ptr)
+        continue;
+
+      for (auto it = first; it != last; ++it) {
+        if (pool.ptr->contains(*it)) {
+          pool.remove_ptr(pool.ptr.get(), *it);
+        }
+      }
+    }
+
+    for (auto it = first; it != last; ++it) {
+      assert(valid(*it));
+      auto index = details::entity_traits::get_index(*it);
+      details::entity_traits::set_index(entities_[index], free_idx_);
+      details::entity_traits::set_generation(entities_[index], entity_traits::get_generation(entities_[index]) + 1);
+      free_idx_ = index;
+    }
+  }
+
   [[nodiscard]] bool valid(entity entity) const {
     auto index = entity_traits::get_index(entity);
     return index < entities_.size() && entities_[index] == entity;
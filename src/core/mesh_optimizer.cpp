@@ -0,0 +1,338 @@
+#include "mesh_optimizer.h"
+
+#include "base/hash.h"
+#include "base/math.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t invalid_index = std::numeric_limits<uint32_t>::max();
+
+// FIFO cache, vertex is cached if less than cache_size misses happened since it was added
+struct cache_simulation {
+  std::vector<uint32_t> timestamps;
+  uint32_t timestamp;
+  uint32_t cache_size;
+
+  cache_simulation(size_t vertex_count, uint32_t cache_size)
+    : timestamps(vertex_count), timestamp(cache_size + 1), cache_size(cache_size)
+  {}
+
+  uint32_t touch(uint32_t v) {
+    if (timestamp - timestamps[v] <= cache_size)
+      return 0;
+
+    timestamps[v] = timestamp++;
+    return 1;
+  }
+
+  uint32_t touch(const uint32_t* triangle) {
+    return touch(triangle[0]) + touch(triangle[1]) + touch(triangle[2]);
+  }
+
+  void flush() { timestamp += cache_size + 1; }
+};
+
+vec3 read_position(const vertex_stream& positions, uint32_t v) {
+  vec3 result;
+  std::memcpy(&result.x, positions.data + v * positions.stride, 3 * sizeof(float));
+  return result;
+}
+
+}
+
+vertex_cache_stats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size) {
+  vertex_cache_stats stats;
+  stats.triangles = index_count / 3;
+
+  cache_simulation cache(vertex_count, cache_size);
+  std::vector<bool> referenced(vertex_count);
+  for (size_t i = 0; i < stats.triangles * 3; i++) {
+    stats.transformed += cache.touch(indices[i]);
+    if (!referenced[indices[i]]) {
+      referenced[indices[i]] = true;
+      stats.vertices++;
+    }
+  }
+
+  stats.acmr = stats.triangles ? (float) stats.transformed / (float) stats.triangles : 0.0f;
+  stats.atvr = stats.vertices ? (float) stats.transformed / (float) stats.vertices : 0.0f;
+  return stats;
+}
+
+size_t deduplicate_vertices(uint32_t* indices, size_t index_count, const vertex_stream* streams, size_t streams_count, size_t vertex_count) {
+  auto hash = [&](uint32_t v) {
+    uint64_t result = 0;
+    for (size_t s = 0; s < streams_count; s++) {
+      result = utils::hash64(streams[s].data + v * streams[s].stride, streams[s].stride, result);
+    }
+    return (size_t) result;
+  };
+
+  auto equal = [&](uint32_t a, uint32_t b) {
+    for (size_t s = 0; s < streams_count; s++) {
+      if (std::memcmp(streams[s].data + a * streams[s].stride, streams[s].data + b * streams[s].stride, streams[s].stride) != 0)
+        return false;
+    }
+    return true;
+  };
+
+  // unique vertices are moved down in place, a slot is written only after its vertex was looked up
+  std::unordered_set<uint32_t, decltype(hash), decltype(equal)> unique(vertex_count, hash, equal);
+  std::vector<uint32_t> remap(vertex_count);
+  uint32_t count = 0;
+  for (uint32_t v = 0; v < vertex_count; v++) {
+    if (auto it = unique.find(v); it != unique.end()) {
+      remap[v] = *it;
+      continue;
+    }
+
+    if (count != v) {
+      for (size_t s = 0; s < streams_count; s++) {
+        std::memcpy(streams[s].data + count * streams[s].stride, streams[s].data + v * streams[s].stride, streams[s].stride);
+      }
+    }
+    unique.insert(count);
+    remap[v] = count++;
+  }
+
+  for (size_t i = 0; i < index_count; i++) {
+    indices[i] = remap[indices[i]];
+  }
+  return count;
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size) {
+  const size_t triangle_count = index_count / 3;
+  if (!triangle_count)
+    return;
+
+  // triangles using each vertex, live counts the ones not emitted yet
+  std::vector<uint32_t> live(vertex_count);
+  for (size_t i = 0; i < triangle_count * 3; i++) {
+    live[indices[i]]++;
+  }
+
+  std::vector<uint32_t> offsets(vertex_count + 1);
+  for (size_t v = 0; v < vertex_count; v++) {
+    offsets[v + 1] = offsets[v] + live[v];
+  }
+
+  std::vector<uint32_t> adjacency(triangle_count * 3);
+  std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < triangle_count * 3; i++) {
+    adjacency[cursors[indices[i]]++] = uint32_t(i / 3);
+  }
+
+  cache_simulation cache(vertex_count, cache_size);
+  std::vector<bool> emitted(triangle_count);
+  std::vector<uint32_t> dead_end;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> result;
+  result.reserve(triangle_count * 3);
+
+  size_t next_unused = 0;
+  uint32_t fanning = 0;
+  while (fanning != invalid_index) {
+    candidates.clear();
+    for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; k++) {
+      uint32_t triangle = adjacency[k];
+      if (emitted[triangle])
+        continue;
+
+      for (size_t corner = 0; corner < 3; corner++) {
+        uint32_t v = indices[triangle * 3 + corner];
+        result.push_back(v);
+        dead_end.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        cache.touch(v);
+      }
+      emitted[triangle] = true;
+    }
+
+    // the oldest cached candidate whose triangles all fit before it's evicted, fresh vertices otherwise
+    fanning = invalid_index;
+    int64_t best_priority = -1;
+    for (uint32_t v : candidates) {
+      if (!live[v])
+        continue;
+
+      int64_t age = cache.timestamp - cache.timestamps[v];
+      int64_t priority = age + 2 * live[v] <= cache_size ? age : 0;
+      if (priority > best_priority) {
+        best_priority = priority;
+        fanning = v;
+      }
+    }
+
+    while (fanning == invalid_index && !dead_end.empty()) {
+      uint32_t v = dead_end.back();
+      dead_end.pop_back();
+      if (live[v]) {
+        fanning = v;
+      }
+    }
+
+    for (; fanning == invalid_index && next_unused < vertex_count; next_unused++) {
+      if (live[next_unused]) {
+        fanning = uint32_t(next_unused);
+      }
+    }
+  }
+
+  std::copy(result.begin(), result.end(), indices);
+}
+
+void optimize_overdraw(uint32_t* indices, size_t index_count, const vertex_stream& positions, size_t vertex_count, uint32_t cache_size, float threshold) {
+  const size_t triangle_count = index_count / 3;
+  if (!triangle_count)
+    return;
+
+  cache_simulation cache(vertex_count, cache_size);
+
+  // triangle missing all its vertices starts a new patch of the surface
+  std::vector<size_t> patches;
+  for (size_t t = 0; t < triangle_count; t++) {
+    if (cache.touch(indices + t * 3) == 3 || t == 0) {
+      patches.push_back(t);
+    }
+  }
+
+  // patches are split where the cache efficiency of the piece reaches the threshold of the whole patch
+  std::vector<size_t> clusters;
+  for (size_t p = 0; p < patches.size(); p++) {
+    size_t first = patches[p];
+    size_t last = p + 1 < patches.size() ? patches[p + 1] : triangle_count;
+
+    cache.flush();
+    uint32_t patch_misses = 0;
+    for (size_t t = first; t < last; t++) {
+      patch_misses += cache.touch(indices + t * 3);
+    }
+    float cluster_threshold = threshold * (float) patch_misses / (float) (last - first);
+
+    clusters.push_back(first);
+    cache.flush();
+    uint32_t misses = 0;
+    uint32_t triangles = 0;
+    for (size_t t = first; t < last; t++) {
+      misses += cache.touch(indices + t * 3);
+      triangles++;
+      if ((float) misses / (float) triangles <= cluster_threshold) {
+        clusters.push_back(t + 1);
+        cache.flush();
+        misses = 0;
+        triangles = 0;
+      }
+    }
+
+    // the rest after the last split is usually small and inefficient, it's merged into the previous cluster
+    if (clusters.back() != first) {
+      clusters.pop_back();
+    }
+  }
+
+  vec3 mesh_centroid;
+  for (size_t i = 0; i < triangle_count * 3; i++) {
+    mesh_centroid = mesh_centroid + read_position(positions, indices[i]);
+  }
+  mesh_centroid = mesh_centroid / (float) (triangle_count * 3);
+
+  struct cluster {
+    size_t first;
+    size_t last;
+    float order;
+  };
+
+  std::vector<cluster> sorted(clusters.size());
+  for (size_t c = 0; c < clusters.size(); c++) {
+    size_t first = clusters[c];
+    size_t last = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+
+    float area = 0.0f;
+    vec3 centroid;
+    vec3 normal;
+    for (size_t t = first; t < last; t++) {
+      vec3 p0 = read_position(positions, indices[t * 3 + 0]);
+      vec3 p1 = read_position(positions, indices[t * 3 + 1]);
+      vec3 p2 = read_position(positions, indices[t * 3 + 2]);
+
+      vec3 triangle_normal = (p1 - p0) ^ (p2 - p0);
+      float triangle_area = vec3::length(triangle_normal);
+
+      centroid = centroid + (triangle_area / 3.0f) * (p0 + p1 + p2);
+      normal = normal + triangle_normal;
+      area += triangle_area;
+    }
+
+    centroid = area > 0.0f ? centroid / area : centroid;
+    float normal_length = vec3::length(normal);
+    normal = normal_length > 0.0f ? normal / normal_length : normal;
+
+    // clusters on the outside facing out are drawn first
+    sorted[c] = { first, last, (centroid - mesh_centroid) | normal };
+  }
+
+  std::stable_sort(sorted.begin(), sorted.end(), [](const cluster& a, const cluster& b) { return a.order > b.order; });
+
+  std::vector<uint32_t> result;
+  result.reserve(triangle_count * 3);
+  for (const cluster& c : sorted) {
+    result.insert(result.end(), indices + c.first * 3, indices + c.last * 3);
+  }
+  std::copy(result.begin(), result.end(), indices);
+}
+
+size_t optimize_vertex_fetch(uint32_t* indices, size_t index_count, const vertex_stream* streams, size_t streams_count, size_t vertex_count) {
+  std::vector<uint32_t> remap(vertex_count, invalid_index);
+  uint32_t count = 0;
+  for (size_t i = 0; i < index_count; i++) {
+    uint32_t& target = remap[indices[i]];
+    if (target == invalid_index) {
+      target = count++;
+    }
+    indices[i] = target;
+  }
+
+  std::vector<uint8_t> scratch;
+  for (size_t s = 0; s < streams_count; s++) {
+    const vertex_stream& stream = streams[s];
+    scratch.assign(stream.data, stream.data + vertex_count * stream.stride);
+    for (size_t v = 0; v < vertex_count; v++) {
+      if (remap[v] != invalid_index) {
+        std::memcpy(stream.data + remap[v] * stream.stride, scratch.data() + v * stream.stride, stream.stride);
+      }
+    }
+  }
+  return count;
+}
+
+mesh_optimize_stats optimize_mesh(uint32_t* indices, size_t index_count, const vertex_stream* streams, size_t streams_count, size_t& vertex_count, const mesh_optimize_settings& settings) {
+  mesh_optimize_stats stats;
+  stats.before = analyze_vertex_cache(indices, index_count, vertex_count, settings.cache_size);
+
+  if (settings.deduplicate) {
+    vertex_count = deduplicate_vertices(indices, index_count, streams, streams_count, vertex_count);
+  }
+
+  if (settings.vertex_cache) {
+    optimize_vertex_cache(indices, index_count, vertex_count, settings.cache_size);
+  }
+
+  if (settings.overdraw) {
+    optimize_overdraw(indices, index_count, streams[0], vertex_count, settings.cache_size, settings.overdraw_threshold);
+  }
+
+  if (settings.vertex_fetch) {
+    vertex_count = optimize_vertex_fetch(indices, index_count, streams, streams_count, vertex_count);
+  }
+
+  stats.after = analyze_vertex_cache(indices, index_count, vertex_count, settings.cache_size);
+  return stats;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Import-time processing of indexed triangle lists. Vertex attributes live in separate streams, vertex i of
+// a stream is at data + i * stride. Indices are rewritten in place.
+
+struct vertex_stream {
+  uint8_t* data;
+  size_t stride;
+};
+
+struct mesh_optimize_settings {
+  bool deduplicate = true;
+  bool vertex_cache = true;
+  bool overdraw = true;
+  // overdraw pass may make vertex cache misses per triangle this much worse
+  float overdraw_threshold = 1.05f;
+  bool vertex_fetch = true;
+  // entries of the FIFO post-transform cache the meshes are optimized and measured for
+  uint32_t cache_size = 16;
+};
+
+// Post-transform cache efficiency. ACMR is vertices transformed per triangle, from 3 down to about 0.5 for
+// big regular meshes. ATVR is vertices transformed per referenced vertex, 1 is the best possible.
+struct vertex_cache_stats {
+  size_t triangles = 0;
+  size_t vertices = 0;
+  size_t transformed = 0;
+  float acmr = 0.0f;
+  float atvr = 0.0f;
+};
+
+struct mesh_optimize_stats {
+  vertex_cache_stats before;
+  vertex_cache_stats after;
+};
+
+// Simulates FIFO cache of the given size over the triangle list.
+vertex_cache_stats analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size);
+
+// Merges vertices which are equal in every stream and compacts the streams, returns count of unique vertices.
+size_t deduplicate_vertices(uint32_t* indices, size_t index_count, const vertex_stream* streams, size_t streams_count, size_t vertex_count);
+
+// Reorders triangles for the post-transform cache, Tipsify by Sander, Nehab and Barczak.
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size);
+
+// Splits the cache optimized list into clusters and puts clusters facing away from the mesh center first,
+// they are likely to occlude the rest. Positions are three floats.
+void optimize_overdraw(uint32_t* indices, size_t index_count, const vertex_stream& positions, size_t vertex_count, uint32_t cache_size, float threshold);
+
+// Reorders vertices in order of first use so fetches go through memory sequentially, unused vertices are dropped.
+// Returns the new vertex count.
+size_t optimize_vertex_fetch(uint32_t* indices, size_t index_count, const vertex_stream* streams, size_t streams_count, size_t vertex_count);
+
+// Stages enabled in settings in the order above, the first stream holds positions. Vertex count is updated.
+mesh_optimize_stats optimize_mesh(uint32_t* indices, size_t index_count, const vertex_stream* streams, size_t streams_count, size_t& vertex_count, const mesh_optimize_settings& settings);
@@ -0,0 +1,249 @@
+#include "occlusion.h"
+#include "base/simd.h"
+#include "base/job_system.h"
+#include "core/components/transform_component.h"
+#include "core/components/mesh_component.h"
+
+#include <algorithm>
+
+static constexpr float min_clip_w = 1e-5f;
+static constexpr size_t occlusion_test_batch_size = 64;
+
+static vec4 project(const vec3& p, const mat4& m) {
+  return {
+      p.x * m.data[0][0] + p.y * m.data[1][0] + p.z * m.data[2][0] + m.data[3][0],
+      p.x * m.data[0][1] + p.y * m.data[1][1] + p.z * m.data[2][1] + m.data[3][1],
+      p.x * m.data[0][2] + p.y * m.data[1][2] + p.z * m.data[2][2] + m.data[3][2],
+      p.x * m.data[0][3] + p.y * m.data[1][3] + p.z * m.data[2][3] + m.data[3][3]
+  };
+}
+
+static vec4 to_screen(const vec4& clip, uint32_t width, uint32_t height) {
+  float inv_w = 1.0f / clip.w;
+  return {
+      (clip.x * inv_w * 0.5f + 0.5f) * (float) width,
+      (clip.y * inv_w * 0.5f + 0.5f) * (float) height,
+      clip.z * inv_w,
+      1.0f
+  };
+}
+
+// Screen space rectangle (x, y, z = nearest depth) of projected bounds, returns false if bounds cross near plane.
+static bool project_bounds(const aabb& bounds, const mat4& view_projection, uint32_t width, uint32_t height, vec3& min, vec3& max) {
+  min = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+  max = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+
+  for (uint32_t i = 0; i < 8; i++) {
+    vec3 corner {
+        i & 1u ? bounds.max.x : bounds.min.x,
+        i & 2u ? bounds.max.y : bounds.min.y,
+        i & 4u ? bounds.max.z : bounds.min.z
+    };
+
+    vec4 clip = project(corner, view_projection);
+    if (clip.w <= min_clip_w)
+      return false;
+
+    vec4 screen = to_screen(clip, width, height);
+    min = { std::min(min.x, screen.x), std::min(min.y, screen.y), std::min(min.z, screen.z) };
+    max = { std::max(max.x, screen.x), std::max(max.y, screen.y), std::max(max.z, screen.z) };
+  }
+  return true;
+}
+
+depth_buffer::depth_buffer(uint32_t width, uint32_t height)
+  : width_(width)
+  , height_(height)
+  , stride_((width + 3u) & ~3u)
+  , depth_(stride_ * height, 1.0f)
+{}
+
+void depth_buffer::clear() {
+  std::fill(depth_.begin(), depth_.end(), 1.0f);
+}
+
+void depth_buffer::rasterize(const occluder_mesh& mesh, const mat4& model_view_projection) {
+  std::vector<vec4> clip(mesh.positions.size());
+  for (size_t i = 0; i < mesh.positions.size(); i++) {
+    clip[i] = project(mesh.positions[i], model_view_projection);
+  }
+
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    const vec4& c0 = clip[mesh.indices[i + 0]];
+    const vec4& c1 = clip[mesh.indices[i + 1]];
+    const vec4& c2 = clip[mesh.indices[i + 2]];
+
+    // triangles crossing the near plane are skipped, it only makes occlusion less aggressive
+    if (c0.w <= min_clip_w || c1.w <= min_clip_w || c2.w <= min_clip_w)
+      continue;
+
+    rasterize_triangle(to_screen(c0, width_, height_), to_screen(c1, width_, height_), to_screen(c2, width_, height_));
+  }
+}
+
+void depth_buffer::rasterize_triangle(const vec4& v0, const vec4& in_v1, const vec4& in_v2) {
+  auto edge = [](const vec4& a, const vec4& b, float x, float y) {
+    return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+  };
+
+  float area = edge(v0, in_v1, in_v2.x, in_v2.y);
+  if (std::fabs(area) < 1e-8f)
+    return;
+
+  const vec4& v1 = area > 0.0f ? in_v1 : in_v2;
+  const vec4& v2 = area > 0.0f ? in_v2 : in_v1;
+  area = std::fabs(area);
+
+  int32_t min_x = std::max(0, (int32_t) std::floor(std::min({ v0.x, v1.x, v2.x })));
+  int32_t min_y = std::max(0, (int32_t) std::floor(std::min({ v0.y, v1.y, v2.y })));
+  int32_t max_x = std::min((int32_t) width_ - 1, (int32_t) std::ceil(std::max({ v0.x, v1.x, v2.x })));
+  int32_t max_y = std::min((int32_t) height_ - 1, (int32_t) std::ceil(std::max({ v0.y, v1.y, v2.y })));
+  if (min_x > max_x || min_y > max_y)
+    return;
+
+  // edge functions in form a * x + b * y + c
+  const float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x * v2.y - v1.y * v2.x;
+  const float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x * v0.y - v2.y * v0.x;
+  const float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x * v1.y - v0.y * v1.x;
+
+  const float inv_area = 1.0f / area;
+  const simd::float4 z0 = simd::set1(v0.z * inv_area);
+  const simd::float4 z1 = simd::set1(v1.z * inv_area);
+  const simd::float4 z2 = simd::set1(v2.z * inv_area);
+  const simd::float4 zero = simd::set1(0.0f);
+
+  const int32_t first_x = min_x & ~3;
+  alignas(16) float z[4];
+
+  for (int32_t y = min_y; y <= max_y; y++) {
+    const float py = (float) y + 0.5f;
+    float* row = depth_.data() + (size_t) y * stride_;
+
+    for (int32_t x = first_x; x <= max_x; x += 4) {
+      simd::float4 px = simd::set((float) x + 0.5f, (float) x + 1.5f, (float) x + 2.5f, (float) x + 3.5f);
+
+      simd::float4 w0 = simd::madd(simd::set1(a0), px, simd::set1(b0 * py + c0));
+      simd::float4 w1 = simd::madd(simd::set1(a1), px, simd::set1(b1 * py + c1));
+      simd::float4 w2 = simd::madd(simd::set1(a2), px, simd::set1(b2 * py + c2));
+
+      uint32_t outside = simd::less_mask(w0, zero) | simd::less_mask(w1, zero) | simd::less_mask(w2, zero);
+      uint32_t mask = ~outside & 0xFu;
+      if (!mask)
+        continue;
+
+      simd::float4 depth = simd::madd(w0, z0, simd::madd(w1, z1, simd::mul(w2, z2)));
+      simd::float4 current = simd::load(row + x);
+      simd::store(z, simd::min(depth, current));
+
+      for (int32_t i = 0; i < 4; i++) {
+        int32_t pixel = x + i;
+        if ((mask >> i) & 1u && pixel >= min_x && pixel <= max_x) {
+          row[pixel] = z[i];
+        }
+      }
+    }
+  }
+}
+
+bool depth_buffer::test(const aabb& world_bounds, const mat4& view_projection) const {
+  vec3 min, max;
+  if (!project_bounds(world_bounds, view_projection, width_, height_, min, max))
+    return true;
+
+  int32_t min_x = std::max(0, (int32_t) std::floor(min.x));
+  int32_t min_y = std::max(0, (int32_t) std::floor(min.y));
+  int32_t max_x = std::min((int32_t) width_ - 1, (int32_t) std::floor(max.x));
+  int32_t max_y = std::min((int32_t) height_ - 1, (int32_t) std::floor(max.y));
+  if (min_x > max_x || min_y > max_y)
+    return true;
+
+  const simd::float4 nearest = simd::set1(min.z);
+  const int32_t first_x = min_x & ~3;
+
+  for (int32_t y = min_y; y <= max_y; y++) {
+    const float* row = depth_.data() + (size_t) y * stride_;
+    for (int32_t x = first_x; x <= max_x; x += 4) {
+      // lanes where occluder is not closer than the box
+      uint32_t mask = ~simd::less_mask(simd::load(row + x), nearest) & 0xFu;
+      if (x < min_x) mask &= 0xFu << (min_x - x);
+      if (x + 3 > max_x) mask &= 0xFu >> (x + 3 - max_x);
+      if (mask)
+        return true;
+    }
+  }
+  return false;
+}
+
+uint32_t cull_occluded(
+    const mat4& view_projection,
+    const ecs::details::component_pool<transform_component>& transforms,
+    const ecs::details::component_pool<mesh_component>& meshes,
+    visibility_list& visible,
+    depth_buffer& buffer,
+    const occlusion_settings& settings,
+    job_system* jobs) {
+
+  struct occluder {
+    ecs::entity entity;
+    float area;
+  };
+
+  auto world_bounds = [&](ecs::entity e) {
+    const transform_component* transform = transforms.try_get(e);
+    const aabb& local = meshes.get(e).bounds;
+    return transform ? transform_bounds(local, (mat4) transform->world) : local;
+  };
+
+  std::vector<occluder> occluders;
+  for (ecs::entity e : visible) {
+    if (!meshes.get(e).occluder)
+      continue;
+
+    vec3 min, max;
+    if (!project_bounds(world_bounds(e), view_projection, buffer.width(), buffer.height(), min, max))
+      continue;
+
+    occluders.push_back({ e, (max.x - min.x) * (max.y - min.y) });
+  }
+
+  if (occluders.empty())
+    return 0;
+
+  size_t occluders_count = std::min<size_t>(occluders.size(), settings.max_occluders);
+  std::partial_sort(occluders.begin(), occluders.begin() + occluders_count, occluders.end(),
+                    [](const occluder& lhs, const occluder& rhs) { return lhs.area > rhs.area; });
+  occluders.resize(occluders_count);
+
+  buffer.clear();
+  for (const occluder& occluder : occluders) {
+    const transform_component* transform = transforms.try_get(occluder.entity);
+    mat4 model = transform ? (mat4) transform->world : mat4::identity();
+    buffer.rasterize(*meshes.get(occluder.entity).occluder, model * view_projection);
+  }
+
+  std::vector<uint8_t> result(visible.size(), 1);
+  auto test_range = [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      ecs::entity e = visible[i];
+      bool is_occluder = std::any_of(occluders.begin(), occluders.end(), [e](const occluder& o) { return o.entity == e; });
+      result[i] = is_occluder || !meshes.get(e).bounds_valid || buffer.test(world_bounds(e), view_projection);
+    }
+  };
+
+  if (jobs) {
+    jobs->parallel_for(visible.size(), occlusion_test_batch_size, test_range);
+  } else {
+    test_range(0, visible.size());
+  }
+
+  size_t size = 0;
+  for (size_t i = 0; i < visible.size(); i++) {
+    if (result[i]) {
+      visible[size++] = visible[i];
+    }
+  }
+
+  uint32_t occluded = visible.size() - size;
+  visible.resize(size);
+  return occluded;
+}
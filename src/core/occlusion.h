@@ -0,0 +1,53 @@
+#pragma once
+
+#include "base/math.h"
+#include "core/visibility.h"
+
+#include <vector>
+
+struct occluder_mesh {
+  std::vector<vec3> positions;
+  std::vector<uint32_t> indices;
+};
+
+// Low resolution CPU depth buffer. Stores the nearest occluder depth (clip z / w in [0, 1]) per pixel.
+class depth_buffer {
+ public:
+  depth_buffer(uint32_t width, uint32_t height);
+
+  void clear();
+
+  void rasterize(const occluder_mesh& mesh, const mat4& model_view_projection);
+
+  // Returns false if the box is completely hidden behind rasterized occluders.
+  [[nodiscard]] bool test(const aabb& world_bounds, const mat4& view_projection) const;
+
+  [[nodiscard]] uint32_t width() const { return width_; }
+  [[nodiscard]] uint32_t height() const { return height_; }
+  [[nodiscard]] const float* data() const { return depth_.data(); }
+
+ private:
+  void rasterize_triangle(const vec4& v0, const vec4& v1, const vec4& v2);
+
+ private:
+  uint32_t width_;
+  uint32_t height_;
+  uint32_t stride_;
+  std::vector<float> depth_;
+};
+
+struct occlusion_settings {
+  uint32_t max_occluders = 16;
+  // meshes with bounds diagonal at least this long are kept as occluders without explicit flag
+  float auto_occluder_size = 10.0f;
+  uint32_t max_occluder_triangles = 2048;
+};
+
+uint32_t cull_occluded(
+    const mat4& view_projection,
+    const ecs::details::component_pool<transform_component>& transforms,
+    const ecs::details::component_pool<mesh_component>& meshes,
+    visibility_list& visible,
+    depth_buffer& buffer,
+    const occlusion_settings& settings,
+    job_system* jobs = nullptr);
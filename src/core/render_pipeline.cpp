@@ -1,10 +1,13 @@
 #include "render_pipeline.h"
 #include "core/world.h"
 #include "core/components/transform_component.h"
+#include "core/components/mesh_component.h"
 #include "core/meta/interface_registry.h"
 #include "core/systems_registry.h"
+#include "base/job_system.h"
 
 static system_ptr<::interface_registry> g_interface_registry;
+static system_ptr<::job_system> g_job_system;
 
 void render_pipeline::render(
    uint32_t sort_key,
@@ -29,15 +32,41 @@ void render_pipeline::render(
 
   resolve_transforms(*viewer.world, viewer.world->root());
 
+  visibility_stats stats {};
+  visible_.clear();
+  if (auto mesh_pool = viewer.world->get_pool<mesh_component>(); mesh_pool && transform_pool) {
+    mat4 view_projection = viewer.camera.view * viewer.camera.projection;
+    stats = cull_frustum(
+        frustum::from_matrix(view_projection),
+        *transform_pool,
+        *mesh_pool,
+        visible_,
+        g_job_system.get()
+      );
+
+    stats.occluded = cull_occluded(
+        view_projection,
+        *transform_pool,
+        *mesh_pool,
+        visible_,
+        depth_buffer_,
+        occlusion_settings_,
+        g_job_system.get()
+      );
+    stats.visible -= stats.occluded;
+  }
+  stats_.push_back(stats);
+
   for (auto render_interface_id : render_interface_view) {
     auto& [id, render] = render_interface_view.get(render_interface_id);
     if (!viewer.world->has(id))
       continue;
 
-    render(view, transform_pool, viewer.world->pool_base(id), renderer, render_cmd_buf, resource_cmd_buf);
+    render(view, visible_, transform_pool, viewer.world->pool_base(id), renderer, render_cmd_buf, resource_cmd_buf);
   }
 }
 
 void init_render_pipeline(const systems_registry& registry) {
   g_interface_registry = registry.get<::interface_registry>();
+  g_job_system = registry.get<::job_system>();
 }
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include "core/meta/interface.h"
 #include "base/event.h"
 #include "viewer.h"
+#include "visibility.h"
+#include "occlusion.h"
 
 struct transform_component;
 
@@ -17,6 +19,7 @@ struct view {
 
 class render_interface
   : public interface<void(view&,
+                          const visibility_list&,
                           const ecs::details::component_pool<transform_component>*,
                           const ecs::details::component_pool_base*,
                           renderer&,
@@ -32,6 +35,8 @@ class render_pipeline {
     auto render_buffer = renderer.create_render_command_buffer();
     auto resource_buffer = renderer.create_resource_command_buffer();
 
+    stats_.clear();
+
     uint32_t i = 1;
     for (auto it = first; it != last; ++it) {
       uint32_t sort_key = i << 16u;
@@ -47,6 +52,12 @@ class render_pipeline {
 
   void render(uint32_t sort_key, const viewer& viewer, renderer& renderer, render_command_buffer& render_cmd_buf, resource_command_buffer& resource_cmd_buf);
 
+  // visibility counters of the last rendered frame, one entry per viewer in render order
+  [[nodiscard]] const std::vector<visibility_stats>& stats() const { return stats_; }
+
+  [[nodiscard]] const occlusion_settings& occlusion() const { return occlusion_settings_; }
+  void set_occlusion(const occlusion_settings& settings) { occlusion_settings_ = settings; }
+
   template<class ...Args>
   auto on_render_connect(Args&&...args) {
     return on_render_.connect(std::forward<Args>(args)...);
@@ -59,6 +70,10 @@ class render_pipeline {
 
  private:
   event<renderer&, render_command_buffer&, resource_command_buffer&> on_render_;
+  std::vector<visibility_stats> stats_;
+  visibility_list visible_;
+  depth_buffer depth_buffer_ { 256, 128 };
+  occlusion_settings occlusion_settings_;
 };
 
 void init_render_pipeline(const struct systems_registry&);
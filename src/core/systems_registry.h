@@ -87,6 +87,12 @@ class systems_registry {
     return handle<T> { static_cast<singleton<T>*>(singletons_.at(type_id).get()) };
   }
 
+  // Null if the singleton was never set or was removed.
+  template<class T>
+  T* find() const {
+    auto it = singletons_.find(meta::get_typeid<T>());
+    return it != singletons_.end() ? static_cast<singleton<T>*>(it->second.get())->ptr.get() : nullptr;
+  }
 
   template<class T, class F>
   F* add(std::unique_ptr<F> system) {
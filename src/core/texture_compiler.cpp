@@ -9,6 +9,7 @@
 
 #include <stb_image.h>
 #include <fstream>
+#include <vector>
 
 asset& create_texture_asset(const fs::path &source_path, asset_repository &repository, guid guid) {
   asset& texture = repository.create_asset(guid);
@@ -53,12 +54,13 @@ void compile_texture_asset(asset& texture, asset_repository& repository) {
 
   std::ifstream file(fs::to_project_path(source_path), std::ios::binary | std::ios::in);
 
+  // may run on a job thread with a small stack
   size_t buf_size = file.rdbuf()->pubseekoff(0, std::ios::end, std::ios::in);
-  char buffer[buf_size];
+  std::vector<char> buffer(buf_size);
   file.rdbuf()->pubseekpos(0, std::ios_base::in);
-  file.rdbuf()->sgetn(buffer, buf_size);
+  file.rdbuf()->sgetn(buffer.data(), (std::streamsize) buf_size);
 
-  compile_texture_buffer(reinterpret_cast<stbi_uc*>(buffer), buf_size, texture, repository);
+  compile_texture_buffer(reinterpret_cast<stbi_uc*>(buffer.data()), buf_size, texture, repository);
 }
 
 asset* create_texture_from_dcc_asset(
@@ -80,9 +82,7 @@ asset* create_texture_from_dcc_asset(
     texture_asset_guid = guid::generate();
   }
 
-  guid buffer_guid = guid::from_string(dcc_texture.at("buffer"));
-
-  asset* buffer_asset = repository.get_asset(buffer_guid);
+  asset* buffer_asset = repository.resolve(dcc_texture.at("buffer"));
   if (!buffer_asset) {
     logger::core::Warning("Creating texture from dcc asset at path {0} failed: couldn't find buffer for texture {1}", texture_path.c_str(), name);
     return nullptr;
@@ -113,11 +113,11 @@ asset* create_texture_from_dcc_asset(
   return &texture_asset;
 }
 
-void create_and_compile_texture_asset(const fs::path& source_path, const fs::path& path, asset_repository& repository, assets_filesystem& filesystem) {
+bool create_and_compile_texture_asset(const fs::path& source_path, const fs::path& path, asset_repository& repository, assets_filesystem& filesystem) {
   fs::path full_src_path(fs::to_project_path(source_path));
   if (!fs::exists(full_src_path)) {
     logger::core::Error("Couldn't create texture asset because source file on path {} doesn't exist.", source_path.c_str());
-    return;
+    return false;
   }
 
   guid guid;
@@ -134,4 +134,5 @@ void create_and_compile_texture_asset(const fs::path& source_path, const fs::pat
   compile_texture_asset(asset, repository);
 
   filesystem.save(repository, path, true);
+  return true;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <unordered_set>
 #include "platform/file_system.h"
 
@@ -12,7 +13,10 @@ struct guid;
 asset& create_texture_asset(const fs::path& source_path, asset_repository& repository, guid guid);
 void compile_texture_asset(asset& asset, asset_repository& repository);
 
-void create_and_compile_texture_asset(
+// Bump when compiled textures change, dependency graph rebuilds them then.
+constexpr uint32_t texture_compiler_version = 1;
+
+bool create_and_compile_texture_asset(
     const fs::path& source_path, const fs::path& path, asset_repository&, assets_filesystem&);
 
 asset* create_texture_from_dcc_asset(
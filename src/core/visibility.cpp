@@ -0,0 +1,145 @@
+#include "visibility.h"
+#include "base/simd.h"
+#include "base/job_system.h"
+#include "core/components/transform_component.h"
+#include "core/components/mesh_component.h"
+
+static constexpr size_t cull_batch_size = 256;
+
+frustum frustum::from_matrix(const mat4& m) {
+  const vec4 x = m.column(0);
+  const vec4 y = m.column(1);
+  const vec4 z = m.column(2);
+  const vec4 w = m.column(3);
+
+  auto add = [](const vec4& a, const vec4& b) { return vec4 { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w }; };
+  auto sub = [](const vec4& a, const vec4& b) { return vec4 { a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w }; };
+
+  return { {
+      add(w, x), // left
+      sub(w, x), // right
+      add(w, y), // bottom
+      sub(w, y), // top
+      z,         // near, clip depth is in [0, w]
+      sub(w, z), // far
+  } };
+}
+
+aabb transform_bounds(const aabb& bounds, const mat4& m) {
+  vec3 center = 0.5f * (bounds.min + bounds.max);
+  vec3 extents = 0.5f * (bounds.max - bounds.min);
+
+  vec3 world_center {
+      center.x * m.data[0][0] + center.y * m.data[1][0] + center.z * m.data[2][0] + m.data[3][0],
+      center.x * m.data[0][1] + center.y * m.data[1][1] + center.z * m.data[2][1] + m.data[3][1],
+      center.x * m.data[0][2] + center.y * m.data[1][2] + center.z * m.data[2][2] + m.data[3][2]
+  };
+
+  vec3 world_extents {
+      extents.x * std::fabs(m.data[0][0]) + extents.y * std::fabs(m.data[1][0]) + extents.z * std::fabs(m.data[2][0]),
+      extents.x * std::fabs(m.data[0][1]) + extents.y * std::fabs(m.data[1][1]) + extents.z * std::fabs(m.data[2][1]),
+      extents.x * std::fabs(m.data[0][2]) + extents.y * std::fabs(m.data[1][2]) + extents.z * std::fabs(m.data[2][2])
+  };
+
+  return { world_center - world_extents, world_center + world_extents };
+}
+
+// Tests up to cull_batch_size boxes stored as SoA (center, extents) against the frustum, 4 boxes at a time.
+static void test_boxes(const frustum& frustum, const float* soa, size_t count, size_t stride, uint8_t* result) {
+  const float* cx = soa + 0 * stride;
+  const float* cy = soa + 1 * stride;
+  const float* cz = soa + 2 * stride;
+  const float* ex = soa + 3 * stride;
+  const float* ey = soa + 4 * stride;
+  const float* ez = soa + 5 * stride;
+
+  const simd::float4 zero = simd::set1(0.0f);
+
+  for (size_t i = 0; i < count; i += 4) {
+    simd::float4 center_x = simd::load(cx + i);
+    simd::float4 center_y = simd::load(cy + i);
+    simd::float4 center_z = simd::load(cz + i);
+    simd::float4 extent_x = simd::load(ex + i);
+    simd::float4 extent_y = simd::load(ey + i);
+    simd::float4 extent_z = simd::load(ez + i);
+
+    uint32_t outside = 0;
+    for (const vec4& plane : frustum.planes) {
+      simd::float4 a = simd::set1(plane.x);
+      simd::float4 b = simd::set1(plane.y);
+      simd::float4 c = simd::set1(plane.z);
+      simd::float4 d = simd::set1(plane.w);
+
+      simd::float4 distance = simd::madd(a, center_x, simd::madd(b, center_y, simd::madd(c, center_z, d)));
+      simd::float4 radius = simd::madd(simd::abs(a), extent_x, simd::madd(simd::abs(b), extent_y, simd::mul(simd::abs(c), extent_z)));
+
+      outside |= simd::less_mask(simd::add(distance, radius), zero);
+    }
+
+    for (size_t j = 0; j < 4 && i + j < count; j++) {
+      result[i + j] = (outside >> j) & 1u ? 0 : 1;
+    }
+  }
+}
+
+visibility_stats cull_frustum(
+    const frustum& frustum,
+    const ecs::details::component_pool<transform_component>& transforms,
+    const ecs::details::component_pool<mesh_component>& meshes,
+    visibility_list& visible,
+    job_system* jobs) {
+
+  visible.clear();
+
+  const size_t count = meshes.size();
+  if (!count)
+    return {};
+
+  const ecs::entity* entities = &*meshes.ecs::details::component_pool_base::begin();
+  const mesh_component* components = &*meshes.begin();
+
+  std::vector<uint8_t> result(count);
+
+  auto cull_range = [&](size_t first, size_t last) {
+    // padded to a multiple of 4 so the tail can be loaded as a full vector
+    constexpr size_t stride = cull_batch_size;
+    float soa[6 * stride] = {};
+
+    for (size_t begin = first; begin < last; begin += stride) {
+      size_t size = std::min(stride, last - begin);
+      for (size_t i = 0; i < size; i++) {
+        const transform_component* transform = transforms.try_get(entities[begin + i]);
+        const aabb& local = components[begin + i].bounds;
+        aabb world = transform ? transform_bounds(local, (mat4) transform->world) : local;
+
+        soa[0 * stride + i] = 0.5f * (world.min.x + world.max.x);
+        soa[1 * stride + i] = 0.5f * (world.min.y + world.max.y);
+        soa[2 * stride + i] = 0.5f * (world.min.z + world.max.z);
+        soa[3 * stride + i] = 0.5f * (world.max.x - world.min.x);
+        soa[4 * stride + i] = 0.5f * (world.max.y - world.min.y);
+        soa[5 * stride + i] = 0.5f * (world.max.z - world.min.z);
+      }
+
+      test_boxes(frustum, soa, size, stride, result.data() + begin);
+
+      for (size_t i = 0; i < size; i++) {
+        result[begin + i] |= !components[begin + i].bounds_valid;
+      }
+    }
+  };
+
+  if (jobs) {
+    jobs->parallel_for(count, cull_batch_size, cull_range);
+  } else {
+    cull_range(0, count);
+  }
+
+  visible.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    if (result[i]) {
+      visible.push_back(entities[i]);
+    }
+  }
+
+  return { .tested = (uint32_t) count, .visible = (uint32_t) visible.size() };
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "base/math.h"
+#include "core/ecs.h"
+
+#include <vector>
+
+struct transform_component;
+struct mesh_component;
+class job_system;
+
+struct frustum {
+  // planes in form (a, b, c, d), point p is inside if a * p.x + b * p.y + c * p.z + d >= 0
+  vec4 planes[6];
+
+  static frustum from_matrix(const mat4& view_projection);
+};
+
+struct visibility_stats {
+  uint32_t tested = 0;
+  uint32_t visible = 0;
+  uint32_t occluded = 0;
+};
+
+using visibility_list = std::vector<ecs::entity>;
+
+aabb transform_bounds(const aabb& bounds, const mat4& matrix);
+
+visibility_stats cull_frustum(
+    const frustum& frustum,
+    const ecs::details::component_pool<transform_component>& transforms,
+    const ecs::details::component_pool<mesh_component>& meshes,
+    visibility_list& visible,
+    job_system* jobs = nullptr);
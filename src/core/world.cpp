@@ -6,8 +6,32 @@
 #include "systems_registry.h"
 #include "core/components/version_component.h"
 #include "core/meta/interface_registry.h"
+#include "core/asset_repository.h"
 
 static system_ptr<::interface_registry> interface_reg;
+static system_ptr<::asset_repository> repository;
+
+static void collect_buffers(const asset& entity_asset, std::vector<buffer_id>& buffers) {
+  const asset& components = entity_asset.at(symbols::components);
+  for (auto& [type_name, comp_asset] : components) {
+    if (!comp_asset.is_object())
+      continue;
+
+    meta::type type = meta::get_type(type_name.c_str());
+    if (!type.is_valid())
+      continue;
+
+    if (auto* prefetch = interface_reg->get_interface<prefetch_component_interface>(type.id())) {
+      prefetch->invoke(comp_asset, buffers);
+    }
+  }
+
+  if (entity_asset.contains(symbols::children)) {
+    for (const asset& child_asset : entity_asset.at(symbols::children).get<asset_array&>()) {
+      collect_buffers(child_asset, buffers);
+    }
+  }
+}
 
 void world::set_parent_impl(entity ent, entity parent, entity next) {
   auto& comp = get<link_component>(ent.id);
@@ -83,6 +107,28 @@ void world::destroy_entity(entity entity) {
   ecs::registry::destroy(entity.id);
 }
 
+void world::destroy_entities(const std::vector<entity>& entities) {
+  std::vector<ecs::entity> destroyed;
+  std::vector<entity> stack;
+
+  for (entity e : entities) {
+    set_parent_impl(e, entity::invalid(), entity::invalid());
+
+    stack.push_back(e);
+    while (!stack.empty()) {
+      entity curr = stack.back();
+      stack.pop_back();
+
+      destroyed.push_back(curr.id);
+      for (entity c = child(curr); c; c = next(c)) {
+        stack.push_back(c);
+      }
+    }
+  }
+
+  ecs::registry::destroy(destroyed.begin(), destroyed.end());
+}
+
 void world::set_parent(entity ent, entity parent, entity next) {
   transform world = world_transform(ent);
   set_parent_impl(ent, parent ? parent : root_, next);
@@ -109,7 +155,7 @@ void propagate_asset_changes(world& world, asset_repository& repository) {
     auto& version = version_view.get(e.id);
     asset* entity_asset = repository.get_asset(version.id);
 
-    const class asset& components = entity_asset->at("components");
+    const class asset& components = entity_asset->at(symbols::components);
     if (components.version() != version.components_version) {
       modified.push_back(e);
     }
@@ -132,14 +178,14 @@ void propagate_asset_changes(world& world, asset_repository& repository) {
     auto& version = version_view.get(e.id);
     asset* entity_asset = repository.get_asset(version.id);
 
-    const asset& components = entity_asset->at("components");
+    const asset& components = entity_asset->at(symbols::components);
     for (auto& [type_name, comp_asset] : components) {
       if (!comp_asset.is_object())
         continue;
 
       meta::type type = meta::get_type(type_name.c_str());
       if (!type.is_valid()) {
-        logger::core::Warning("Unknown component type {}", type_name);
+        logger::core::Warning("Unknown component type {}", type_name.str());
         continue;
       }
 
@@ -153,11 +199,43 @@ void propagate_asset_changes(world& world, asset_repository& repository) {
   }
 }
 
+void collect_asset_roots(const world& world, std::vector<asset_id>& roots) {
+  auto version_view = world.view<version_component>();
+  for (auto e : version_view) {
+    roots.push_back(version_view.get(e).id);
+  }
+}
+
+void remap_asset_ids(world& world, const asset_slot_remap& remap) {
+  auto version_view = world.view<version_component>();
+  for (auto e : version_view) {
+    auto& version = version_view.get(e);
+    version.id = remap(version.id);
+  }
+}
+
 entity world::load_from_asset(const asset& asset, entity parent, entity next) {
+  // reads of the whole hierarchy run in background while components are created
+  std::vector<buffer_id> buffers;
+  if (repository) {
+    collect_buffers(asset, buffers);
+    repository->prefetch(buffers.begin(), buffers.end());
+  }
+
+  entity result = load_from_asset_impl(asset, parent, next);
+
+  // components took what they needed, buffers they skipped aren't held until the asset is destroyed
+  if (repository) {
+    repository->cancel_prefetch(buffers.begin(), buffers.end());
+  }
+  return result;
+}
+
+entity world::load_from_asset_impl(const asset& asset, entity parent, entity next) {
   entity entity { ecs::registry::create() };
   ecs::registry::emplace<link_component>(entity.id);
 
-  const class asset& components = asset.at("components");
+  const class asset& components = asset.at(symbols::components);
   auto& version = ecs::registry::emplace<version_component>(entity.id);
   version.id = asset.id();
   version.version = asset.version();
@@ -169,7 +247,7 @@ entity world::load_from_asset(const asset& asset, entity parent, entity next) {
 
     meta::type type = meta::get_type(type_name.c_str());
     if (!type.is_valid()) {
-      logger::core::Warning("Unknown component type {}", type_name);
+      logger::core::Warning("Unknown component type {}", type_name.str());
       continue;
     }
 
@@ -180,18 +258,18 @@ entity world::load_from_asset(const asset& asset, entity parent, entity next) {
       if (load) {
         load->invoke(comp_asset, *this, entity);
       } else {
-        logger::core::Warning("Couldn't find component loader for type {}", type_name);
+        logger::core::Warning("Couldn't find component loader for type {}", type_name.str());
       }
     } else {
-      logger::core::Warning("Couldn't find component loader for type {}", type_name);
+      logger::core::Warning("Couldn't find component loader for type {}", type_name.str());
     }
   }
 
   set_parent(entity, parent, next);
 
-  if (asset.contains("children")) {
-    for (const ::asset& child_asset : asset.at("children").get<asset_array&>()) {
-      load_from_asset(child_asset, entity);
+  if (asset.contains(symbols::children)) {
+    for (const ::asset& child_asset : asset.at(symbols::children).get<asset_array&>()) {
+      load_from_asset_impl(child_asset, entity, ::entity::invalid());
     }
   }
   return entity;
@@ -289,6 +367,7 @@ bool world::is_child_of(entity ent, entity parent_candidate) const {
 
 void init_world(const systems_registry& registry) {
   interface_reg = registry.get<::interface_registry>();
+  repository = registry.get<::asset_repository>();
 }
 
 void resolve_transforms(const world& w, entity root) {
@@ -42,6 +42,7 @@ class world : public ecs::registry {
 
   entity create_entity(const transform& local = {}, entity parent = entity::invalid(), entity next = entity::invalid());
   void destroy_entity(entity entity);
+  void destroy_entities(const std::vector<entity>& entities);
 
   entity load_from_asset(const class asset& asset, entity parent = entity::invalid(), entity next = entity::invalid());
 
@@ -83,6 +84,7 @@ class world : public ecs::registry {
 
  private:
   void set_parent_impl(entity ent, entity parent, entity next);
+  entity load_from_asset_impl(const class asset& asset, entity parent, entity next);
   [[nodiscard]] const transform& resolve_transform(entity ent) const;
   void set_transform_dirty(entity ent, bool dirty) const;
 
@@ -99,4 +101,10 @@ void init_world(const struct systems_registry&);
 
 void propagate_asset_changes(world& world, class asset_repository& repository);
 
+// Assets entities were loaded from, roots for asset_repository::collect_garbage.
+void collect_asset_roots(const world& world, std::vector<struct asset_id>& roots);
+
+// Fixes up asset ids of entities after asset_repository::compact.
+void remap_asset_ids(world& world, const struct asset_slot_remap& remap);
+
 void resolve_transforms(const world&, entity);
\ No newline at end of file
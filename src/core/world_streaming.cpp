@@ -0,0 +1,281 @@
+#include "world_streaming.h"
+#include "core/viewer_registry.h"
+#include "core/assets_filesystem.h"
+#include "base/job_system.h"
+#include "base/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+static void preload_buffers(asset_repository& repository, const asset_value& value, std::vector<asset_buffer>& buffers) {
+  if (value.is_object()) {
+    for (auto& [_, sub] : static_cast<const asset&>(value)) {
+      preload_buffers(repository, sub, buffers);
+    }
+  } else if (value.is_array()) {
+    for (auto& sub : static_cast<const asset_array&>(value)) {
+      preload_buffers(repository, sub, buffers);
+    }
+  } else if (value.is_buffer()) {
+    buffers.push_back(repository.load_buffer(value));
+  }
+}
+
+world_streaming::world_streaming(world& world, asset_repository& repository, job_system& jobs, fs::path cells_path, const streaming_settings& settings)
+  : world_(world)
+  , repository_(repository)
+  , jobs_(jobs)
+  , cells_path_(std::move(cells_path))
+  , settings_(settings) {
+
+  fs::path fullpath = fs::to_project_path(cells_path_);
+  if (!fs::exists(fullpath)) {
+    logger::core::Warning("World cells directory {} doesn't exist.", fullpath.c_str());
+    return;
+  }
+
+  for (const auto& entry : fs::directory_iterator(fullpath)) {
+    if (entry.is_directory() || entry.path().extension() != ".entity")
+      continue;
+
+    cell_coord coord;
+    if (std::sscanf(entry.path().stem().c_str(), "%d_%d", &coord.x, &coord.z) == 2) {
+      available_.insert(coord);
+    }
+  }
+}
+
+void world_streaming::update(const viewer_registry& viewers) {
+  std::vector<vec3> positions;
+  for (const viewer& viewer : viewers) {
+    if (viewer.world == &world_) {
+      positions.push_back(mat4::inverse(viewer.camera.view).origin());
+    }
+  }
+
+  merge_cells();
+
+  // nobody looks at the world, keep loaded cells as is
+  if (positions.empty())
+    return;
+
+  unload_cells(positions);
+  request_cells(positions);
+}
+
+void world_streaming::unload_all() {
+  for (auto& [_, cell] : cells_) {
+    unload(cell);
+  }
+  cells_.clear();
+}
+
+size_t world_streaming::loaded_cells_count() const {
+  return std::count_if(cells_.begin(), cells_.end(), [](const auto& it) { return it.second.state == cell_state::LOADED; });
+}
+
+void world_streaming::collect_asset_roots(std::vector<asset_id>& roots) const {
+  for (const auto& [_, cell] : cells_) {
+    if (cell.root) {
+      roots.push_back(cell.root);
+    }
+  }
+}
+
+void world_streaming::remap_asset_ids(const asset_slot_remap& remap) {
+  for (auto& [_, cell] : cells_) {
+    if (cell.root) {
+      cell.root = remap(cell.root);
+    }
+  }
+}
+
+cell_coord world_streaming::to_cell(const vec3& position, float cell_size) {
+  return { (int32_t) std::floor(position.x / cell_size), (int32_t) std::floor(position.z / cell_size) };
+}
+
+fs::path world_streaming::cell_path(const fs::path& cells_path, cell_coord coord) {
+  return fs::append(cells_path, std::to_string(coord.x) + "_" + std::to_string(coord.z) + ".entity");
+}
+
+std::unique_ptr<world_streaming::staged_cell> world_streaming::load_cell(const fs::path& path) {
+  auto staged = std::make_unique<staged_cell>();
+
+  fs::path fullpath = fs::to_project_path(path);
+  asset* root = read_asset_file(staged->repository, fullpath);
+  if (!root) {
+    logger::core::Error("Couldn't load world cell {}", fullpath.c_str());
+    return staged;
+  }
+
+  staged->root = root;
+  preload_buffers(staged->repository, *root, staged->buffers);
+  return staged;
+}
+
+float world_streaming::distance(cell_coord coord, const std::vector<vec3>& positions) const {
+  const float half = 0.5f * settings_.cell_size;
+  const float center_x = ((float) coord.x + 0.5f) * settings_.cell_size;
+  const float center_z = ((float) coord.z + 0.5f) * settings_.cell_size;
+
+  float result = std::numeric_limits<float>::max();
+  for (const vec3& p : positions) {
+    float dx = std::max(std::fabs(p.x - center_x) - half, 0.0f);
+    float dz = std::max(std::fabs(p.z - center_z) - half, 0.0f);
+    result = std::min(result, std::sqrt(dx * dx + dz * dz));
+  }
+  return result;
+}
+
+void world_streaming::request_cells(const std::vector<vec3>& positions) {
+  size_t loading = std::count_if(cells_.begin(), cells_.end(), [](const auto& it) { return it.second.state == cell_state::LOADING; });
+  if (loading >= settings_.max_loading_cells)
+    return;
+
+  const auto radius = (int32_t) std::ceil(settings_.load_distance / settings_.cell_size);
+
+  std::vector<std::pair<float, cell_coord>> candidates;
+  for (const vec3& p : positions) {
+    cell_coord center = to_cell(p, settings_.cell_size);
+    for (int32_t z = center.z - radius; z <= center.z + radius; z++) {
+      for (int32_t x = center.x - radius; x <= center.x + radius; x++) {
+        cell_coord coord { x, z };
+        if (!available_.count(coord) || cells_.count(coord))
+          continue;
+
+        float dist = distance(coord, positions);
+        if (dist <= settings_.load_distance) {
+          candidates.emplace_back(dist, coord);
+        }
+      }
+    }
+  }
+
+  // nearest cells first, several viewers could request the same cell
+  std::sort(candidates.begin(), candidates.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+  for (auto& [_, coord] : candidates) {
+    if (loading >= settings_.max_loading_cells)
+      break;
+
+    if (cells_.count(coord))
+      continue;
+
+    cell& cell = cells_[coord];
+    cell.future = jobs_.submit([path = cell_path(cells_path_, coord)]() { return load_cell(path); });
+    loading++;
+  }
+}
+
+void world_streaming::merge_cells() {
+  uint32_t budget = settings_.merge_budget;
+
+  for (auto it = cells_.begin(); it != cells_.end() && budget;) {
+    cell& cell = it->second;
+
+    if (cell.state == cell_state::LOADING) {
+      if (cell.future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        ++it;
+        continue;
+      }
+
+      cell.staged = cell.future.get();
+      if (!cell.staged->root) {
+        available_.erase(it->first);
+        it = cells_.erase(it);
+        continue;
+      }
+
+      asset& root = repository_.import_asset(cell.staged->repository, *cell.staged->root);
+      cell.root = root.id();
+      cell.state = cell_state::MERGING;
+    }
+
+    if (cell.state == cell_state::MERGING) {
+      const asset& root = *repository_.get_asset(cell.root);
+      size_t count = root.contains("children") ? root.at("children").get<asset_array&>().size() : 0;
+
+      for (; cell.next_child < count && budget; budget--) {
+        const asset& child = root.at("children").get<asset_array&>().at(cell.next_child++);
+        cell.entities.push_back(world_.load_from_asset(child));
+      }
+
+      if (cell.next_child == count) {
+        cell.state = cell_state::LOADED;
+        cell.staged.reset();
+      }
+    }
+
+    ++it;
+  }
+}
+
+void world_streaming::unload_cells(const std::vector<vec3>& positions) {
+  for (auto it = cells_.begin(); it != cells_.end();) {
+    if (distance(it->first, positions) > settings_.unload_distance) {
+      // loading job result is dropped with its future
+      unload(it->second);
+      it = cells_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void world_streaming::unload(cell& cell) {
+  // preloaded buffer memory has to be released before buffers are destroyed
+  cell.staged.reset();
+
+  if (!cell.entities.empty()) {
+    world_.destroy_entities(cell.entities);
+    cell.entities.clear();
+  }
+
+  if (cell.root && repository_.get_asset(cell.root)) {
+    repository_.destroy_asset(cell.root);
+    cell.root = {};
+  }
+}
+
+void partition_world(asset_repository& repository, assets_filesystem& filesystem, const asset& world_asset, const fs::path& cells_path, float cell_size) {
+  if (!world_asset.contains("children"))
+    return;
+
+  std::unordered_map<cell_coord, std::vector<const asset*>> cells;
+  for (const asset& child : world_asset.at("children").get<asset_array&>()) {
+    vec3 position {};
+    if (child.contains("components")) {
+      const asset& components = child.at("components");
+      if (components.contains("transform_component") && components.at("transform_component").is_object()) {
+        const asset& transform = components.at("transform_component");
+        if (transform.contains("position")) {
+          position = transform.at("position").get<vec3>();
+        }
+      }
+    }
+
+    cells[world_streaming::to_cell(position, cell_size)].push_back(&child);
+  }
+
+  fs::assure(fs::to_project_path(cells_path));
+
+  for (auto& [coord, children] : cells) {
+    // staging repository keeps original guids of the entities
+    asset_repository staging;
+    asset& cell = staging.create_asset();
+    staging.set_value(cell, "__type", "entity");
+    staging.set_value(cell, "name", "cell_" + std::to_string(coord.x) + "_" + std::to_string(coord.z));
+    staging.set_value(cell, "components", staging.create_asset());
+
+    asset_array& array = staging.create_array();
+    for (const asset* child : children) {
+      staging.push_back(array, staging.import_asset(repository, *child));
+    }
+    staging.set_value(cell, "children", array);
+
+    fs::path path = world_streaming::cell_path(cells_path, coord);
+    staging.set_asset_path(cell.id(), path);
+    filesystem.save(staging, path, false);
+  }
+}
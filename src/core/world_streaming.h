@@ -0,0 +1,108 @@
+#pragma once
+
+#include "core/world.h"
+#include "core/asset_repository.h"
+#include "platform/file_system.h"
+
+#include <future>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class job_system;
+class viewer_registry;
+class assets_filesystem;
+
+struct cell_coord {
+  int32_t x = 0;
+  int32_t z = 0;
+
+  bool operator==(const cell_coord& other) const { return x == other.x && z == other.z; }
+  bool operator!=(const cell_coord& other) const { return !(*this == other); }
+};
+
+template<>
+struct std::hash<cell_coord> {
+  size_t operator()(const cell_coord& c) const noexcept {
+    return std::hash<uint64_t>()(((uint64_t) (uint32_t) c.x << 32u) | (uint32_t) c.z);
+  }
+};
+
+struct streaming_settings {
+  float cell_size = 64.0f;
+  float load_distance = 128.0f;
+  // bigger than load_distance so cells on the border are not reloaded every frame
+  float unload_distance = 192.0f;
+  uint32_t max_loading_cells = 4;
+  // top level entities instantiated into the world per update
+  uint32_t merge_budget = 32;
+};
+
+// Streams cells of a partitioned world around viewers. Each cell is an entity asset stored as
+// "<cells_path>/<x>_<z>.entity", its children are instantiated as top level entities of the world.
+// Files are read and parsed on the job system, merge into asset_repository and world happens in update().
+class world_streaming {
+ public:
+  world_streaming(world& world, asset_repository& repository, job_system& jobs, fs::path cells_path, const streaming_settings& settings = {});
+
+  world_streaming(const world_streaming&) = delete;
+  world_streaming& operator=(const world_streaming&) = delete;
+
+  void update(const viewer_registry& viewers);
+
+  void unload_all();
+
+  [[nodiscard]] size_t loaded_cells_count() const;
+
+  // Roots of cells merged into the repository, for asset_repository::collect_garbage and compact.
+  void collect_asset_roots(std::vector<asset_id>& roots) const;
+  void remap_asset_ids(const asset_slot_remap& remap);
+  [[nodiscard]] const streaming_settings& settings() const { return settings_; }
+
+  [[nodiscard]] static cell_coord to_cell(const vec3& position, float cell_size);
+  [[nodiscard]] static fs::path cell_path(const fs::path& cells_path, cell_coord coord);
+
+ private:
+  struct staged_cell {
+    asset_repository repository;
+    asset* root = nullptr;
+    std::vector<asset_buffer> buffers; // keeps preloaded buffer memory alive until entities are loaded
+  };
+
+  enum class cell_state {
+    LOADING,
+    MERGING,
+    LOADED
+  };
+
+  struct cell {
+    cell_state state = cell_state::LOADING;
+    std::future<std::unique_ptr<staged_cell>> future;
+    std::unique_ptr<staged_cell> staged;
+    asset_id root = {};
+    size_t next_child = 0;
+    std::vector<entity> entities;
+  };
+
+  static std::unique_ptr<staged_cell> load_cell(const fs::path& path);
+
+  void request_cells(const std::vector<vec3>& positions);
+  void merge_cells();
+  void unload_cells(const std::vector<vec3>& positions);
+  void unload(cell& cell);
+  [[nodiscard]] float distance(cell_coord coord, const std::vector<vec3>& positions) const;
+
+ private:
+  world& world_;
+  asset_repository& repository_;
+  job_system& jobs_;
+  fs::path cells_path_;
+  streaming_settings settings_;
+
+  std::unordered_set<cell_coord> available_;
+  std::unordered_map<cell_coord, cell> cells_;
+};
+
+// Splits top level children of the world asset into cell entity assets by their position and saves them to cells_path.
+void partition_world(asset_repository& repository, assets_filesystem& filesystem, const asset& world_asset, const fs::path& cells_path, float cell_size);
@@ -28,17 +28,28 @@
 #include <core/dcc_asset.h>
 #include <editor/editor_tab_manager.h>
 #include "core/asset_repository.h"
+#include "base/job_system.h"
+#include "core/asset_dependencies.h"
+#include "core/asset_bundle.h"
+#include "core/asset_index.h"
 
 int main(int argc, char* argv[]) {
   fs::project_path(argv[1]);
 
   logger::init(fs::project_path().append("log").c_str());
 
+  // buffers are read in background while entities are loaded, jobs have to outlive the repository
+  auto io_job_system = std::make_unique<::job_system>(2);
+
   systems_registry registry;
 
   auto interface_registry = registry.set<::interface_registry>(std::make_unique<::interface_registry>());
+  auto job_system = registry.set<::job_system>(std::make_unique<::job_system>());
   auto assets_repository = registry.set<::asset_repository>(std::make_unique<::asset_repository>());
+  assets_repository->set_io_jobs(io_job_system.get());
+  assets_repository->set_buffer_memory_budget(size_t(1) << 30);
   auto assets_filesystem = registry.set<::assets_filesystem>(std::make_unique<::assets_filesystem>());
+  assets_filesystem->set_buffer_compression(buffer_compression::BLOCK);
   auto renderer = registry.set<::renderer>(std::make_unique<::renderer>(render_context_opengl::create));
 
   auto shader_compiler = shader_compiler_opengl::create();
@@ -50,32 +61,104 @@ int main(int argc, char* argv[]) {
   auto gui_renderer = registry.set<::gui>(std::make_unique<::gui>(registry));
   auto editor_tab_manager = registry.set<::editor_tab_manager>(std::make_unique<::editor_tab_manager>(registry));
 
-  load_assets(*assets_filesystem, *assets_repository, { ".entity", ".shader", ".schema", ".texture", ".dcc_asset" });
-
-  // TODO
-  create_and_compile_texture_asset("assets/textures/container.jpg", "assets/textures/container.texture", *assets_repository, *assets_filesystem);
-  create_and_compile_texture_asset("assets/textures/seal.png", "assets/textures/seal.texture", *assets_repository, *assets_filesystem);
+  // only files changed since the last run are parsed, assets are loaded on first lookup
+  asset_index index;
+  fs::path index_path = fs::to_project_path(".ubik/assets.json");
+  index.load(index_path);
+  index.update({ ".entity", ".shader", ".schema", ".texture", ".dcc_asset" }, job_system.get());
+  index.save(index_path);
+  index.register_assets(*assets_repository);
+
+  asset_dependency_graph dependencies;
+  fs::path dependencies_path = fs::to_project_path(".ubik/dependencies.json");
+  dependencies.load(dependencies_path);
+
+  for (const char* name : { "container.jpg", "seal.png" }) {
+    fs::path source_path = fs::append("assets/textures", name);
+    fs::path texture_path = fs::path(source_path).replace_extension(".texture");
+
+    asset_build_inputs inputs;
+    inputs.importer = "texture";
+    inputs.importer_version = texture_compiler_version;
+    inputs.sources = { source_path };
+
+    dependencies.add(texture_path, std::move(inputs), [source_path, texture_path, &assets_repository, &assets_filesystem]() {
+      return create_and_compile_texture_asset(source_path, texture_path, *assets_repository, *assets_filesystem);
+    });
+  }
 
-  compile_shaders(*assets_repository, *assets_filesystem);
+  add_shaders(dependencies, *assets_repository, *assets_filesystem);
 
+  constexpr const char* backpack_source_path = "assets/scenes/backpack/backpack.obj";
   constexpr const char* backpack_asset_path = "assets/scenes/backpack.dcc_asset";
   constexpr const char* backpack_entity_path = "assets/scenes/backpack.entity";
-  if (asset_id id = create_dcc_asset(fs::to_project_path("assets/scenes/backpack/backpack.obj"), *assets_repository)) {
+
+  asset_build_inputs backpack_asset_inputs;
+  backpack_asset_inputs.importer = "dcc_asset";
+  backpack_asset_inputs.importer_version = dcc_importer_version;
+  backpack_asset_inputs.sources = { backpack_source_path };
+
+  // settings edited in the .dcc_asset survive its reimport and trigger one when they change
+  dcc_import_settings backpack_settings = read_dcc_import_settings(assets_repository->get_asset_by_path(backpack_asset_path));
+  backpack_asset_inputs.settings_hash = hash_dcc_import_settings(backpack_settings);
+
+  dependencies.add(backpack_asset_path, std::move(backpack_asset_inputs), [&, backpack_settings]() {
+    asset_id id = create_dcc_asset(fs::to_project_path(backpack_source_path), *assets_repository, backpack_settings, job_system.get());
+    if (!id)
+      return false;
+
     if (auto* asset = assets_repository->get_asset_by_path(backpack_asset_path)) {
       assets_repository->destroy_asset(asset->id());
     }
 
     assets_repository->set_asset_path(id, backpack_asset_path);
     assets_filesystem->save(*assets_repository, backpack_asset_path, true);
-  }
+    return true;
+  });
+
+  asset_build_inputs backpack_entity_inputs;
+  backpack_entity_inputs.importer = "dcc_entity";
+  backpack_entity_inputs.importer_version = dcc_importer_version;
+  backpack_entity_inputs.dependencies = { backpack_asset_path };
+
+  dependencies.add(backpack_entity_path, std::move(backpack_entity_inputs), [&]() {
+    auto* dcc_asset = assets_repository->get_asset_by_path(backpack_asset_path);
+    if (!dcc_asset)
+      return false;
+
+    asset_id id = create_entity_from_dcc_asset(*dcc_asset, *assets_repository, *assets_filesystem);
+    if (!id)
+      return false;
 
-  if (asset_id id = create_entity_from_dcc_asset(*assets_repository->get_asset_by_path(backpack_asset_path), *assets_repository, *assets_filesystem)) {
     if (auto* asset = assets_repository->get_asset_by_path(backpack_entity_path)) {
       assets_repository->destroy_asset(asset->id());
     }
 
     assets_repository->set_asset_path(id, backpack_entity_path);
     assets_filesystem->save(*assets_repository, backpack_entity_path, true);
+    return true;
+  });
+
+  dependencies.build(job_system.get());
+  dependencies.save(dependencies_path);
+
+  // rebuilt assets replaced whole trees, nothing holds asset ids yet so slots are packed right away
+  assets_repository->collect_garbage();
+  assets_repository->compact();
+  assets_filesystem->collect_garbage(io_job_system.get());
+
+  // experimental <project> <bundle> packs the project assets for runtime builds
+  if (argc > 2) {
+    index.update({ ".entity", ".shader", ".schema", ".texture", ".dcc_asset" }, job_system.get());
+    index.save(index_path);
+    index.register_assets(*assets_repository);
+
+    std::vector<fs::path> paths;
+    for (const auto& [path, entry] : index.entries()) {
+      paths.push_back(path);
+    }
+    std::sort(paths.begin(), paths.end());
+    return build_asset_bundle(*assets_repository, paths, argv[2]) ? 0 : 1;
   }
 
   schema_builder(meta::get_typeid<vec3>())
@@ -1,4 +1,4 @@
-#include <base/crc32.h>
+#include <base/hash.h>
 #include "shader_repository.h"
 
 #include "gfx/shader.h"
@@ -6,9 +6,13 @@
 #include "core/assets_filesystem.h"
 #include "gfx/shader_compiler.h"
 #include "core/asset_repository.h"
+#include "core/asset_dependencies.h"
 #include "base/log.h"
+#include "platform/os.h"
 
 #include <fstream>
+#include <functional>
+#include <vector>
 
 shader_compile_result shader_repository::compile_stage(
     const asset_buffer& buffer, shader_stage::type stage) {
@@ -33,12 +37,19 @@ shader *shader_repository::lookup(std::string_view name) {
   return shaders_.at(it->second).get();
 }
 
-uint32_t get_hash(const fs::path& path) {
+uint64_t get_hash(const fs::path& path) {
+  // has to match asset_repository::buffer_hash of the buffer made from the same file
+  size_t size = fs::file_size(path);
+  if (auto data = os::map_file(path, 0, size))
+    return utils::hash64(data.get(), size);
+
   std::ifstream file(path, std::ios::binary | std::ios::in);
-  return utils::crc32(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  std::vector<char> data(size);
+  file.read(data.data(), (std::streamsize) size);
+  return utils::hash64(data.data(), data.size());
 }
 
-void compile_shaders(asset_repository& repository, assets_filesystem& assets) {
+static void for_each_shader(const std::function<void(const fs::path&)>& func) {
   for (auto it = fs::recursive_directory_iterator(fs::project_path()); it != fs::recursive_directory_iterator(); it++) {
     if (it->is_directory())
       continue;
@@ -47,17 +58,31 @@ void compile_shaders(asset_repository& repository, assets_filesystem& assets) {
       continue;
 
     fs::path p = it->path().lexically_relative(fs::project_path());
-    compile_shader(
-        p.replace_extension(""),
-        repository,
-        assets
-    );
+    func(p.replace_extension(""));
   }
 }
 
-void compile_shader(const fs::path& path, asset_repository& assets, assets_filesystem& assets_filesystem) {
-  fs::path vert_path { fs::to_project_path(fs::concat(path, ".vert")) };
-  fs::path frag_path { fs::to_project_path(fs::concat(path, ".frag")) };
+void compile_shaders(asset_repository& repository, assets_filesystem& assets) {
+  for_each_shader([&](const fs::path& path) {
+    compile_shader(path, repository, assets);
+  });
+}
+
+void add_shaders(asset_dependency_graph& graph, asset_repository& repository, assets_filesystem& assets) {
+  for_each_shader([&](const fs::path& path) {
+    asset_build_inputs inputs;
+    inputs.importer = "shader";
+    inputs.importer_version = shader_importer_version;
+    inputs.sources = { fs::concat(path, ".vert"), fs::concat(path, ".frag") };
+
+    graph.add(fs::concat(path, ".shader"), std::move(inputs), [path, &repository, &assets]() {
+      build_shader(path, repository, assets);
+      return true;
+    });
+  });
+}
+
+static asset& get_shader_asset(const fs::path& path, asset_repository& assets) {
   fs::path asset_path { fs::concat(path, ".shader") };
 
   auto asset = assets.get_asset_by_path(asset_path);
@@ -70,26 +95,45 @@ void compile_shader(const fs::path& path, asset_repository& assets, assets_files
     assets.set_value(*asset, "name", path.filename());
   }
 
+  return *asset;
+}
+
+void build_shader(const fs::path& path, asset_repository& assets, assets_filesystem& assets_filesystem) {
+  fs::path vert_path { fs::to_project_path(fs::concat(path, ".vert")) };
+  fs::path frag_path { fs::to_project_path(fs::concat(path, ".frag")) };
+  fs::path asset_path { fs::concat(path, ".shader") };
+
+  asset& asset = get_shader_asset(path, assets);
+
+  logger::core::Info("Compile shader {}", path.c_str());
+
+  assets.set_value(asset, "vertex_source", assets.create_buffer_from_file(vert_path, 0, 0));
+  assets.set_value(asset, "fragment_source", assets.create_buffer_from_file(frag_path, 0, 0));
+
+  assets_filesystem.save(assets, asset_path, true);
+}
+
+void compile_shader(const fs::path& path, asset_repository& assets, assets_filesystem& assets_filesystem) {
+  fs::path vert_path { fs::to_project_path(fs::concat(path, ".vert")) };
+  fs::path frag_path { fs::to_project_path(fs::concat(path, ".frag")) };
+
+  const asset& asset = get_shader_asset(path, assets);
+
   bool need_compile = false;
-  if (auto it_vert = asset->find("vertex_source"), it_frag = asset->find("fragment_source");
-      it_vert != asset->end() && it_frag != asset->end() &&
+  if (auto it_vert = asset.find("vertex_source"), it_frag = asset.find("fragment_source");
+      it_vert != asset.end() && it_frag != asset.end() &&
       it_vert->second.is_buffer() && it_frag->second.is_buffer()) {
 
     auto vert_buffer = static_cast<buffer_id>(it_vert->second);
     auto frag_buffer = static_cast<buffer_id>(it_frag->second);
 
-    need_compile |= assets.buffer_hash(vert_buffer) != get_hash(fs::to_project_path(vert_path));
-    need_compile |= assets.buffer_hash(frag_buffer) != get_hash(fs::to_project_path(frag_path));
+    need_compile |= assets.buffer_hash(vert_buffer) != get_hash(vert_path);
+    need_compile |= assets.buffer_hash(frag_buffer) != get_hash(frag_path);
   } else {
     need_compile = true;
   }
 
   if (need_compile) {
-    logger::core::Info("Compile shader {}", path.c_str());
-
-    assets.set_value(*asset, "vertex_source", assets.create_buffer_from_file(vert_path, 0, 0));
-    assets.set_value(*asset, "fragment_source", assets.create_buffer_from_file(frag_path, 0, 0));
-
-    assets_filesystem.save(assets, asset_path, true);
+    build_shader(path, assets, assets_filesystem);
   }
 }
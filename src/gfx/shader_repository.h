@@ -6,6 +6,7 @@
 #include "platform/file_system.h"
 
 struct assets_filesystem;
+class asset_dependency_graph;
 struct asset_repository;
 struct shader_compiler;
 struct asset_buffer;
@@ -34,5 +35,15 @@ class shader_repository {
   shader_compiler* compiler_;
 };
 
+// Bump when shader assets change, dependency graph rebuilds them then.
+constexpr uint32_t shader_importer_version = 1;
+
+// Compiles shaders whose sources differ from the buffers of loaded assets.
 void compile_shaders(asset_repository&, assets_filesystem&);
 void compile_shader(const fs::path& path, asset_repository&, assets_filesystem&);
+
+// Compiles shader unconditionally.
+void build_shader(const fs::path& path, asset_repository&, assets_filesystem&);
+
+// Adds node for every shader in the project, compiled only when its sources change.
+void add_shaders(asset_dependency_graph&, asset_repository&, assets_filesystem&);
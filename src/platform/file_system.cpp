@@ -1,10 +1,55 @@
 #include "file_system.h"
+#include "platform.h"
 #include "base/log.h"
 
+#include <atomic>
 #include <fstream>
 
+#if defined(UBIK_LINUX) || defined(UBIK_OSX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace fs {
 
+bool sync_file(const path& p) {
+#if defined(UBIK_LINUX) || defined(UBIK_OSX)
+  int fd = open(p.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+  bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+#else
+  // files and directories aren't synced on Windows
+  (void) p;
+  return true;
+#endif
+}
+
+bool replace_file(const path& tmp, const path& p) {
+  std::error_code error;
+  if (!sync_file(tmp)) {
+    logger::core::Error("Couldn't sync file {}", tmp.c_str());
+    fs::remove(tmp, error);
+    return false;
+  }
+
+  fs::rename(tmp, p, error);
+  if (error) {
+    logger::core::Error("Couldn't replace file {0} {1}", p.c_str(), error.message());
+    fs::remove(tmp, error);
+    return false;
+  }
+
+  // the rename itself is durable once the directory entry is synced
+  path parent = p.has_parent_path() ? p.parent_path() : path(".");
+  if (!sync_file(parent)) {
+    logger::core::Warning("Couldn't sync directory {}", parent.c_str());
+  }
+  return true;
+}
+
 path concat(const path& lhs, const char* rhs) {
   path result {lhs};
   result.concat(rhs);
@@ -51,6 +96,27 @@ std::ifstream read_file(const path &path, std::ios::openmode mode) {
   return read_file(path.c_str(), mode);
 }
 
+bool write_file(const path& p, const void* data, size_t size) {
+  // concurrent writers of the same file don't share the temporary one
+  static std::atomic<uint32_t> counter = 0;
+  path tmp = concat(p, ("." + std::to_string(counter++) + ".tmp").c_str());
+
+  std::error_code error;
+  {
+    std::ofstream stream(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+    stream.write(static_cast<const char*>(data), (std::streamsize) size);
+    stream.flush();
+    stream.close();
+    if (!stream) {
+      logger::core::Error("Couldn't write file {}", tmp.c_str());
+      fs::remove(tmp, error);
+      return false;
+    }
+  }
+
+  return replace_file(tmp, p);
+}
+
 void assure(const path& path) {
   if (!fs::exists(path)) {
     fs::create_directory(path);
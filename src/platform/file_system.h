@@ -11,6 +11,16 @@ void assure(const fs::path&);
 std::ifstream read_file(const fs::path &path, std::ios::openmode mode = std::ios::in | std::ios::binary);
 std::ifstream read_file(const char* path, std::ios::openmode mode = std::ios::in | std::ios::binary);
 
+// Writes to a temporary file next to path and renames it over path, readers see either old or new contents.
+bool write_file(const fs::path& path, const void* data, size_t size);
+
+// Syncs the written temporary file, renames it over path and syncs the directory, so after a crash path has
+// either old or new contents. Temporary file is removed on failure.
+bool replace_file(const fs::path& tmp, const fs::path& path);
+
+// Flushes file or directory contents to the disk.
+bool sync_file(const fs::path& path);
+
 path concat(const path&, const path&);
 path concat(const path&, const char*);
 
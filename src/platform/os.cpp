@@ -1,21 +1,9 @@
 #include "os.h"
+#include "platform.h"
 #include <dlfcn.h>
 #include <cstring>
 #include <iostream>
 
-#if defined(_WIN32)
-#define UBIK_WINDOWS
-
-#elif defined(__linux__)
-#define UBIK_LINUX
-
-#elif defined(__APPLE__)
-#define UBIK_OSX
-
-#else
-#error "Unknown/unsupported platform"
-#endif // UBIK_WINDOWS || UBIK_LINUX || UBIK_OSX
-
 namespace os {
 
 void* load_lib(const char* path) {
@@ -69,6 +57,32 @@ int64_t get_timestamp(const fs::path& path) {
 
 }
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+std::shared_ptr<uint8_t> map_file(const fs::path& path, size_t offset, size_t size) {
+  if (!size)
+    return nullptr;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return nullptr;
+
+  static const auto page_size = (size_t) sysconf(_SC_PAGESIZE);
+  const size_t aligned_offset = offset & ~(page_size - 1);
+  const size_t delta = offset - aligned_offset;
+  const size_t length = size + delta;
+
+  void* ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, (off_t) aligned_offset);
+  close(fd);
+
+  if (ptr == MAP_FAILED)
+    return nullptr;
+
+  return { static_cast<uint8_t*>(ptr) + delta, [ptr, length](uint8_t*) { munmap(ptr, length); } };
+}
+
 #endif
 
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "platform/file_system.h"
+#include <memory>
 #include <string>
 
 namespace os {
@@ -15,6 +16,10 @@ void* get_symbol(void*, const char*);
 
 int64_t get_timestamp(const fs::path&);
 
+// Maps [offset, offset + size) of the file read-only, the mapping is released with the last reference.
+// Returns null if the file can't be mapped.
+std::shared_ptr<uint8_t> map_file(const fs::path& path, size_t offset, size_t size);
+
 };
 
 
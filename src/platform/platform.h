@@ -0,0 +1,14 @@
+#pragma once
+
+#if defined(_WIN32)
+#define UBIK_WINDOWS
+
+#elif defined(__linux__)
+#define UBIK_LINUX
+
+#elif defined(__APPLE__)
+#define UBIK_OSX
+
+#else
+#error "Unknown/unsupported platform"
+#endif // UBIK_WINDOWS || UBIK_LINUX || UBIK_OSX
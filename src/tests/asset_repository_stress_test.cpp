@@ -0,0 +1,199 @@
+#include "core/asset_repository.h"
+#include "base/log.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Readers go through read(), snapshot() and plain lookups while one writer keeps changing the same assets.
+// Every change of a root is one batch, so readers have to see each root in a consistent state: "value",
+// "mirror"/"value", every item of "items" and every byte of "data" are equal.
+
+namespace {
+
+constexpr size_t roots_count = 8;
+constexpr size_t items_count = 16;
+constexpr uint32_t buffer_size = 256;
+
+struct root_info {
+  asset_id id;
+  guid asset_guid;
+  fs::path path;
+};
+
+std::atomic<uint64_t> failures { 0 };
+
+void fail(const char* what, int64_t value, int64_t expected) {
+  if (failures++ < 16) {
+    std::printf("FAILED %s: %lld, expected %lld\n", what, (long long) value, (long long) expected);
+  }
+}
+
+// Returns the value the root holds, reports every part which doesn't match it.
+int64_t check_root(const asset& root, const std::function<asset_buffer(buffer_id)>& load_buffer) {
+  auto value = root.at("value").get<int64_t>();
+
+  auto mirror = root.at("mirror").get<const asset&>().at("value").get<int64_t>();
+  if (mirror != value) {
+    fail("mirror", mirror, value);
+  }
+
+  const auto& items = root.at("items").get<const asset_array&>();
+  if (items.size() != items_count) {
+    fail("items count", (int64_t) items.size(), items_count);
+  }
+  for (const asset_value& item : items) {
+    if (item.get<int64_t>() != value) {
+      fail("item", item.get<int64_t>(), value);
+    }
+  }
+
+  asset_buffer data = load_buffer(root.at("data").get<buffer_id>());
+  for (size_t i = 0; i < data.size(); i++) {
+    if (data.data()[i] != (uint8_t) value) {
+      fail("buffer byte", data.data()[i], (uint8_t) value);
+      break;
+    }
+  }
+  return value;
+}
+
+void write_root(asset_repository& rep, asset& root, int64_t value) {
+  asset_batch batch(rep);
+  rep.set_value(root, "value", asset_value(value));
+
+  // replaced object and its slots go back to the pools
+  asset& mirror = rep.create_asset();
+  rep.set_value(mirror, "value", asset_value(value));
+  rep.set_value(root, "mirror", mirror);
+
+  array_id items = root.at("items").get<const asset_array&>().id();
+  for (size_t i = 0; i < items_count; i++) {
+    rep.pop_back(items);
+  }
+  for (size_t i = 0; i < items_count; i++) {
+    rep.push_back(items, asset_value(value));
+  }
+
+  std::vector<uint8_t> data(buffer_size, (uint8_t) value);
+  rep.update_buffer(root.at("data").get<buffer_id>(), 0, data.data(), buffer_size);
+}
+
+}
+
+// Usage: asset_repository_stress_test [seconds] [readers]
+int main(int argc, char** argv) {
+  const double seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+  const size_t readers_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(4u, std::thread::hardware_concurrency());
+
+  logger::init("asset_repository_stress_test.log");
+
+  asset_repository rep;
+  std::vector<root_info> roots;
+  for (size_t i = 0; i < roots_count; i++) {
+    asset& root = rep.create_asset();
+    asset& mirror = rep.create_asset();
+    asset_array& items = rep.create_array();
+    rep.set_value(root, "value", asset_value(int64_t(0)));
+    rep.set_value(mirror, "value", asset_value(int64_t(0)));
+    rep.set_value(root, "mirror", mirror);
+    for (size_t j = 0; j < items_count; j++) {
+      rep.push_back(items, asset_value(int64_t(0)));
+    }
+    rep.set_value(root, "items", items);
+    rep.set_value(root, "data", rep.create_buffer(buffer_size));
+
+    fs::path path = "stress/" + std::to_string(i) + ".entity";
+    rep.set_asset_path(root.id(), path);
+    roots.push_back({ root.id(), rep.get_guid(root), path });
+  }
+
+  // mutating under a shared lock has to fail instead of deadlocking
+  bool threw = rep.read([&]() {
+    try {
+      rep.set_value(roots[0].id, "value", asset_value(int64_t(0)));
+    } catch (const std::logic_error&) {
+      return true;
+    }
+    return false;
+  });
+  if (!threw) {
+    fail("mutation under shared lock threw", 0, 1);
+  }
+
+  std::atomic<bool> stop { false };
+  std::atomic<uint64_t> reads { 0 };
+  std::atomic<uint64_t> snapshots { 0 };
+
+  std::vector<std::thread> readers;
+  for (size_t r = 0; r < readers_count; r++) {
+    readers.emplace_back([&, r]() {
+      std::vector<int64_t> last(roots_count, 0);
+      for (size_t n = 0; !stop; n++) {
+        const root_info& info = roots[(r + n) % roots_count];
+        const size_t slot = (r + n) % roots_count;
+
+        int64_t value;
+        switch ((r + n) % 3) {
+          case 0:
+            value = rep.read([&]() {
+              return check_root(*rep.get_asset(info.id), [&](buffer_id id) { return rep.load_buffer(id); });
+            });
+            reads++;
+            break;
+
+          case 1: {
+            auto snapshot = rep.snapshot(info.id);
+            value = check_root(snapshot->root(), [&](buffer_id id) { return snapshot->load_buffer(id); });
+            if (snapshot->get_guid() != info.asset_guid) {
+              fail("snapshot guid", 0, 1);
+            }
+            snapshots++;
+            break;
+          }
+
+          default:
+            if (rep.get_guid(info.id) != info.asset_guid || rep.get_asset_path(info.id) != info.path) {
+              fail("lookup", 0, 1);
+            }
+            value = last[slot];
+            break;
+        }
+
+        // writer only counts up, a reader going back saw a stale or torn state
+        if (value < last[slot]) {
+          fail("value went back", value, last[slot]);
+        }
+        last[slot] = value;
+      }
+    });
+  }
+
+  uint64_t writes = 0;
+  auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+  while (std::chrono::steady_clock::now() < end) {
+    const root_info& info = roots[writes % roots_count];
+    write_root(rep, *rep.get_asset(info.id), (int64_t) (writes / roots_count + 1));
+    writes++;
+  }
+
+  stop = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  for (const root_info& info : roots) {
+    check_root(*rep.get_asset(info.id), [&](buffer_id id) { return rep.load_buffer(id); });
+  }
+
+  std::printf("%zu readers, %llu writes, %llu reads, %llu snapshots, %llu failures\n", readers_count,
+              (unsigned long long) writes, (unsigned long long) reads.load(), (unsigned long long) snapshots.load(),
+              (unsigned long long) failures.load());
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}